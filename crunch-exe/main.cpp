@@ -8,61 +8,527 @@
 
 #include "cruncher.h"
 #include "combo.h"
+#include "topk.h"
+#include "combofilter.h"
+#include "movepattern.h"
+#include "ngramindex.h"
+#include "corpus.h"
+#include "hash.h"
+#include "analysisfile.h"
+#include "bench.h"
 
-bool is_combo_valid(const Crunch::Combo& combo) {
-	return combo.DidKill() && combo.TotalMoveCount() >= 7 && combo.TotalDamage() >= 60 && !combo.ExceedsSingleAttackDamageRatioThreshold(0.25f);
-}
-
-std::vector<Crunch::Combo> find_combos_from_analysis(const slip::Analysis& analysis) {
-	std::vector<Crunch::Combo> combos;
+// Combos worth a clip, whoever did them
+constexpr auto CLIP_COMBO_FILTER = Crunch::Filter::kill && Crunch::Filter::moves >= 7 && Crunch::Filter::damage >= 60
+	&& Crunch::Filter::max_hit_ratio <= 0.25;
+// Used when no filter is given on the command line
+constexpr auto DEFAULT_COMBO_FILTER = CLIP_COMBO_FILTER && Crunch::Filter::player_code == "YOYO#278";
 
-	int port_to_use = analysis.ap[0].tag_code == "YOYO#278" ? 0 : 1;
-	const slip::AnalysisPlayer& player_analysis = analysis.ap[port_to_use];
+bool compile_filter(const char* query, Crunch::ComboFilter* filter) {
+	if (!filter->Compile(query)) {
+		std::cout << "Invalid filter: " << filter->Error() << std::endl;
+		return false;
+	}
+	return true;
+}
 
-	Crunch::Combo curr_combo;
-	for (size_t iAttack = 0; player_analysis.attacks[iAttack].frame > 0; ++iAttack) {
-		const slip::Attack& curr_attack = player_analysis.attacks[iAttack];
-		const slip::Punish& curr_punish = player_analysis.punishes[curr_attack.punish_id];
+// Each punish's attacks are consecutive in the analysis, so a combo is a range of them and gets copied straight into the set
+// if the filter (a Crunch::ComboFilter or a Crunch::Filter expression) accepts it; both players' combos are checked,
+// or only those of the player on port when there is one
+template<typename Filter>
+void find_combos_from_analysis(const slip::Analysis& analysis, const Filter& filter, Crunch::ComboSet* combos, int port = -1) {
+	combos->BeginReplay();
 
-		if (!curr_combo.attacks.empty() && curr_attack.punish_id != curr_combo.attacks.back().punish_id) {
-			curr_combo.punish = player_analysis.punishes[curr_combo.attacks.back().punish_id];
-			if (is_combo_valid(curr_combo)) {
-				combos.push_back(curr_combo);
+	for (size_t iPlayer = 0; iPlayer < 2; ++iPlayer) {
+		const slip::AnalysisPlayer& player_analysis = analysis.ap[iPlayer];
+		if (port >= 0 && player_analysis.port != static_cast<unsigned>(port)) {
+			continue;
+		}
+		size_t combo_begin = 0;
+		for (size_t iAttack = 0; ; ++iAttack) {
+			const slip::Attack& curr_attack = player_analysis.attacks[iAttack];
+			bool is_last_attack = curr_attack.frame == 0;
+			if (iAttack > combo_begin && (is_last_attack || curr_attack.punish_id != player_analysis.attacks[iAttack - 1].punish_id)) {
+				Crunch::ComboView curr_combo = { &player_analysis.attacks[combo_begin], iAttack - combo_begin, &player_analysis.punishes[player_analysis.attacks[iAttack - 1].punish_id] };
+				if (filter(Crunch::ComboFilterRow(curr_combo, &analysis, iPlayer))) {
+					combos->AddCombo(curr_combo);
+				}
+				combo_begin = iAttack;
+			}
+			if (is_last_attack) {
+				break;
 			}
-			curr_combo = {};
 		}
-
-		curr_combo.attacks.push_back(curr_attack);
 	}
-
-	return combos;
 }
 
-std::vector<Crunch::Combo> find_combos_from_parser(std::unique_ptr<slip::Parser> parser) {
+Crunch::ComboSet find_combos_from_parser(std::unique_ptr<slip::Parser> parser) {
+	Crunch::ComboSet combos;
 	std::unique_ptr<slip::Analysis> analysis(parser->analyze());
-	return find_combos_from_analysis(*analysis);
+	find_combos_from_analysis(*analysis, DEFAULT_COMBO_FILTER, &combos);
+	return combos;
 }
 
-std::vector<Crunch::Combo> find_combos_from_replay_filename(std::string replay_filename) {
+Crunch::ComboSet find_combos_from_replay_filename(std::string replay_filename) {
 	std::unique_ptr<slip::Parser> parser = std::make_unique<slip::Parser>(0);
 	parser->load(replay_filename.c_str());
 	return find_combos_from_parser(std::move(parser));
 }
 
-int main() {
+struct TopCombo {
+	Crunch::Combo combo;
+	std::string replay;
+};
+
+// Points the desc at the path (a directory, a .slpack, or a corpus manifest, loaded into corpus, whose replays are crunched
+// without their duplicates); false if the manifest can't be read
+bool set_crunch_path(const std::filesystem::path& path, Crunch::CorpusManifest* corpus, Crunch::CruncherDesc<Crunch::ComboSet>* cruncher_desc) {
+	cruncher_desc->path = path;
+	if (path.extension() == Crunch::CORPUS_MANIFEST_EXTENSION) {
+		if (!corpus->Load(path)) {
+			std::cout << "Could not read " << path << std::endl;
+			return false;
+		}
+		cruncher_desc->corpus = corpus;
+	}
+	return true;
+}
+
+// Crunches every replay under the path (see set_crunch_path) into one set of the combos the filter accepts;
+// each worker appends straight into its own set, and the sets are merged once at the end
+template<typename Filter>
+Crunch::ComboSet crunch_combos(const std::filesystem::path& path, const Filter& filter) {
+	Crunch::CruncherDesc<Crunch::ComboSet> cruncher_desc;
+	Crunch::CorpusManifest corpus;
+	if (!set_crunch_path(path, &corpus, &cruncher_desc)) {
+		return {};
+	}
+	Crunch::Cruncher<Crunch::ComboSet> cruncher(cruncher_desc);
+	return cruncher.CrunchReduce<Crunch::ComboSet>(
+		[&filter](Crunch::ComboSet& worker_combos, std::unique_ptr<slip::Parser> parser) {
+			std::unique_ptr<slip::Analysis> analysis(parser->analyze());
+			find_combos_from_analysis(*analysis, filter, &worker_combos);
+		},
+		[](Crunch::ComboSet& combos, Crunch::ComboSet&& worker_combos) { combos.Merge(std::move(worker_combos)); });
+}
+
+// Crunches only the games the corpus manifest lists for the player (a connect code, Slippi UID or display name),
+// and only that player's combos in them, picked by the port the manifest recorded rather than by comparing codes
+template<typename Filter>
+Crunch::ComboSet crunch_player_combos(const Crunch::CorpusManifest& corpus, const std::string& player, const Filter& filter) {
+	Crunch::CruncherDesc<Crunch::ComboSet> cruncher_desc;
+	cruncher_desc.corpus = &corpus;
+	cruncher_desc.player = player;
+	Crunch::Cruncher<Crunch::ComboSet> cruncher(cruncher_desc);
+	return std::get<0>(cruncher.CrunchJobs(Crunch::MakeCrunchJob<Crunch::ComboSet>(
+		[&filter](Crunch::ComboSet& worker_combos, const Crunch::CrunchInput& input) {
+			find_combos_from_analysis(input.Analysis(), filter, &worker_combos, input.Port());
+		},
+		[](Crunch::ComboSet& combos, Crunch::ComboSet&& worker_combos) { combos.Merge(std::move(worker_combos)); })));
+}
+
+// crunch-exe top <k> <replay dir or .slpack> [filter] : prints the k best-scoring combos the filter accepts without keeping the others
+template<typename Filter>
+int print_top_combos(size_t k, const std::filesystem::path& path, const Filter& filter) {
+	Crunch::CruncherDesc<Crunch::TopK<TopCombo>> cruncher_desc;
+	cruncher_desc.path = path;
+	Crunch::Cruncher cruncher(cruncher_desc);
+	Crunch::TopK<TopCombo> top_combos = cruncher.CrunchReduce(Crunch::TopK<TopCombo>(k),
+		[&filter](Crunch::TopK<TopCombo>& worker_top_combos, std::unique_ptr<slip::Parser> parser) {
+			std::unique_ptr<slip::Analysis> analysis(parser->analyze());
+			Crunch::ComboSet combos;
+			find_combos_from_analysis(*analysis, filter, &combos);
+			for (Crunch::ComboView combo : combos.Combos()) {
+				worker_top_combos.Offer(combo.Score(), [&]() { return TopCombo{ { std::vector<slip::Attack>(combo.begin(), combo.end()), *combo.punish }, analysis->original_file }; });
+			}
+		},
+		[](Crunch::TopK<TopCombo>& top, Crunch::TopK<TopCombo>&& worker_top) { top.Merge(std::move(worker_top)); });
+	for (const auto& entry : top_combos.TakeSorted()) {
+		std::cout << entry.key << "  " << entry.item.replay << "  frames " << entry.item.combo.MovieStartFrame() << "-" << entry.item.combo.MovieEndFrame() << std::endl;
+	}
+	return 0;
+}
+
+// crunch-exe moves <replay dir or .slpack> <pattern>... : counts the combos containing each move pattern, e.g. "uthrow -> uair uair -> fair";
+// every pattern is checked in the same pass over each combo
+int count_move_patterns(const std::filesystem::path& path, const std::vector<std::string>& patterns) {
+	Crunch::MovePatternSet pattern_set;
+	for (const std::string& pattern : patterns) {
+		if (!pattern_set.Add(pattern)) {
+			std::cout << "Invalid pattern " << pattern << ": " << pattern_set.Error() << std::endl;
+			return 1;
+		}
+	}
+	if (!pattern_set.Compile()) {
+		std::cout << pattern_set.Error() << std::endl;
+		return 1;
+	}
+	Crunch::CruncherDesc<std::vector<size_t>> cruncher_desc;
+	cruncher_desc.path = path;
+	Crunch::Cruncher cruncher(cruncher_desc);
+	std::vector<size_t> match_counts = cruncher.CrunchReduce(std::vector<size_t>(pattern_set.PatternCount()),
+		[&pattern_set](std::vector<size_t>& worker_match_counts, std::unique_ptr<slip::Parser> parser) {
+			std::unique_ptr<slip::Analysis> analysis(parser->analyze());
+			Crunch::ComboSet combos;
+			find_combos_from_analysis(*analysis, Crunch::ComboFilter(), &combos);
+			std::vector<bool> matched;
+			for (Crunch::ComboView combo : combos.Combos()) {
+				if (pattern_set.MatchedPatterns(combo, &matched) > 0) {
+					for (size_t iPattern = 0; iPattern < matched.size(); ++iPattern) {
+						worker_match_counts[iPattern] += matched[iPattern];
+					}
+				}
+			}
+		},
+		[](std::vector<size_t>& match_counts, std::vector<size_t>&& worker_match_counts) {
+			for (size_t iPattern = 0; iPattern < match_counts.size(); ++iPattern) {
+				match_counts[iPattern] += worker_match_counts[iPattern];
+			}
+		});
+	for (size_t iPattern = 0; iPattern < pattern_set.PatternCount(); ++iPattern) {
+		std::cout << match_counts[iPattern] << "  " << pattern_set.Pattern(iPattern) << std::endl;
+	}
+	return 0;
+}
+
+// Where a crunched replay came from, as the n-gram index records it: its absolute path (and pack member) and the Hash64 of its .slp
+Crunch::MoveNgramReplay ngram_replay(const Crunch::CrunchItem& item) {
+	Crunch::MoveNgramReplay replay;
+	replay.path = std::filesystem::absolute(item.path).generic_string();
+	if (item.pack != nullptr) {
+		replay.member = static_cast<uint32_t>(item.pack_index);
+		replay.content_hash = item.pack->Entries()[item.pack_index].content_hash;
+	}
+	else {
+		replay.content_hash = Crunch::HashFile(item.path);
+	}
+	return replay;
+}
+
+// crunch-exe ngrams <index.slpngram> <replay dir or .slpack> : adds every combo under the path to the move n-gram index (creating it if needed);
+// replays the index already holds, wherever they are now, are skipped
+int index_move_ngrams(const std::filesystem::path& index_path, const std::filesystem::path& path) {
+	Crunch::MoveNgramIndex index;
+	if (std::filesystem::exists(index_path) && !index.Load(index_path)) {
+		std::cout << "Could not read " << index_path << std::endl;
+		return 1;
+	}
+	Crunch::CruncherDesc<Crunch::ComboSet> cruncher_desc;
+	Crunch::CorpusManifest corpus;
+	if (!set_crunch_path(path, &corpus, &cruncher_desc)) {
+		return 1;
+	}
+	Crunch::Cruncher<Crunch::ComboSet> cruncher(cruncher_desc);
+	const Crunch::ComboFilter filter;
+	// Both jobs append one entry per replay and their workers are merged in the same order, so replays[i] is the set's replay i
+	auto [combos, replays] = cruncher.CrunchJobs(
+		Crunch::MakeCrunchJob<Crunch::ComboSet>(
+			[&filter](Crunch::ComboSet& worker_combos, const Crunch::CrunchInput& input) {
+				find_combos_from_analysis(input.Analysis(), filter, &worker_combos);
+			},
+			[](Crunch::ComboSet& combos, Crunch::ComboSet&& worker_combos) { combos.Merge(std::move(worker_combos)); }),
+		Crunch::MakeCollectJob<Crunch::MoveNgramReplay>([](const Crunch::CrunchInput& input) { return ngram_replay(input.Item()); }));
+	const size_t previous_combo_count = index.ComboCount();
+	const size_t added_count = index.Add(combos, replays);
+	if (!index.Save(index_path)) {
+		std::cout << "Could not write " << index_path << std::endl;
+		return 1;
+	}
+	std::cout << "Indexed " << index.ComboCount() - previous_combo_count << " combos from " << added_count << " replays, skipped "
+		<< combos.ReplayCount() - added_count << " already indexed (" << index.ComboCount() << " total, " << index.NgramCount() << " n-grams)" << std::endl;
+	return 0;
+}
+
+// crunch-exe find <index.slpngram> <move>... : lists every combo of the index containing the move sequence, e.g. fair fair dair
+int find_move_sequence(const std::filesystem::path& index_path, const std::vector<std::string>& move_names) {
+	Crunch::MoveNgramIndex index;
+	if (!index.Load(index_path)) {
+		std::cout << "Could not read " << index_path << std::endl;
+		return 1;
+	}
+	std::vector<uint8_t> moves;
+	for (const std::string& move_name : move_names) {
+		int move_id = Crunch::FindMoveId(move_name);
+		if (move_id < 0) {
+			std::cout << "Unknown move " << move_name << std::endl;
+			return 1;
+		}
+		moves.push_back(static_cast<uint8_t>(move_id));
+	}
+	if (moves.size() < index.NgramSize()) {
+		std::cout << "The index needs sequences of at least " << index.NgramSize() << " moves" << std::endl;
+		return 1;
+	}
+	std::vector<Crunch::MoveNgramIndex::Hit> hits = index.Find(moves);
+	for (const auto& hit : hits) {
+		const Crunch::MoveNgramReplay& replay = index.Replays()[hit.replay];
+		if (replay.path.empty()) {
+			std::cout << "replay " << hit.replay;
+		}
+		else {
+			std::cout << replay.path;
+			if (replay.member != Crunch::NO_PACK_MEMBER) {
+				std::cout << " member " << replay.member;
+			}
+		}
+		std::cout << "  combo " << hit.combo << "  attack " << hit.position << std::endl;
+	}
+	std::cout << hits.size() << " matches" << std::endl;
+	return 0;
+}
+
+// crunch-exe corpus <manifest.slpcorpus> <replay dir or .slpack> : adds every replay under the path to the corpus manifest (creating it if needed),
+// then finds the copies of a same game it now holds, which crunches of the manifest skip
+int add_to_corpus(const std::filesystem::path& manifest_path, const std::filesystem::path& path) {
+	Crunch::CorpusManifest corpus;
+	if (std::filesystem::exists(manifest_path) && !corpus.Load(manifest_path)) {
+		std::cout << "Could not read " << manifest_path << std::endl;
+		return 1;
+	}
+	size_t added_count = corpus.AddPath(path);
+	size_t duplicate_count = corpus.Deduplicate();
+	if (!corpus.Save(manifest_path)) {
+		std::cout << "Could not write " << manifest_path << std::endl;
+		return 1;
+	}
+	std::cout << "Added " << added_count << " replays to " << manifest_path << " (" << corpus.Entries().size() << " total, " << corpus.IdentityCount() << " player identities, " << duplicate_count << " duplicates)" << std::endl;
+	return 0;
+}
+
+// crunch-exe player <manifest.slpcorpus> <player> [filter] : crunches the combos of one player (connect code, Slippi UID or display name)
+// in only the games they played
+template<typename Filter>
+int crunch_player(const std::filesystem::path& manifest_path, const std::string& player, const Filter& filter) {
+	Crunch::CorpusManifest corpus;
+	if (!corpus.Load(manifest_path)) {
+		std::cout << "Could not read " << manifest_path << std::endl;
+		return 1;
+	}
+	Crunch::ComboSet combos = crunch_player_combos(corpus, player, filter);
+	std::cout << "Found " << combos.ComboCount() << " combos by " << player << " in " << combos.ReplayCount() << " replays" << std::endl;
+	return 0;
+}
+
+// crunch-exe pack <pack.slpack> <replay dir> : adds every .slp under the directory to the pack (creating it if needed)
+int pack_replays(const std::filesystem::path& pack_path, const std::filesystem::path& replay_dir) {
+	Crunch::ReplayPack pack;
+	if (!std::filesystem::exists(pack_path) && !Crunch::ReplayPack::Create(pack_path)) {
+		std::cout << "Could not create " << pack_path << std::endl;
+		return 1;
+	}
+	if (!pack.Open(pack_path)) {
+		return 1;
+	}
+	size_t added_count = pack.AppendDirectory(replay_dir);
+	std::cout << "Added " << added_count << " replays to " << pack_path << " (" << pack.Entries().size() << " total)" << std::endl;
+	return 0;
+}
+
+// crunch-exe index <replay dir> : writes a frame -> event offset sidecar (.slpidx) next to every raw .slp under the directory
+int index_replays(const std::filesystem::path& replay_dir) {
+	size_t indexed_count = 0;
+	for (const auto& dir_entry : std::filesystem::recursive_directory_iterator(replay_dir)) {
+		if (!dir_entry.is_regular_file() || dir_entry.path().extension() != ".slp") {
+			continue;
+		}
+		std::ifstream replay_file(dir_entry.path(), std::ios::binary);
+		std::string replay_data((std::istreambuf_iterator<char>(replay_file)), std::istreambuf_iterator<char>());
+		slip::EventIndex event_index;
+		if (!event_index.build(replay_data.data(), static_cast<uint32_t>(replay_data.size()))) {
+			std::cout << "Could not index " << dir_entry.path() << std::endl;
+			continue;
+		}
+		if (event_index.save(slip::EventIndex::sidecarPath(dir_entry.path().string()))) {
+			++indexed_count;
+		}
+	}
+	std::cout << "Indexed " << indexed_count << " replays under " << replay_dir << std::endl;
+	return 0;
+}
+
+// crunch-exe analysischeck <replay dir> : analyzes every raw .slp under the directory and checks that the analysis comes back
+// unchanged from its .slpa encoding, and that its dynamics cover the whole game
+int check_analysis_files(const std::filesystem::path& replay_dir) {
+	size_t checked_count = 0;
+	size_t mismatch_count = 0;
+	for (const auto& dir_entry : std::filesystem::recursive_directory_iterator(replay_dir)) {
+		if (!dir_entry.is_regular_file() || dir_entry.path().extension() != ".slp") {
+			continue;
+		}
+		slip::Parser parser(0);
+		if (!parser.load(dir_entry.path().string().c_str())) {
+			std::cout << "Could not parse " << dir_entry.path() << std::endl;
+			continue;
+		}
+		std::unique_ptr<slip::Analysis> analysis(parser.analyze());
+		std::string encoded = Crunch::SerializeAnalysis(*analysis);
+		Crunch::AnalysisView view;
+		std::unique_ptr<slip::Analysis> loaded = view.Open(encoded.data(), encoded.size()) ? view.Load() : nullptr;
+		if (analysis->game_length != parser.replay()->frame_count || !loaded || !Crunch::SameAnalysis(*analysis, *loaded)) {
+			std::cout << "Analysis of " << dir_entry.path() << " doesn't round-trip" << std::endl;
+			++mismatch_count;
+		}
+		++checked_count;
+	}
+	std::cout << "Checked " << checked_count << " replays under " << replay_dir << ", " << mismatch_count << " mismatches" << std::endl;
+	return mismatch_count == 0 ? 0 : 1;
+}
+
+// Streams every post-frame event of a replay into a JSON array, one object per character per frame
+struct FrameJsonVisitor : slip::ReplayVisitor {
+	slip::JsonWriter& json;
+
+	FrameJsonVisitor(slip::JsonWriter& json_writer) : json(json_writer) {}
+
+	bool onGameStart(const slip::GameStartView& game_start) {
+		json.beginObject().field("stage", game_start.stage).key("frames").beginArray();
+		return true;
+	}
+	void onPostFrame(const slip::SlippiFrame& frame) {
+		json.beginObject()
+			.field("frame", frame.frame).field("player", frame.player).field("follower", frame.follower)
+			.field("char_id", frame.char_id).field("action_post", frame.action_post)
+			.field("pos_x_post", frame.pos_x_post).field("pos_y_post", frame.pos_y_post).field("face_dir_post", frame.face_dir_post)
+			.field("percent_post", frame.percent_post).field("shield", frame.shield).field("stocks", frame.stocks)
+			.endObject();
+	}
+};
+
+// crunch-exe json <replay dir> : writes every raw .slp's post-frame data to a .frames.json file next to it, streamed straight to disk
+int export_replays_json(const std::filesystem::path& replay_dir) {
+	size_t exported_count = 0;
+	for (const auto& dir_entry : std::filesystem::recursive_directory_iterator(replay_dir)) {
+		if (!dir_entry.is_regular_file() || dir_entry.path().extension() != ".slp") {
+			continue;
+		}
+		std::filesystem::path json_path = dir_entry.path();
+		json_path.replace_extension(".frames.json");
+		// Written next to it and renamed over it only once the whole replay has been exported, so a replay that fails
+		// halfway never leaves a truncated (or clobbered) .frames.json behind
+		std::filesystem::path temp_path = json_path;
+		temp_path += ".tmp";
+		std::unique_ptr<FILE, int (*)(FILE*)> json_file(std::fopen(temp_path.string().c_str(), "wb"), &std::fclose);
+		if (!json_file) {
+			std::cout << "Could not create " << temp_path << std::endl;
+			continue;
+		}
+		slip::JsonWriter json_writer(json_file.get());
+		FrameJsonVisitor visitor(json_writer);
+		slip::Parser parser(0);
+		bool is_exported = parser.visit(dir_entry.path().string().c_str(), visitor);
+		if (is_exported) {
+			json_writer.endArray().endObject();
+		}
+		is_exported &= json_writer.flush(); // empties the writer either way, it mustn't flush into the file once it's closed
+		is_exported &= std::fclose(json_file.release()) == 0;
+		std::error_code error;
+		if (is_exported) {
+			std::filesystem::rename(temp_path, json_path, error);
+		}
+		if (!is_exported || error) {
+			std::cout << "Could not export " << dir_entry.path() << std::endl;
+			std::filesystem::remove(temp_path, error);
+			continue;
+		}
+		++exported_count;
+	}
+	std::cout << "Exported " << exported_count << " replays under " << replay_dir << std::endl;
+	return 0;
+}
+
+// crunch-exe watch <replay.slp> : follows a replay while it's being written and prints each port's stocks and percent every second
+int watch_replay(const std::string& replay_path) {
+	slip::LiveParser live_parser(0);
+	slip::LiveSummary live_summary;
+	live_parser.addListener(&live_summary);
+	if (!live_parser.open(replay_path)) {
+		return 1;
+	}
+	int32_t last_printed_frame = LOAD_FRAME;
+	while (!live_parser.gameEnded()) {
+		if (live_parser.update() < 0) {
+			return 1;
+		}
+		if (live_summary.frame >= last_printed_frame + 60) {
+			last_printed_frame = live_summary.frame;
+			std::cout << "Frame " << live_summary.frame;
+			for (size_t iPort = 0; iPort < 4; ++iPort) {
+				if (live_summary.port[iPort].active) {
+					std::cout << "  P" << iPort + 1 << ": " << int(live_summary.port[iPort].stocks) << " stocks, " << live_summary.port[iPort].percent << "%";
+				}
+			}
+			std::cout << std::endl;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(LIVE_POLL_MS));
+	}
+	std::cout << "Game ended on frame " << live_parser.replay()->last_frame << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 4 && std::string(argv[1]) == "pack") {
+		return pack_replays(argv[2], argv[3]);
+	}
+	if (argc == 4 && std::string(argv[1]) == "corpus") {
+		return add_to_corpus(argv[2], argv[3]);
+	}
+	if ((argc == 4 || argc == 5) && std::string(argv[1]) == "player") {
+		if (argc == 4) {
+			return crunch_player(argv[2], argv[3], CLIP_COMBO_FILTER);
+		}
+		Crunch::ComboFilter filter;
+		return compile_filter(argv[4], &filter) ? crunch_player(argv[2], argv[3], filter) : 1;
+	}
+	if (argc == 3 && std::string(argv[1]) == "index") {
+		return index_replays(argv[2]);
+	}
+	if (argc == 3 && std::string(argv[1]) == "analysischeck") {
+		return check_analysis_files(argv[2]);
+	}
+	if (argc == 3 && std::string(argv[1]) == "json") {
+		return export_replays_json(argv[2]);
+	}
+	if ((argc == 4 || argc == 5) && std::string(argv[1]) == "top") {
+		size_t k = 0;
+		try {
+			k = std::stoul(argv[2]);
+		}
+		catch (std::exception&) {
+			std::cout << "Invalid combo count " << argv[2] << std::endl;
+			return 1;
+		}
+		if (argc == 4) {
+			return print_top_combos(k, argv[3], DEFAULT_COMBO_FILTER);
+		}
+		Crunch::ComboFilter filter;
+		return compile_filter(argv[4], &filter) ? print_top_combos(k, argv[3], filter) : 1;
+	}
+	if (argc >= 4 && std::string(argv[1]) == "moves") {
+		return count_move_patterns(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+	}
+	if (argc == 4 && std::string(argv[1]) == "ngrams") {
+		return index_move_ngrams(argv[2], argv[3]);
+	}
+	if (argc >= 4 && std::string(argv[1]) == "find") {
+		return find_move_sequence(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+	}
+	if (argc == 3 && std::string(argv[1]) == "watch") {
+		return watch_replay(argv[2]);
+	}
+	// crunch-exe bench [benchmark...] : runs the named benchmarks, or all of them
+	if (argc >= 2 && std::string(argv[1]) == "bench") {
+		return Crunch::RunBenchmarks(std::vector<std::string>(argv + 2, argv + argc)) ? 0 : 1;
+	}
 	try {
-		Crunch::CruncherDesc<std::vector<Crunch::Combo>> cruncher_desc;
-		cruncher_desc.crunch_func = find_combos_from_parser;
-		cruncher_desc.path = std::filesystem::current_path();
-		Crunch::Cruncher<std::vector<Crunch::Combo>> cruncher(cruncher_desc);
+		// crunch-exe [replay dir, .slpack or .slpcorpus] [filter], see Crunch::ComboFilter for the filter syntax
+		std::filesystem::path path = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::current_path();
+		Crunch::ComboFilter filter;
+		if (argc > 2 && !compile_filter(argv[2], &filter)) {
+			return 1;
+		}
 		std::cout << "Press enter to start the crunch : ";
 		std::cin.get();
-		std::vector<std::vector<Crunch::Combo>> crunch_results = cruncher.Crunch();
-		size_t combo_count = 0;
-		for (const auto& crunch_result : crunch_results) {
-			combo_count += crunch_result.size();
-		}
-		std::cout << "Found " << combo_count << " combos" << std::endl;
+		Crunch::ComboSet combos = argc > 2 ? crunch_combos(path, filter) : crunch_combos(path, DEFAULT_COMBO_FILTER);
+		std::cout << "Found " << combos.ComboCount() << " combos in " << combos.ReplayCount() << " replays" << std::endl;
 	}
 	catch (std::exception& error) {
 		std::cout << error.what() << std::endl;
@@ -0,0 +1,243 @@
+
+#include "pch.h"
+
+#include "analysisfile.h"
+
+namespace Crunch {
+	namespace {
+#define CRUNCH_ANALYSIS_STAT_SIZE(name) + sizeof(AnalysisFilePlayerStats::name)
+		static_assert(sizeof(AnalysisFilePlayerStats) == 0 CRUNCH_ANALYSIS_PLAYER_STATS(CRUNCH_ANALYSIS_STAT_SIZE), "player stats records have no padding");
+#undef CRUNCH_ANALYSIS_STAT_SIZE
+		static_assert(std::is_trivially_copyable_v<slip::Attack> && std::is_trivially_copyable_v<slip::Punish>, "attacks and punishes are stored as arrays");
+		static_assert(sizeof(AnalysisFileHeader) % 8 == 0, "sections after the header must stay 8-byte aligned");
+
+		constexpr size_t ANALYSIS_FILE_ALIGNMENT = 8;
+
+		AnalysisFilePlayerStats to_file_stats(const slip::AnalysisPlayer& player) {
+			AnalysisFilePlayerStats stats;
+#define CRUNCH_ANALYSIS_STAT_TO_FILE(name) stats.name = player.name;
+			CRUNCH_ANALYSIS_PLAYER_STATS(CRUNCH_ANALYSIS_STAT_TO_FILE)
+#undef CRUNCH_ANALYSIS_STAT_TO_FILE
+			return stats;
+		}
+
+		void from_file_stats(const AnalysisFilePlayerStats& stats, slip::AnalysisPlayer* player) {
+#define CRUNCH_ANALYSIS_STAT_FROM_FILE(name) player->name = stats.name;
+			CRUNCH_ANALYSIS_PLAYER_STATS(CRUNCH_ANALYSIS_STAT_FROM_FILE)
+#undef CRUNCH_ANALYSIS_STAT_FROM_FILE
+		}
+
+		// Records are compared field by field since struct padding is indeterminate
+		bool same_record(const slip::Attack& a, const slip::Attack& b) {
+			return a.move_id == b.move_id && a.anim_frame == b.anim_frame && a.punish_id == b.punish_id && a.hit_id == b.hit_id
+				&& a.frame == b.frame && a.damage == b.damage && a.opening == b.opening && a.kill_dir == b.kill_dir
+				&& a.cancel_type == b.cancel_type;
+		}
+
+		bool same_record(const slip::Punish& a, const slip::Punish& b) {
+			return a.num_moves == b.num_moves && a.start_frame == b.start_frame && a.end_frame == b.end_frame
+				&& a.start_pct == b.start_pct && a.end_pct == b.end_pct && a.stocks == b.stocks
+				&& a.last_move_id == b.last_move_id && a.opening == b.opening && a.kill_dir == b.kill_dir;
+		}
+
+		// Records default-constructed by the analyzer
+		template<typename T>
+		bool is_default(const T& record) {
+			return same_record(record, T{});
+		}
+
+		// Number of entries up to the last one the analyzer filled in
+		template<typename T>
+		uint32_t used_count(const T* records, size_t capacity) {
+			size_t count = capacity;
+			while (count > 0 && is_default(records[count - 1])) {
+				--count;
+			}
+			return static_cast<uint32_t>(count);
+		}
+
+		// Appends a section at the next aligned offset and returns that offset
+		uint32_t append_section(std::string* out, const void* data, size_t size) {
+			out->resize((out->size() + ANALYSIS_FILE_ALIGNMENT - 1) & ~(ANALYSIS_FILE_ALIGNMENT - 1), '\0');
+			uint32_t offset = static_cast<uint32_t>(out->size());
+			out->append(static_cast<const char*>(data), size);
+			return offset;
+		}
+
+		AnalysisFileString append_string(std::string* out, const std::string& str) {
+			AnalysisFileString file_string;
+			file_string.offset = static_cast<uint32_t>(out->size());
+			file_string.size = static_cast<uint32_t>(str.size());
+			out->append(str);
+			return file_string;
+		}
+
+		bool in_bounds(uint64_t offset, uint64_t size, size_t file_size) {
+			return offset % ANALYSIS_FILE_ALIGNMENT == 0 && offset + size <= file_size;
+		}
+
+		bool string_in_bounds(const AnalysisFileString& str, size_t file_size) {
+			return uint64_t(str.offset) + str.size <= file_size;
+		}
+	}
+
+	std::string SerializeAnalysis(const slip::Analysis& analysis) {
+		AnalysisFileHeader header;
+		header.stats_size = static_cast<uint16_t>(sizeof(AnalysisFilePlayerStats));
+		header.attack_size = static_cast<uint16_t>(sizeof(slip::Attack));
+		header.punish_size = static_cast<uint16_t>(sizeof(slip::Punish));
+		header.move_count = static_cast<uint16_t>(Move::__LAST);
+		header.dynamic_count = static_cast<uint16_t>(Dynamic::__LAST);
+		header.success = analysis.success ? 1 : 0;
+		header.parse_errors = analysis.parse_errors;
+		header.stage_id = analysis.stage_id;
+		header.winner_port = analysis.winner_port;
+		header.game_length = analysis.game_length;
+		header.timer = analysis.timer;
+		header.end_type = analysis.end_type;
+		header.lras_player = analysis.lras_player;
+		header.frame_count = analysis.game_length;
+
+		std::string out(sizeof(AnalysisFileHeader), '\0');
+		header.dynamics_offset = append_section(&out, analysis.dynamics, header.frame_count * sizeof(unsigned));
+		for (size_t iPlayer = 0; iPlayer < 2; ++iPlayer) {
+			const slip::AnalysisPlayer& player = analysis.ap[iPlayer];
+			AnalysisFilePlayer& file_player = header.players[iPlayer];
+			const AnalysisFilePlayerStats stats = to_file_stats(player);
+			file_player.stats_offset = append_section(&out, &stats, sizeof(stats));
+			file_player.move_counts_offset = append_section(&out, player.move_counts, Move::__LAST * sizeof(unsigned));
+			file_player.dyn_counts_offset = append_section(&out, player.dyn_counts, Dynamic::__LAST * sizeof(unsigned));
+			file_player.dyn_damage_offset = append_section(&out, player.dyn_damage, Dynamic::__LAST * sizeof(float));
+			file_player.attack_count = used_count(player.attacks, MAX_ATTACKS);
+			file_player.attacks_offset = append_section(&out, player.attacks, file_player.attack_count * sizeof(slip::Attack));
+			file_player.punish_count = used_count(player.punishes, MAX_PUNISHES);
+			file_player.punishes_offset = append_section(&out, player.punishes, file_player.punish_count * sizeof(slip::Punish));
+		}
+
+		header.game_time = append_string(&out, analysis.game_time);
+		header.original_file = append_string(&out, analysis.original_file);
+		header.slippi_version = append_string(&out, analysis.slippi_version);
+		header.parser_version = append_string(&out, analysis.parser_version);
+		header.analyzer_version = append_string(&out, analysis.analyzer_version);
+		header.stage_name = append_string(&out, analysis.stage_name);
+		for (size_t iPlayer = 0; iPlayer < 2; ++iPlayer) {
+			const slip::AnalysisPlayer& player = analysis.ap[iPlayer];
+			header.players[iPlayer].tag_player = append_string(&out, player.tag_player);
+			header.players[iPlayer].tag_css = append_string(&out, player.tag_css);
+			header.players[iPlayer].tag_code = append_string(&out, player.tag_code);
+			header.players[iPlayer].char_name = append_string(&out, player.char_name);
+		}
+
+		header.file_size = static_cast<uint32_t>(out.size());
+		std::memcpy(&out[0], &header, sizeof(header));
+		return out;
+	}
+
+	bool SameAnalysis(const slip::Analysis& a, const slip::Analysis& b) {
+		bool same = a.success == b.success && a.parse_errors == b.parse_errors && a.game_time == b.game_time && a.original_file == b.original_file
+			&& a.slippi_version == b.slippi_version && a.parser_version == b.parser_version && a.analyzer_version == b.analyzer_version
+			&& a.stage_id == b.stage_id && a.stage_name == b.stage_name && a.winner_port == b.winner_port && a.game_length == b.game_length
+			&& a.timer == b.timer && a.end_type == b.end_type && a.lras_player == b.lras_player
+			&& std::memcmp(a.dynamics, b.dynamics, a.game_length * sizeof(unsigned)) == 0;
+		for (size_t iPlayer = 0; iPlayer < 2 && same; ++iPlayer) {
+			const slip::AnalysisPlayer& pa = a.ap[iPlayer];
+			const slip::AnalysisPlayer& pb = b.ap[iPlayer];
+			const AnalysisFilePlayerStats stats_a = to_file_stats(pa);
+			const AnalysisFilePlayerStats stats_b = to_file_stats(pb);
+			same = std::memcmp(&stats_a, &stats_b, sizeof(AnalysisFilePlayerStats)) == 0
+				&& pa.tag_player == pb.tag_player && pa.tag_css == pb.tag_css && pa.tag_code == pb.tag_code && pa.char_name == pb.char_name
+				&& std::memcmp(pa.move_counts, pb.move_counts, Move::__LAST * sizeof(unsigned)) == 0
+				&& std::memcmp(pa.dyn_counts, pb.dyn_counts, Dynamic::__LAST * sizeof(unsigned)) == 0
+				&& std::memcmp(pa.dyn_damage, pb.dyn_damage, Dynamic::__LAST * sizeof(float)) == 0
+				&& std::equal(pa.attacks, pa.attacks + MAX_ATTACKS, pb.attacks, [](const auto& x, const auto& y) { return same_record(x, y); })
+				&& std::equal(pa.punishes, pa.punishes + MAX_PUNISHES, pb.punishes, [](const auto& x, const auto& y) { return same_record(x, y); });
+		}
+		return same;
+	}
+
+	bool SaveAnalysis(const slip::Analysis& analysis, const std::filesystem::path& path) {
+		std::string data = SerializeAnalysis(analysis);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), data.size());
+		return static_cast<bool>(file);
+	}
+
+	bool AnalysisView::Open(const char* data, size_t size) {
+		m_data = nullptr;
+		m_header = nullptr;
+		if (size < sizeof(AnalysisFileHeader) || reinterpret_cast<uintptr_t>(data) % ANALYSIS_FILE_ALIGNMENT != 0) {
+			return false;
+		}
+		const AnalysisFileHeader* header = reinterpret_cast<const AnalysisFileHeader*>(data);
+		if (header->magic != ANALYSIS_FILE_MAGIC || header->version > ANALYSIS_FILE_VERSION || header->file_size > size) {
+			return false;
+		}
+		if (header->stats_size != sizeof(AnalysisFilePlayerStats) || header->attack_size != sizeof(slip::Attack) || header->punish_size != sizeof(slip::Punish)
+			|| header->move_count != Move::__LAST || header->dynamic_count != Dynamic::__LAST) {
+			return false;
+		}
+
+		bool valid = in_bounds(header->dynamics_offset, uint64_t(header->frame_count) * sizeof(unsigned), size);
+		for (const AnalysisFileString* str : { &header->game_time, &header->original_file, &header->slippi_version, &header->parser_version, &header->analyzer_version, &header->stage_name }) {
+			valid &= string_in_bounds(*str, size);
+		}
+		for (const AnalysisFilePlayer& player : header->players) {
+			valid &= in_bounds(player.stats_offset, sizeof(AnalysisFilePlayerStats), size)
+				&& in_bounds(player.move_counts_offset, Move::__LAST * sizeof(unsigned), size)
+				&& in_bounds(player.dyn_counts_offset, Dynamic::__LAST * sizeof(unsigned), size)
+				&& in_bounds(player.dyn_damage_offset, Dynamic::__LAST * sizeof(float), size)
+				&& player.attack_count <= MAX_ATTACKS && in_bounds(player.attacks_offset, uint64_t(player.attack_count) * sizeof(slip::Attack), size)
+				&& player.punish_count <= MAX_PUNISHES && in_bounds(player.punishes_offset, uint64_t(player.punish_count) * sizeof(slip::Punish), size)
+				&& string_in_bounds(player.tag_player, size) && string_in_bounds(player.tag_css, size)
+				&& string_in_bounds(player.tag_code, size) && string_in_bounds(player.char_name, size);
+		}
+		if (!valid) {
+			return false;
+		}
+		m_data = data;
+		m_header = header;
+		return true;
+	}
+
+	std::unique_ptr<slip::Analysis> AnalysisView::Load() const {
+		if (m_header == nullptr) {
+			return nullptr;
+		}
+		auto analysis = std::make_unique<slip::Analysis>(m_header->frame_count);
+		analysis->success = m_header->success != 0;
+		analysis->parse_errors = m_header->parse_errors;
+		analysis->game_time = String(m_header->game_time);
+		analysis->original_file = String(m_header->original_file);
+		analysis->slippi_version = String(m_header->slippi_version);
+		analysis->parser_version = String(m_header->parser_version);
+		analysis->analyzer_version = String(m_header->analyzer_version);
+		analysis->stage_id = m_header->stage_id;
+		analysis->stage_name = String(m_header->stage_name);
+		analysis->winner_port = m_header->winner_port;
+		analysis->game_length = m_header->game_length;
+		analysis->timer = m_header->timer;
+		analysis->end_type = m_header->end_type;
+		analysis->lras_player = m_header->lras_player;
+		std::memcpy(analysis->dynamics, Dynamics(), m_header->frame_count * sizeof(unsigned));
+
+		for (size_t iPlayer = 0; iPlayer < 2; ++iPlayer) {
+			const AnalysisFilePlayer& file_player = m_header->players[iPlayer];
+			slip::AnalysisPlayer& player = analysis->ap[iPlayer];
+			from_file_stats(PlayerStats(iPlayer), &player);
+			player.tag_player = String(file_player.tag_player);
+			player.tag_css = String(file_player.tag_css);
+			player.tag_code = String(file_player.tag_code);
+			player.char_name = String(file_player.char_name);
+			std::memcpy(player.move_counts, MoveCounts(iPlayer), Move::__LAST * sizeof(unsigned));
+			std::memcpy(player.dyn_counts, DynCounts(iPlayer), Dynamic::__LAST * sizeof(unsigned));
+			std::memcpy(player.dyn_damage, DynDamage(iPlayer), Dynamic::__LAST * sizeof(float));
+			std::copy_n(Attacks(iPlayer), file_player.attack_count, player.attacks);
+			std::copy_n(Punishes(iPlayer), file_player.punish_count, player.punishes);
+		}
+		return analysis;
+	}
+
+	bool AnalysisFile::Open(const std::filesystem::path& path) {
+		return m_file.Open(path) && m_view.Open(m_file.Data(), m_file.Size());
+	}
+}
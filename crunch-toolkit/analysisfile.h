@@ -0,0 +1,135 @@
+#pragma once
+
+#include "pch.h"
+
+#include "pack.h"
+
+namespace Crunch {
+	// Binary analysis (.slpa) layout, native little-endian structs so a mapping can be read in place:
+	//   header   : AnalysisFileHeader (game-level results, record sizes, and the offset of every section)
+	//   sections : dynamics, then per player: stats, move_counts, dyn_counts, dyn_damage, attacks, punishes; then strings
+	// Every section starts on an 8-byte boundary. Only the attacks and punishes up to the last non-default entry are stored.
+	// A file is rejected if its record sizes or move / dynamic counts don't match this build's structs.
+	constexpr uint32_t ANALYSIS_FILE_MAGIC = 0x41504C53; // "SLPA"
+	constexpr uint32_t ANALYSIS_FILE_VERSION = 2; // 2: player stats stored as AnalysisFilePlayerStats
+	constexpr const char* ANALYSIS_FILE_EXTENSION = ".slpa";
+
+	// Every numeric member of slip::AnalysisPlayer, in declaration order. The prebuilt library's struct mixes them with strings and
+	// arrays (and its layout can't change), so they're copied one by one into and out of a flat record of the same members
+#define CRUNCH_ANALYSIS_PLAYER_STATS(X) \
+	X(port) X(char_id) X(player_type) X(cpu_level) X(start_stocks) X(color) X(team_id) X(end_stocks) X(end_pct) X(airdodges) \
+	X(spotdodges) X(rolls) X(dashdances) X(l_cancels_hit) X(l_cancels_missed) X(techs) X(walltechs) X(walljumps) X(walltechjumps) \
+	X(missed_techs) X(ledge_grabs) X(air_frames) X(wavedashes) X(wavelands) X(neutral_wins) X(pokes) X(counters) X(powershields) \
+	X(shield_breaks) X(grabs) X(grab_escapes) X(taunts) X(meteor_cancels) X(damage_dealt) X(hits_blocked) X(shield_stabs) \
+	X(edge_cancel_aerials) X(edge_cancel_specials) X(phantom_hits) X(shield_drops) X(no_impact_lands) X(pivots) \
+	X(reverse_edgeguards) X(self_destructs) X(stage_spikes) X(short_hops) X(full_hops) X(shield_time) X(shield_damage) \
+	X(shield_lowest) X(teeter_cancel_aerials) X(teeter_cancel_specials) X(total_openings) X(mean_kill_openings) X(mean_kill_percent) \
+	X(mean_opening_percent) X(galint_ledgedashes) X(mean_galint) X(shieldstun_times) X(shieldstun_act_frames) X(hitstun_times) \
+	X(hitstun_act_frames) X(wait_times) X(wait_act_frames) X(max_galint) X(button_count) X(cstick_count) X(astick_count) X(apm) \
+	X(state_changes) X(aspm) X(used_throws) X(used_norm_moves) X(used_spec_moves) X(used_misc_moves) X(used_grabs) X(used_pummels) \
+	X(total_moves_used) X(total_moves_landed) X(move_accuracy) X(actionability) X(neutral_wins_per_min) X(mean_death_percent)
+
+	// The stats section of a player: every member is 4 bytes, so there's no padding and records compare bytewise
+	struct AnalysisFilePlayerStats {
+#define CRUNCH_ANALYSIS_STAT_MEMBER(name) decltype(slip::AnalysisPlayer::name) name = 0;
+		CRUNCH_ANALYSIS_PLAYER_STATS(CRUNCH_ANALYSIS_STAT_MEMBER)
+#undef CRUNCH_ANALYSIS_STAT_MEMBER
+	};
+
+	struct AnalysisFileString {
+		uint32_t offset = 0;
+		uint32_t size = 0;
+	};
+
+	struct AnalysisFilePlayer {
+		uint32_t stats_offset = 0;
+		uint32_t move_counts_offset = 0;
+		uint32_t dyn_counts_offset = 0;
+		uint32_t dyn_damage_offset = 0;
+		uint32_t attacks_offset = 0;
+		uint32_t attack_count = 0;
+		uint32_t punishes_offset = 0;
+		uint32_t punish_count = 0;
+		AnalysisFileString tag_player;
+		AnalysisFileString tag_css;
+		AnalysisFileString tag_code;
+		AnalysisFileString char_name;
+	};
+
+	struct AnalysisFileHeader {
+		uint32_t magic = ANALYSIS_FILE_MAGIC;
+		uint32_t version = ANALYSIS_FILE_VERSION;
+		uint32_t file_size = 0;
+		// Layout of this build's structs, checked on load
+		uint16_t stats_size = 0;
+		uint16_t attack_size = 0;
+		uint16_t punish_size = 0;
+		uint16_t move_count = 0;
+		uint16_t dynamic_count = 0;
+		uint16_t reserved = 0;
+
+		uint32_t success = 0;
+		uint32_t parse_errors = 0;
+		uint32_t stage_id = 0;
+		int32_t winner_port = 0;
+		uint32_t game_length = 0;
+		uint32_t timer = 0;
+		uint32_t end_type = 0;
+		int32_t lras_player = 0;
+		uint32_t frame_count = 0; // length of dynamics: the analyzer sizes it from the replay's frame count, which it records as game_length
+		uint32_t dynamics_offset = 0;
+		AnalysisFileString game_time;
+		AnalysisFileString original_file;
+		AnalysisFileString slippi_version;
+		AnalysisFileString parser_version;
+		AnalysisFileString analyzer_version;
+		AnalysisFileString stage_name;
+		AnalysisFilePlayer players[2];
+	};
+
+	// Serializes an analysis into the binary format
+	std::string SerializeAnalysis(const slip::Analysis& analysis);
+	// Whether two analyses hold the same data, as far as the binary format stores it (floats compared bitwise, so NaN means equal NaN)
+	bool SameAnalysis(const slip::Analysis& a, const slip::Analysis& b);
+	bool SaveAnalysis(const slip::Analysis& analysis, const std::filesystem::path& path);
+
+	// Zero-copy view of a serialized analysis; every accessor points into the buffer, which must outlive the view
+	class AnalysisView {
+	public:
+		// Checks the header and that every section lies inside the buffer; the buffer must be 8-byte aligned
+		bool Open(const char* data, size_t size);
+
+		const AnalysisFileHeader& Header() const { return *m_header; }
+		std::string_view String(const AnalysisFileString& str) const { return { m_data + str.offset, str.size }; }
+		const unsigned* Dynamics() const { return Section<unsigned>(m_header->dynamics_offset); }
+
+		const AnalysisFilePlayerStats& PlayerStats(size_t iPlayer) const { return *Section<AnalysisFilePlayerStats>(m_header->players[iPlayer].stats_offset); }
+		const unsigned* MoveCounts(size_t iPlayer) const { return Section<unsigned>(m_header->players[iPlayer].move_counts_offset); }
+		const unsigned* DynCounts(size_t iPlayer) const { return Section<unsigned>(m_header->players[iPlayer].dyn_counts_offset); }
+		const float* DynDamage(size_t iPlayer) const { return Section<float>(m_header->players[iPlayer].dyn_damage_offset); }
+		const slip::Attack* Attacks(size_t iPlayer) const { return Section<slip::Attack>(m_header->players[iPlayer].attacks_offset); }
+		size_t AttackCount(size_t iPlayer) const { return m_header->players[iPlayer].attack_count; }
+		const slip::Punish* Punishes(size_t iPlayer) const { return Section<slip::Punish>(m_header->players[iPlayer].punishes_offset); }
+		size_t PunishCount(size_t iPlayer) const { return m_header->players[iPlayer].punish_count; }
+
+		// Rebuilds a full analysis, identical to the one that was serialized
+		std::unique_ptr<slip::Analysis> Load() const;
+	private:
+		const char* m_data = nullptr;
+		const AnalysisFileHeader* m_header = nullptr;
+
+		template<typename T>
+		const T* Section(uint32_t offset) const { return reinterpret_cast<const T*>(m_data + offset); }
+	};
+
+	// Memory-mapped .slpa file
+	class AnalysisFile {
+	public:
+		bool Open(const std::filesystem::path& path);
+		void Close() { m_file.Close(); }
+		const AnalysisView& View() const { return m_view; }
+	private:
+		MappedFile m_file;
+		AnalysisView m_view;
+	};
+}
@@ -0,0 +1,990 @@
+
+#include "pch.h"
+
+#include "bench.h"
+#include "analysisfile.h"
+#include "combofeatures.h"
+#include "combofilter.h"
+#include "ngramindex.h"
+
+namespace Crunch {
+	namespace {
+		// Post-frame layout, the widest event and the bulk of every replay, with the action state bit flags as bit columns
+		const int BENCH_COL_WIDTHS[] = { 1,4,1,1,1,2,4,4,4,4,4,1,1,1,1,4,-1,-1,-1,-1,-1,4,1,2,1,1,1,4,4,4,4,4,4,4,0 };
+
+		size_t struct_size(const int col_widths[]) {
+			size_t size = 0;
+			for (size_t iCol = 0; col_widths[iCol] != 0; ++iCol) {
+				size += col_widths[iCol] > 0 ? col_widths[iCol] : 1;
+			}
+			return size;
+		}
+
+		// Replay-like data: slowly drifting values so it looks roughly like real frame data rather than noise
+		std::vector<char> make_events(size_t event_count, size_t event_size) {
+			std::vector<char> events(event_count * event_size);
+			std::mt19937 rng(0x5EED);
+			for (size_t iByte = 0; iByte < events.size(); ++iByte) {
+				events[iByte] = static_cast<char>((iByte % event_size) * 7 + (rng() % 4));
+			}
+			return events;
+		}
+	}
+
+	void PrintBenchResult(const BenchResult& result) {
+		std::cout << std::left << std::setw(40) << result.name << std::right
+			<< std::setw(10) << std::fixed << std::setprecision(2) << result.GBps() << " GB/s"
+			<< std::setw(12) << std::setprecision(3) << result.seconds * 1e3 << " ms";
+		if (result.items > 0) {
+			std::cout << std::setw(14) << std::setprecision(2) << result.seconds * 1e9 / static_cast<double>(result.items) << " ns/item";
+		}
+		std::cout << (result.is_valid ? "" : "  MISMATCH") << std::endl;
+	}
+
+	std::vector<BenchResult> BenchShuffle(size_t event_count, size_t iterations) {
+		const size_t event_size = struct_size(BENCH_COL_WIDTHS);
+		const std::vector<char> events = make_events(event_count, event_size);
+		std::vector<char> columns(events.size());
+		std::vector<char> restored(events.size());
+		std::vector<char> reference;
+
+		std::vector<BenchResult> results;
+		const slip::SimdLevel detected_level = slip::simdLevel();
+		for (int level = slip::SIMD_SCALAR; level <= detected_level; ++level) {
+			slip::SimdLevel simd_level = static_cast<slip::SimdLevel>(level);
+			auto shuffle = [&]() {
+				std::fill(columns.begin(), columns.end(), 0);
+				slip::transposeColumns(columns.data(), events.data(), static_cast<unsigned>(event_count), BENCH_COL_WIDTHS, false, simd_level);
+			};
+			auto unshuffle = [&]() {
+				std::fill(restored.begin(), restored.end(), 0);
+				slip::transposeColumns(restored.data(), columns.data(), static_cast<unsigned>(event_count), BENCH_COL_WIDTHS, true, simd_level);
+			};
+
+			// Both directions touch every byte twice (read + write), but report the event bytes processed like a codec would
+			BenchResult shuffle_result = TimeBest(std::string("shuffle/") + slip::simdLevelName(simd_level), static_cast<double>(events.size()), iterations, shuffle);
+			if (reference.empty()) {
+				reference = columns;
+			}
+			shuffle_result.is_valid = (columns == reference);
+			results.push_back(shuffle_result);
+
+			BenchResult unshuffle_result = TimeBest(std::string("unshuffle/") + slip::simdLevelName(simd_level), static_cast<double>(events.size()), iterations, unshuffle);
+			unshuffle_result.is_valid = (restored == events);
+			results.push_back(unshuffle_result);
+		}
+		return results;
+	}
+
+	std::vector<BenchResult> CheckShuffle(size_t trial_count) {
+		// Every width a CW_* table can hold: bit columns, the byte widths the kernels specialize (or don't), and a message payload
+		const int COLUMN_WIDTHS[] = { -1, 1, 2, 3, 4, 5, 6, 7, 8, 512 };
+		// Entry counts around the SIMD block (16 and 64 entries) and tile (256 entries) boundaries
+		const unsigned EDGE_ENTRY_COUNTS[] = { 0, 1, 2, 7, 15, 16, 17, 63, 64, 65, 255, 256, 257, 511, 513, 1023 };
+		std::mt19937 rng(7);
+
+		struct Trial {
+			std::vector<int> col_widths; // 0-terminated
+			unsigned entry_count = 0;
+			std::vector<char> events;
+		};
+		std::vector<Trial> trials(trial_count);
+		for (size_t iTrial = 0; iTrial < trial_count; ++iTrial) {
+			Trial& trial = trials[iTrial];
+			if (iTrial < std::size(COLUMN_WIDTHS) * std::size(EDGE_ENTRY_COUNTS)) {
+				// A single column of each width at each edge count first
+				trial.col_widths = { COLUMN_WIDTHS[iTrial % std::size(COLUMN_WIDTHS)], 0 };
+				trial.entry_count = EDGE_ENTRY_COUNTS[iTrial / std::size(COLUMN_WIDTHS)];
+			}
+			else {
+				size_t col_count = 1 + rng() % 40;
+				for (size_t iCol = 0; iCol < col_count; ++iCol) {
+					// Message-sized columns are rare, as in real replays
+					trial.col_widths.push_back(COLUMN_WIDTHS[rng() % (rng() % 16 == 0 ? std::size(COLUMN_WIDTHS) : std::size(COLUMN_WIDTHS) - 1)]);
+				}
+				trial.col_widths.push_back(0);
+				trial.entry_count = (rng() % 4 == 0) ? EDGE_ENTRY_COUNTS[rng() % std::size(EDGE_ENTRY_COUNTS)] : (rng() % 1200) | 1;
+			}
+			trial.events.resize(trial.entry_count * struct_size(trial.col_widths.data()));
+			for (char& byte : trial.events) {
+				byte = static_cast<char>(rng());
+			}
+		}
+
+		std::vector<BenchResult> results;
+		std::vector<std::vector<char>> references(trial_count);
+		const slip::SimdLevel detected_level = slip::simdLevel();
+		for (int level = slip::SIMD_SCALAR; level <= detected_level; ++level) {
+			slip::SimdLevel simd_level = static_cast<slip::SimdLevel>(level);
+			BenchResult result;
+			result.name = std::string("shufflecheck/") + slip::simdLevelName(simd_level);
+			result.items = trial_count;
+			auto begin_time = std::chrono::steady_clock::now();
+			for (size_t iTrial = 0; iTrial < trial_count; ++iTrial) {
+				const Trial& trial = trials[iTrial];
+				std::vector<char> columns(trial.events.size());
+				std::vector<char> restored(trial.events.size());
+				slip::transposeColumns(columns.data(), trial.events.data(), trial.entry_count, trial.col_widths.data(), false, simd_level);
+				slip::transposeColumns(restored.data(), columns.data(), trial.entry_count, trial.col_widths.data(), true, simd_level);
+				if (simd_level == slip::SIMD_SCALAR) {
+					references[iTrial] = columns;
+				}
+				if (columns != references[iTrial] || restored != trial.events) {
+					if (result.is_valid) {
+						std::cout << result.name << " differs from the scalar transpose on " << trial.entry_count << " entries of columns";
+						for (size_t iCol = 0; trial.col_widths[iCol] != 0; ++iCol) {
+							std::cout << " " << trial.col_widths[iCol];
+						}
+						std::cout << std::endl;
+					}
+					result.is_valid = false;
+				}
+				result.bytes += static_cast<double>(trial.events.size());
+			}
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count();
+			results.push_back(result);
+		}
+		return results;
+	}
+
+	std::vector<BenchResult> BenchFrameDecode(size_t event_count, size_t iterations) {
+		const unsigned event_size = slip::O_DAMAGE_PRE + 4; // pre-frame event of a current replay, command byte included
+		const std::vector<char> events = make_events(event_count, event_size);
+		std::vector<slip::SlippiFrame> reference(event_count);
+		std::vector<slip::SlippiFrame> frames(event_count);
+		const double total_bytes = static_cast<double>(events.size());
+
+		// Baseline: what the parser does today, one unaligned load and byte swap per field
+		std::vector<BenchResult> results;
+		results.push_back(TimeBest("framedecode/per-field", total_bytes, iterations, [&]() {
+			for (size_t iEvent = 0; iEvent < event_count; ++iEvent) {
+				char* ev = const_cast<char*>(&events[iEvent * event_size]);
+				slip::SlippiFrame& frame = reference[iEvent];
+				frame.frame = slip::readBE4S(&ev[slip::O_FRAME]);
+				frame.player = ev[slip::O_PLAYER];
+				frame.follower = ev[slip::O_FOLLOWER] != 0;
+				frame.seed = slip::readBE4U(&ev[slip::O_RNG_PRE]);
+				frame.action_pre = slip::readBE2U(&ev[slip::O_ACTION_PRE]);
+				frame.pos_x_pre = slip::readBE4F(&ev[slip::O_XPOS_PRE]);
+				frame.pos_y_pre = slip::readBE4F(&ev[slip::O_YPOS_PRE]);
+				frame.face_dir_pre = slip::readBE4F(&ev[slip::O_FACING_PRE]);
+				frame.joy_x = slip::readBE4F(&ev[slip::O_JOY_X]);
+				frame.joy_y = slip::readBE4F(&ev[slip::O_JOY_Y]);
+				frame.c_x = slip::readBE4F(&ev[slip::O_CX]);
+				frame.c_y = slip::readBE4F(&ev[slip::O_CY]);
+				frame.trigger = slip::readBE4F(&ev[slip::O_TRIGGER]);
+				frame.buttons = slip::readBE2U(&ev[slip::O_BUTTONS]);
+				frame.phys_l = slip::readBE4F(&ev[slip::O_PHYS_L]);
+				frame.phys_r = slip::readBE4F(&ev[slip::O_PHYS_R]);
+				frame.ucf_x = ev[slip::O_UCF_ANALOG];
+				frame.percent_pre = slip::readBE4F(&ev[slip::O_DAMAGE_PRE]);
+			}
+		}));
+
+		slip::FrameDecoders decoders;
+		const slip::SimdLevel detected_level = slip::simdLevel();
+		for (int level = slip::SIMD_SCALAR; level <= detected_level; ++level) {
+			slip::SimdLevel simd_level = static_cast<slip::SimdLevel>(level);
+			BenchResult result = TimeBest(std::string("framedecode/") + slip::simdLevelName(simd_level), total_bytes, iterations, [&]() {
+				for (size_t iEvent = 0; iEvent < event_count; ++iEvent) {
+					decoders.pre.decode(&events[iEvent * event_size], event_size, frames[iEvent], simd_level);
+				}
+			});
+			// Compare bit patterns rather than floats, so NaNs from the random data still count as equal
+			result.is_valid = true;
+			for (size_t iEvent = 0; iEvent < event_count && result.is_valid; ++iEvent) {
+				result.is_valid = std::memcmp(&frames[iEvent].pos_x_pre, &reference[iEvent].pos_x_pre, sizeof(float)) == 0
+					&& std::memcmp(&frames[iEvent].percent_pre, &reference[iEvent].percent_pre, sizeof(float)) == 0
+					&& frames[iEvent].seed == reference[iEvent].seed && frames[iEvent].buttons == reference[iEvent].buttons;
+			}
+			results.push_back(result);
+		}
+		return results;
+	}
+
+	namespace {
+		// Puts decoded frames in a flat array indexed by frame number and port, like the parser's per-player frame arrays
+		struct BenchFrameSink : slip::FrameSink {
+			std::vector<slip::SlippiFrame>& frames;
+			std::vector<slip::SlippiItemFrame>& items;
+
+			slip::SlippiFrame* frameAt(const char* ev) {
+				size_t iFrame = static_cast<size_t>(slip::readBE4U(const_cast<char*>(&ev[slip::O_FRAME]))) * 2 + (ev[slip::O_PLAYER] & 1);
+				return iFrame < frames.size() ? &frames[iFrame] : nullptr;
+			}
+			slip::SlippiFrame* preFrame(const char* ev) { return frameAt(ev); }
+			slip::SlippiFrame* postFrame(const char* ev) { return frameAt(ev); }
+			slip::SlippiItemFrame* itemFrame(const char* ev) {
+				size_t iItem = slip::readBE4U(const_cast<char*>(&ev[slip::O_FRAME]));
+				return iItem < items.size() ? &items[iItem] : nullptr;
+			}
+		};
+
+		// Raw replay with two players' pre/post-frame events and one item update per frame, sized for the given version
+		std::string make_replay(uint32_t version, size_t frame_count) {
+			const unsigned pre_size = slip::PRE_FRAME_BANDS.layout[slip::frameBandForVersion(slip::PRE_FRAME_BANDS, version)].ev_size;
+			const unsigned post_size = slip::POST_FRAME_BANDS.layout[slip::frameBandForVersion(slip::POST_FRAME_BANDS, version)].ev_size;
+			const bool has_items = version >= slip::ITEM_FRAME_BANDS.version[0];
+			const unsigned item_size = has_items ? slip::ITEM_FRAME_BANDS.layout[slip::frameBandForVersion(slip::ITEM_FRAME_BANDS, version)].ev_size : 0;
+
+			std::string raw;
+			auto add_size = [&](uint8_t ev_code, unsigned ev_size) {
+				raw += static_cast<char>(ev_code);
+				raw += static_cast<char>((ev_size - 1) >> 8);
+				raw += static_cast<char>((ev_size - 1) & 0xFF);
+			};
+			raw += static_cast<char>(Event::EV_PAYLOADS);
+			raw += static_cast<char>(has_items ? 10 : 7);
+			add_size(Event::PRE_FRAME, pre_size);
+			add_size(Event::POST_FRAME, post_size);
+			if (has_items) {
+				add_size(Event::ITEM_UPDATE, item_size);
+			}
+
+			std::mt19937 rng(0x5EED);
+			auto add_event = [&](uint8_t ev_code, unsigned ev_size, uint32_t frame, uint8_t port) {
+				size_t start = raw.size();
+				raw.resize(start + ev_size);
+				raw[start] = static_cast<char>(ev_code);
+				for (size_t iByte = start + 1; iByte < raw.size(); ++iByte) {
+					raw[iByte] = static_cast<char>(rng());
+				}
+				slip::writeBE4U(frame, &raw[start + slip::O_FRAME]);
+				raw[start + slip::O_PLAYER] = static_cast<char>(port);
+			};
+			for (uint32_t iFrame = 0; iFrame < frame_count; ++iFrame) {
+				for (uint8_t port = 0; port < 2; ++port) {
+					add_event(Event::PRE_FRAME, pre_size, iFrame, port);
+				}
+				for (uint8_t port = 0; port < 2; ++port) {
+					add_event(Event::POST_FRAME, post_size, iFrame, port);
+				}
+				if (has_items) {
+					add_event(Event::ITEM_UPDATE, item_size, iFrame, 0);
+				}
+			}
+
+			std::string slp(N_HEADER_BYTES, '\0');
+			std::memcpy(&slp[0], "{U\x03raw[$U#l", 11);
+			slip::writeBE4U(static_cast<uint32_t>(raw.size()), &slp[11]);
+			return slp + raw;
+		}
+
+		std::string version_name(uint32_t version) {
+			return std::to_string(version >> 16) + "." + std::to_string((version >> 8) & 0xFF) + "." + std::to_string(version & 0xFF);
+		}
+	}
+
+	std::vector<BenchResult> BenchFrameLoop(size_t frame_count, size_t iterations) {
+		std::vector<BenchResult> results;
+		for (unsigned band = 0; band < slip::FRAME_LOOP_VERSIONS.n; ++band) {
+			const uint32_t version = slip::FRAME_LOOP_VERSIONS.version[band];
+			const uint8_t maj = static_cast<uint8_t>(version >> 16), min = static_cast<uint8_t>(version >> 8), rev = static_cast<uint8_t>(version);
+			const std::string slp = make_replay(version, frame_count);
+			const double total_bytes = static_cast<double>(slp.size() - N_HEADER_BYTES);
+
+			std::vector<slip::SlippiFrame> reference_frames(frame_count * 2), frames(frame_count * 2);
+			std::vector<slip::SlippiItemFrame> reference_items(frame_count), items(frame_count);
+			// Zero the padding too, since the results are compared bytewise
+			for (auto* frame_array : { &reference_frames, &frames }) {
+				std::memset(static_cast<void*>(frame_array->data()), 0, frame_array->size() * sizeof(slip::SlippiFrame));
+			}
+			for (auto* item_array : { &reference_items, &items }) {
+				std::memset(static_cast<void*>(item_array->data()), 0, item_array->size() * sizeof(slip::SlippiItemFrame));
+			}
+			BenchFrameSink reference_sink{ {}, reference_frames, reference_items };
+			BenchFrameSink sink{ {}, frames, items };
+			slip::EventStream stream;
+			stream.open(slp.data(), static_cast<uint32_t>(slp.size()));
+			const uint32_t first_event = stream.firstEvent();
+
+			const std::string prefix = "frameloop/" + version_name(version) + "/";
+			results.push_back(TimeBest(prefix + "generic", total_bytes, iterations, [&]() {
+				stream.seek(first_event);
+				slip::runFrameLoopGeneric(stream, version, reference_sink);
+			}));
+			for (slip::SimdLevel simd_level : { slip::SIMD_SCALAR, slip::simdLevel() }) {
+				BenchResult result = TimeBest(prefix + "specialized/" + slip::simdLevelName(simd_level), total_bytes, iterations, [&]() {
+					stream.seek(first_event);
+					slip::runFrameLoop(stream, maj, min, rev, sink, simd_level);
+				});
+				result.is_valid = std::memcmp(frames.data(), reference_frames.data(), frames.size() * sizeof(slip::SlippiFrame)) == 0
+					&& std::memcmp(items.data(), reference_items.data(), items.size() * sizeof(slip::SlippiItemFrame)) == 0;
+				results.push_back(result);
+				if (slip::simdLevel() == slip::SIMD_SCALAR) {
+					break;
+				}
+			}
+		}
+		return results;
+	}
+
+	namespace {
+		// Frames a bookend lags behind its own frame in the live check, i.e. how far the synthetic game can roll back
+		constexpr int32_t LIVE_CHECK_ROLLBACK = 7;
+
+		// Raw events (payload sizes included) of a two-player 3.7.0 game in the order Dolphin writes them: each frame's pre and post-frame
+		// events then a bookend finalizing the frame LIVE_CHECK_ROLLBACK frames back. Both ports' percent climbs to 149 and wraps, and
+		// port 2 loses a stock every 600 frames
+		std::string make_live_events(int32_t frame_count, bool game_end) {
+			const uint32_t version = slip::slippiVersion(3, 7, 0);
+			const unsigned start_size = slip::O_RNG_GAME_START + 4;
+			const unsigned pre_size = slip::PRE_FRAME_BANDS.layout[slip::frameBandForVersion(slip::PRE_FRAME_BANDS, version)].ev_size;
+			const unsigned post_size = slip::POST_FRAME_BANDS.layout[slip::frameBandForVersion(slip::POST_FRAME_BANDS, version)].ev_size;
+			const unsigned bookend_size = slip::O_ROLLBACK_FRAME + 4;
+			const unsigned end_size = slip::O_LRAS + 1;
+
+			std::string raw;
+			auto add_size = [&](uint8_t ev_code, unsigned ev_size) {
+				raw += static_cast<char>(ev_code);
+				raw += static_cast<char>((ev_size - 1) >> 8);
+				raw += static_cast<char>((ev_size - 1) & 0xFF);
+			};
+			raw += static_cast<char>(Event::EV_PAYLOADS);
+			raw += static_cast<char>(16);
+			add_size(Event::GAME_START, start_size);
+			add_size(Event::PRE_FRAME, pre_size);
+			add_size(Event::POST_FRAME, post_size);
+			add_size(Event::BOOKEND, bookend_size);
+			add_size(Event::GAME_END, end_size);
+			auto add_event = [&](uint8_t ev_code, unsigned ev_size) {
+				raw.append(ev_size, '\0');
+				raw[raw.size() - ev_size] = static_cast<char>(ev_code);
+				return &raw[raw.size() - ev_size];
+			};
+
+			char* game_start = add_event(Event::GAME_START, start_size);
+			slip::writeBE4U(version << 8, &game_start[slip::O_SLP_MAJ]);
+			for (unsigned iPort = 0; iPort < 4; ++iPort) {
+				char* player_block = &game_start[slip::O_PLAYERDATA + LIVE_PLAYER_BLOCK * iPort];
+				player_block[slip::O_PLAYER_TYPE] = static_cast<char>(iPort < 2 ? 0 : 3);
+				player_block[slip::O_START_STOCKS] = 4;
+			}
+			for (int32_t iFrame = 0; iFrame < frame_count; ++iFrame) {
+				const uint32_t frame = static_cast<uint32_t>(LOAD_FRAME + iFrame);
+				for (uint8_t port = 0; port < 2; ++port) {
+					char* pre_frame = add_event(Event::PRE_FRAME, pre_size);
+					slip::writeBE4U(frame, &pre_frame[slip::O_FRAME]);
+					pre_frame[slip::O_PLAYER] = static_cast<char>(port);
+				}
+				for (uint8_t port = 0; port < 2; ++port) {
+					char* post_frame = add_event(Event::POST_FRAME, post_size);
+					slip::writeBE4U(frame, &post_frame[slip::O_FRAME]);
+					post_frame[slip::O_PLAYER] = static_cast<char>(port);
+					post_frame[slip::O_STOCKS] = static_cast<char>(port == 0 ? 4 : 4 - iFrame / 600);
+					float percent = static_cast<float>(iFrame % 150);
+					uint32_t percent_bits;
+					std::memcpy(&percent_bits, &percent, 4);
+					slip::writeBE4U(percent_bits, &post_frame[slip::O_DAMAGE_POST]);
+				}
+				char* bookend = add_event(Event::BOOKEND, bookend_size);
+				slip::writeBE4U(frame, &bookend[slip::O_BOOKEND_FRAME]);
+				slip::writeBE4U(frame - LIVE_CHECK_ROLLBACK, &bookend[slip::O_ROLLBACK_FRAME]);
+			}
+			if (game_end) {
+				char* end = add_event(Event::GAME_END, end_size);
+				end[slip::O_END_METHOD] = 2;
+				end[slip::O_LRAS] = -1;
+			}
+			return raw;
+		}
+
+		// Expects every frame from LOAD_FRAME on, each once and in order
+		struct LiveCheckListener : slip::LiveListener {
+			int32_t next_frame = LOAD_FRAME;
+			bool in_order = true;
+			bool game_ended = false;
+
+			void onGameStart(const slip::SlippiReplay&) override {
+				next_frame = LOAD_FRAME;
+				in_order = true;
+				game_ended = false;
+			}
+			void onFrame(const slip::SlippiReplay&, int32_t frame) override { in_order &= frame == next_frame++; }
+			void onGameEnd(const slip::SlippiReplay&) override { game_ended = true; }
+		};
+
+		// Whether the listeners saw exactly the frames up to last_frame of a game made by make_live_events
+		bool live_check_valid(const slip::LiveParser& live_parser, const LiveCheckListener& listener, const slip::LiveSummary& summary, int32_t last_frame, bool game_end) {
+			const int32_t iLast = last_frame - LOAD_FRAME;
+			return listener.in_order && listener.next_frame == last_frame + 1 && live_parser.lastFinalFrame() == last_frame
+				&& listener.game_ended == game_end && live_parser.gameEnded() == game_end
+				&& summary.frame == last_frame && summary.port[0].stocks == 4 && summary.port[1].stocks == 4 - iLast / 600
+				&& summary.port[1].deaths == static_cast<unsigned>(iLast / 600) && summary.port[1].percent == static_cast<float>(iLast % 150);
+		}
+
+		// Writes a replay to path the way Dolphin does: the header with a zero raw length, then the raw events a few hundred bytes
+		// at a time, updating the parser after every write, and once the game is over the metadata and then the real raw length.
+		// Returns whether every update succeeded
+		bool write_live_replay(slip::LiveParser& live_parser, const std::filesystem::path& path, const std::string& raw, std::mt19937& rng) {
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			std::string header(N_HEADER_BYTES, '\0');
+			std::memcpy(&header[0], "{U\x03raw[$U#l", 11);
+			file.write(header.data(), header.size());
+			file.flush();
+			if (!file || !live_parser.open(path.string())) {
+				return false;
+			}
+			bool is_valid = true;
+			for (size_t pos = 0; pos < raw.size();) {
+				size_t write_size = std::min<size_t>(1 + rng() % 400, raw.size() - pos);
+				file.write(&raw[pos], write_size);
+				file.flush();
+				pos += write_size;
+				is_valid &= live_parser.update() >= 0;
+			}
+			const std::string metadata = "U\x08metadata{}}";
+			file.write(metadata.data(), metadata.size());
+			slip::writeBE4U(static_cast<uint32_t>(raw.size()), &header[11]);
+			file.seekp(11);
+			file.write(&header[11], 4);
+			file.flush();
+			is_valid &= live_parser.update() >= 0;
+			return is_valid && file.good();
+		}
+	}
+
+	std::vector<BenchResult> CheckLiveParser(int32_t frame_count) {
+		const std::filesystem::path temp_dir = std::filesystem::temp_directory_path();
+		const std::filesystem::path ended_path = temp_dir / "crunch-livecheck-ended.slp";
+		const std::filesystem::path cut_path = temp_dir / "crunch-livecheck-cut.slp";
+		const std::string ended_raw = make_live_events(frame_count, true);
+		const std::string cut_raw = make_live_events(frame_count, false);
+		const int32_t last_frame = LOAD_FRAME + frame_count - 1;
+		std::mt19937 rng(8);
+
+		// One parser for every scenario, so each open() also has to forget the previous file
+		slip::LiveParser live_parser(0);
+		LiveCheckListener listener;
+		slip::LiveSummary summary;
+		live_parser.addListener(&listener);
+		live_parser.addListener(&summary);
+
+		// Timed once: the writes and updates are the measurement, there's nothing to repeat
+		auto run_check = [](const std::string& name, size_t bytes, auto&& check) {
+			BenchResult result{ name, static_cast<double>(bytes) };
+			auto begin_time = std::chrono::steady_clock::now();
+			result.is_valid = check();
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count();
+			return result;
+		};
+		std::vector<BenchResult> results;
+		// A game followed from its first byte to its game end event
+		results.push_back(run_check("livecheck/ended", ended_raw.size(), [&]() {
+			return write_live_replay(live_parser, ended_path, ended_raw, rng)
+				&& live_check_valid(live_parser, listener, summary, last_frame, true);
+		}));
+		// A game cut short without a game end event, so only the raw length keeps the parser out of the metadata after it
+		results.push_back(run_check("livecheck/cut", cut_raw.size(), [&]() {
+			return write_live_replay(live_parser, cut_path, cut_raw, rng)
+				&& live_check_valid(live_parser, listener, summary, last_frame - LIVE_CHECK_ROLLBACK, false);
+		}));
+		// The finished first game again, all in one update
+		results.push_back(run_check("livecheck/reopen", ended_raw.size(), [&]() {
+			return live_parser.open(ended_path.string()) && live_parser.update() > 0
+				&& live_check_valid(live_parser, listener, summary, last_frame, true);
+		}));
+
+		std::filesystem::remove(ended_path);
+		std::filesystem::remove(cut_path);
+		return results;
+	}
+
+	std::vector<BenchResult> CheckChunked(int32_t frame_count, unsigned chunk_frames) {
+		// A finished synthetic game, with metadata that differs from the placeholder the chunks in the middle carry
+		const std::string raw = make_live_events(frame_count, true);
+		const std::string metadata = std::string("U\x08metadata{U\x08playedOnSU\x07") + "dolphin}}";
+		std::string slp(N_HEADER_BYTES, '\0');
+		std::memcpy(&slp[0], "{U\x03raw[$U#l", 11);
+		slip::writeBE4U(static_cast<uint32_t>(raw.size()), &slp[11]);
+		slp += raw + metadata;
+		const uint32_t slp_size = static_cast<uint32_t>(slp.size());
+
+		// The payload sizes and game start, which every chunk's frame window has to start with
+		slip::EventStream stream;
+		stream.open(slp.data(), slp_size);
+		stream.next();
+		const std::string prelude = slp.substr(N_HEADER_BYTES, stream.pos() - N_HEADER_BYTES);
+
+		std::vector<BenchResult> results;
+		for (bool predicted : { false, true }) {
+			BenchResult result{ std::string("chunkedcheck/") + (predicted ? "predicted" : "compressor"), static_cast<double>(slp.size()) };
+			auto begin_time = std::chrono::steady_clock::now();
+			slip::ChunkedCompressor encoder(0, chunk_frames, 0, predicted);
+			slip::ChunkedCompressor decoder(0);
+			std::string chunked;
+			std::string decoded;
+			bool is_valid = encoder.encode(slp.data(), slp_size, &chunked) && decoder.load(chunked.data(), static_cast<uint32_t>(chunked.size()))
+				&& decoder.chunks().size() > 1 && decoder.decode(&decoded) && decoded == slp;
+
+			// Each chunk's frame window on its own: the prelude, the chunk's own events as they are in the source, and the metadata on the last one only
+			std::string events;
+			for (size_t iChunk = 0; is_valid && iChunk < decoder.chunks().size(); ++iChunk) {
+				const slip::ChunkInfo& chunk = decoder.chunks()[iChunk];
+				std::string window;
+				is_valid = decoder.decodeFrames(chunk.min_frame, chunk.max_frame, &window) && window.size() >= N_HEADER_BYTES
+					&& window.compare(N_HEADER_BYTES, prelude.size(), prelude) == 0;
+				if (is_valid) {
+					const size_t window_end = N_HEADER_BYTES + slip::readBE4U(&window[11]);
+					const size_t own_start = N_HEADER_BYTES + (iChunk == 0 ? 0 : prelude.size());
+					const bool is_last = iChunk + 1 == decoder.chunks().size();
+					is_valid = own_start <= window_end && window_end <= window.size()
+						&& window.compare(window_end, std::string::npos, is_last ? metadata : EMPTY_SLP_METADATA) == 0;
+					if (is_valid) {
+						events.append(window, own_start, window_end - own_start);
+					}
+				}
+			}
+			result.is_valid = is_valid && events == raw;
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count();
+			results.push_back(result);
+		}
+		return results;
+	}
+
+	namespace {
+		// Text with an escape every few dozen characters on average, like tags, names and metadata strings
+		std::vector<std::string> make_json_strings(size_t string_count) {
+			const char specials[] = { '"', '\\', '\n', '\t', '\x01' };
+			std::mt19937 rng(0x5EED);
+			std::vector<std::string> strings(string_count);
+			for (auto& str : strings) {
+				str.resize(16 + rng() % 112);
+				for (char& c : str) {
+					c = (rng() % 48 == 0) ? specials[rng() % sizeof(specials)] : static_cast<char>(' ' + 1 + rng() % 94);
+				}
+			}
+			return strings;
+		}
+
+		// Post-frame values that print the same through an ostream and through the shortest round-trip float form
+		struct BenchJsonFrame {
+			int32_t frame;
+			uint8_t player;
+			uint16_t action_post;
+			float pos_x_post;
+			float pos_y_post;
+			float percent_post;
+			uint8_t stocks;
+		};
+	}
+
+	std::vector<BenchResult> BenchJson(size_t item_count, size_t iterations) {
+		std::vector<BenchResult> results;
+
+		// Escaping: escape_json per string versus the writer's run-based escaping at every SIMD level
+		const std::vector<std::string> strings = make_json_strings(item_count);
+		double string_bytes = 0.0;
+		for (const auto& str : strings) {
+			string_bytes += static_cast<double>(str.size());
+		}
+		std::string reference;
+		results.push_back(TimeBest("json/escape/escape_json", string_bytes, iterations, [&]() {
+			reference.clear();
+			for (const auto& str : strings) {
+				reference += (reference.empty() ? "[\"" : ",\"") + slip::escape_json(str) + "\"";
+			}
+			reference += "]";
+		}));
+		std::string out;
+		const slip::SimdLevel detected_level = slip::simdLevel();
+		for (int level = slip::SIMD_SCALAR; level <= std::min<int>(detected_level, slip::SIMD_SSE2); ++level) {
+			slip::SimdLevel simd_level = static_cast<slip::SimdLevel>(level);
+			BenchResult result = TimeBest(std::string("json/escape/") + slip::simdLevelName(simd_level), string_bytes, iterations, [&]() {
+				out.clear();
+				slip::JsonWriter writer(&out);
+				writer.setSimdLevel(simd_level);
+				writer.beginArray();
+				for (const auto& str : strings) {
+					writer.value(str);
+				}
+				writer.endArray();
+			});
+			result.is_valid = (out == reference);
+			results.push_back(result);
+		}
+
+		// Frame export: building the document through an ostringstream versus streaming it through the writer
+		std::vector<BenchJsonFrame> frames(item_count);
+		for (size_t iFrame = 0; iFrame < frames.size(); ++iFrame) {
+			frames[iFrame] = { static_cast<int32_t>(iFrame) - 123, static_cast<uint8_t>(iFrame % 2), static_cast<uint16_t>(iFrame % 341),
+				static_cast<float>(iFrame % 4000) * 0.25f - 500.0f, static_cast<float>(iFrame % 300) * 0.5f, static_cast<float>(iFrame % 1000) * 0.5f,
+				static_cast<uint8_t>(4 - iFrame % 4) };
+		}
+		const double frame_bytes = static_cast<double>(frames.size() * sizeof(BenchJsonFrame));
+		results.push_back(TimeBest("json/frames/ostringstream", frame_bytes, iterations, [&]() {
+			std::ostringstream ss;
+			ss << "[";
+			for (size_t iFrame = 0; iFrame < frames.size(); ++iFrame) {
+				const BenchJsonFrame& f = frames[iFrame];
+				ss << (iFrame == 0 ? "" : ",") << "{\"frame\":" << f.frame << ",\"player\":" << int(f.player) << ",\"action_post\":" << f.action_post
+					<< ",\"pos_x_post\":" << f.pos_x_post << ",\"pos_y_post\":" << f.pos_y_post << ",\"percent_post\":" << f.percent_post
+					<< ",\"stocks\":" << int(f.stocks) << "}";
+			}
+			ss << "]";
+			reference = ss.str();
+		}));
+		BenchResult result = TimeBest("json/frames/writer", frame_bytes, iterations, [&]() {
+			out.clear();
+			slip::JsonWriter writer(&out);
+			writer.beginArray();
+			for (const BenchJsonFrame& f : frames) {
+				writer.beginObject()
+					.field("frame", f.frame).field("player", f.player).field("action_post", f.action_post)
+					.field("pos_x_post", f.pos_x_post).field("pos_y_post", f.pos_y_post).field("percent_post", f.percent_post)
+					.field("stocks", f.stocks)
+					.endObject();
+			}
+			writer.endArray();
+		});
+		result.is_valid = (out == reference);
+		results.push_back(result);
+		return results;
+	}
+
+	namespace {
+		// Analysis with a typical game's worth of attacks and punishes for each player
+		std::unique_ptr<slip::Analysis> make_analysis(unsigned frame_count, size_t attack_count) {
+			auto analysis = std::make_unique<slip::Analysis>(frame_count);
+			std::mt19937 rng(0x5EED);
+			analysis->success = true;
+			analysis->stage_id = 31;
+			analysis->stage_name = "Battlefield";
+			analysis->game_length = frame_count;
+			analysis->end_type = 2;
+			analysis->lras_player = -1;
+			for (unsigned iFrame = 0; iFrame < frame_count; ++iFrame) {
+				analysis->dynamics[iFrame] = rng() % Dynamic::__LAST;
+			}
+			for (size_t iPlayer = 0; iPlayer < 2; ++iPlayer) {
+				slip::AnalysisPlayer& player = analysis->ap[iPlayer];
+				player.port = static_cast<unsigned>(iPlayer);
+				player.tag_code = iPlayer == 0 ? "AAAA#111" : "BBBB#222";
+				player.char_name = "Fox";
+				player.damage_dealt = static_cast<float>(rng() % 500);
+				player.apm = static_cast<float>(rng() % 400) * 0.5f;
+				for (size_t iMove = 0; iMove < Move::__LAST; ++iMove) {
+					player.move_counts[iMove] = rng() % 8;
+				}
+				for (size_t iAttack = 0; iAttack < attack_count; ++iAttack) {
+					slip::Attack& attack = player.attacks[iAttack];
+					attack.move_id = static_cast<uint8_t>(rng() % 64);
+					attack.punish_id = static_cast<uint8_t>(iAttack / 4);
+					attack.frame = static_cast<unsigned>(iAttack * 37 + 1);
+					attack.damage = static_cast<float>(rng() % 20);
+					slip::Punish& punish = player.punishes[iAttack / 4];
+					punish.num_moves = static_cast<uint8_t>(iAttack % 4 + 1);
+					punish.end_frame = attack.frame;
+					punish.end_pct += attack.damage;
+				}
+			}
+			return analysis;
+		}
+	}
+
+	std::vector<BenchResult> BenchAnalysisFile(size_t analysis_count, size_t iterations) {
+		const std::unique_ptr<slip::Analysis> analysis = make_analysis(8 * 60 * 60, 400);
+		std::vector<std::string> files(analysis_count);
+		double total_bytes = 0.0;
+		std::vector<BenchResult> results;
+		results.push_back(TimeBest("analysisfile/serialize", 0.0, iterations, [&]() {
+			for (auto& file : files) {
+				file = SerializeAnalysis(*analysis);
+			}
+		}));
+		for (const auto& file : files) {
+			total_bytes += static_cast<double>(file.size());
+		}
+		results.back().bytes = total_bytes;
+
+		// std::string storage is at least 8-byte aligned, like a mapping
+		float damage_sum = 0.0f;
+		BenchResult view_result = TimeBest("analysisfile/view", total_bytes, iterations, [&]() {
+			damage_sum = 0.0f;
+			for (const auto& file : files) {
+				AnalysisView view;
+				if (view.Open(file.data(), file.size())) {
+					for (size_t iAttack = 0; iAttack < view.AttackCount(0); ++iAttack) {
+						damage_sum += view.Attacks(0)[iAttack].damage;
+					}
+				}
+			}
+		});
+		float expected_sum = 0.0f;
+		for (size_t iFile = 0; iFile < files.size(); ++iFile) {
+			for (size_t iAttack = 0; analysis->ap[0].attacks[iAttack].frame > 0; ++iAttack) {
+				expected_sum += analysis->ap[0].attacks[iAttack].damage;
+			}
+		}
+		view_result.is_valid = damage_sum == expected_sum;
+		results.push_back(view_result);
+
+		bool loaded_ok = true;
+		BenchResult load_result = TimeBest("analysisfile/load", total_bytes, iterations, [&]() {
+			for (const auto& file : files) {
+				AnalysisView view;
+				loaded_ok &= view.Open(file.data(), file.size()) && view.Load() != nullptr;
+			}
+		});
+		AnalysisView view;
+		load_result.is_valid = loaded_ok && view.Open(files[0].data(), files[0].size()) && SameAnalysis(*view.Load(), *analysis);
+		results.push_back(load_result);
+		return results;
+	}
+
+	namespace {
+		// Combos of 1 to 16 attacks with random moves (out of the first move_count ids) and damage, about one in four killing
+		ComboSet make_combos(size_t combo_count, size_t move_count = 64) {
+			std::mt19937 rng(4);
+			ComboSet combos;
+			combos.BeginReplay();
+			std::vector<slip::Attack> attacks;
+			for (size_t iCombo = 0; iCombo < combo_count; ++iCombo) {
+				attacks.resize(1 + rng() % 16);
+				for (slip::Attack& attack : attacks) {
+					attack.move_id = static_cast<uint8_t>(rng() % move_count);
+					attack.damage = static_cast<float>(rng() % 200) / 10.0f;
+				}
+				slip::Punish punish;
+				punish.start_frame = rng() % 10000;
+				punish.end_frame = punish.start_frame + static_cast<unsigned>(attacks.size()) * 20;
+				punish.start_pct = static_cast<float>(rng() % 150);
+				punish.kill_dir = rng() % 4 == 0 ? static_cast<uint8_t>(Dir::UP) : static_cast<uint8_t>(Dir::NEUT);
+				combos.AddCombo(attacks.data(), attacks.size(), punish);
+			}
+			return combos;
+		}
+	}
+
+	std::vector<BenchResult> BenchComboScore(size_t combo_count, size_t feature_combo_count, size_t iterations) {
+		std::vector<BenchResult> results;
+
+		// Feature extraction: the separate per-metric scans versus one pass per combo
+		const ComboSet combos = make_combos(feature_combo_count);
+		const double attack_bytes = static_cast<double>(combos.AttackCount() * sizeof(slip::Attack));
+		size_t scan_unique_sum = 0;
+		results.push_back(TimeBest("comboscore/features/scans", attack_bytes, iterations, [&]() {
+			scan_unique_sum = 0;
+			for (ComboView combo : combos.Combos()) {
+				scan_unique_sum += combo.TotalDamage() + combo.HighestSingleAttackDamage() + combo.UniqueMoveCount();
+			}
+		}));
+		ComboFeatureTable table;
+		BenchResult features_result = TimeBest("comboscore/features/onepass", attack_bytes, iterations, [&]() {
+			table.Clear();
+			table.Append(combos);
+		});
+		size_t onepass_unique_sum = 0;
+		for (size_t iCombo = 0; iCombo < table.Size(); ++iCombo) {
+			const ComboView combo = combos.Combo(iCombo);
+			onepass_unique_sum += combo.TotalDamage() + combo.HighestSingleAttackDamage() + static_cast<size_t>(table.Column(COMBO_FEATURE_UNIQUE_MOVE_COUNT)[iCombo]);
+		}
+		features_result.is_valid = onepass_unique_sum == scan_unique_sum;
+		results.push_back(features_result);
+
+		// Batch scoring over a table of random features, every SIMD level checked against the scalar scores
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<float> feature_dist(0.0f, 100.0f);
+		table.Clear();
+		table.Reserve(combo_count);
+		for (size_t iCombo = 0; iCombo < combo_count; ++iCombo) {
+			ComboFeatureVector features;
+			for (float& feature : features) {
+				feature = feature_dist(rng);
+			}
+			table.Add(features);
+		}
+		const ComboScoreWeights weights;
+		const double table_bytes = static_cast<double>(combo_count * COMBO_FEATURE_COUNT * sizeof(float));
+		std::vector<float> reference_scores(combo_count);
+		std::vector<float> scores(combo_count);
+		const slip::SimdLevel detected_level = slip::simdLevel();
+		for (slip::SimdLevel simd_level : { slip::SIMD_SCALAR, slip::SIMD_SSE2, slip::SIMD_AVX2 }) {
+			if (simd_level > detected_level) {
+				continue;
+			}
+			std::vector<float>& level_scores = simd_level == slip::SIMD_SCALAR ? reference_scores : scores;
+			BenchResult result = TimeBest(std::string("comboscore/score/") + slip::simdLevelName(simd_level), table_bytes, iterations, [&]() {
+				ScoreCombos(table, weights, level_scores.data(), simd_level);
+			});
+			result.is_valid = level_scores == reference_scores;
+			results.push_back(result);
+		}
+		return results;
+	}
+
+	std::vector<BenchResult> BenchComboFilter(size_t combo_count, size_t iterations) {
+		const ComboSet combos = make_combos(combo_count);
+		const std::unique_ptr<slip::Analysis> analysis = make_analysis(60, 0);
+		std::vector<ComboFilterRow> rows;
+		rows.reserve(combo_count);
+		for (size_t iCombo = 0; iCombo < combo_count; ++iCombo) {
+			rows.emplace_back(combos.Combo(iCombo), analysis.get(), iCombo % 2);
+		}
+		const double row_bytes = static_cast<double>(rows.size() * sizeof(ComboFilterRow));
+
+		std::vector<BenchResult> results;
+		size_t reference_count = 0;
+		BenchResult reference_result = TimeBest("combofilter/handwritten", row_bytes, iterations, [&]() {
+			reference_count = 0;
+			for (const ComboFilterRow& row : rows) {
+				const ComboFeatureVector& f = row.features;
+				reference_count += f[COMBO_FEATURE_KILL] != 0.0f && f[COMBO_FEATURE_MOVE_COUNT] >= 7 && f[COMBO_FEATURE_DAMAGE] >= 60
+					&& f[COMBO_FEATURE_HIGHEST_ATTACK_DAMAGE] / f[COMBO_FEATURE_DAMAGE] <= 0.25 && row.Player()->tag_code == "AAAA#111";
+			}
+		});
+		reference_result.items = combo_count;
+		results.push_back(reference_result);
+
+		constexpr auto template_filter = Filter::kill && Filter::moves >= 7 && Filter::damage >= 60 && Filter::max_hit_ratio <= 0.25 && Filter::player_code == "AAAA#111";
+		size_t template_count = 0;
+		BenchResult template_result = TimeBest("combofilter/template", row_bytes, iterations, [&]() {
+			template_count = 0;
+			for (const ComboFilterRow& row : rows) {
+				template_count += template_filter(row);
+			}
+		});
+		template_result.items = combo_count;
+		template_result.is_valid = template_count == reference_count;
+		results.push_back(template_result);
+
+		ComboFilter bytecode_filter;
+		bool compiled = bytecode_filter.Compile("kill && moves >= 7 && damage >= 60 && max_hit_ratio <= 0.25 && player.code == \"AAAA#111\"");
+		size_t bytecode_count = 0;
+		BenchResult bytecode_result = TimeBest("combofilter/bytecode", row_bytes, iterations, [&]() {
+			bytecode_count = 0;
+			for (const ComboFilterRow& row : rows) {
+				bytecode_count += bytecode_filter(row);
+			}
+		});
+		bytecode_result.items = combo_count;
+		bytecode_result.is_valid = compiled && bytecode_count == reference_count;
+		results.push_back(bytecode_result);
+		return results;
+	}
+
+	std::vector<BenchResult> BenchNgramIndex(size_t combo_count, size_t query_count, size_t iterations) {
+		const ComboSet combos = make_combos(combo_count, 12);
+		const double attack_bytes = static_cast<double>(combos.AttackCount() * sizeof(slip::Attack));
+		std::vector<BenchResult> results;
+		MoveNgramIndex index;
+		BenchResult build_result = TimeBest("ngramindex/build", attack_bytes, iterations, [&]() {
+			index.Clear();
+			index.Add(combos);
+		});
+		build_result.items = combo_count;
+		results.push_back(build_result);
+
+		// Sequences of 3 to 5 moves taken from the combos, so every query has at least one match
+		std::mt19937 rng(6);
+		std::vector<std::vector<uint8_t>> queries;
+		while (queries.size() < query_count) {
+			const ComboView combo = combos.Combo(rng() % combos.ComboCount());
+			const size_t length = 3 + rng() % 3;
+			if (combo.attack_count >= length) {
+				const size_t begin = rng() % (combo.attack_count - length + 1);
+				std::vector<uint8_t> moves;
+				for (size_t iAttack = begin; iAttack < begin + length; ++iAttack) {
+					moves.push_back(combo.attacks[iAttack].move_id);
+				}
+				queries.push_back(moves);
+			}
+		}
+
+		size_t hit_count = 0;
+		BenchResult query_result = TimeBest("ngramindex/query", attack_bytes * static_cast<double>(query_count), iterations, [&]() {
+			hit_count = 0;
+			for (const auto& moves : queries) {
+				hit_count += index.Find(moves).size();
+			}
+		});
+		query_result.items = query_count;
+
+		// Reference: scanning every combo's attacks, for a few of the queries
+		const size_t scan_query_count = std::min<size_t>(query_count, 8);
+		size_t scan_hit_count = 0;
+		size_t index_hit_count = 0;
+		BenchResult scan_result = TimeBest("ngramindex/scan", attack_bytes * static_cast<double>(scan_query_count), 1, [&]() {
+			scan_hit_count = 0;
+			for (size_t iQuery = 0; iQuery < scan_query_count; ++iQuery) {
+				const std::vector<uint8_t>& moves = queries[iQuery];
+				for (ComboView combo : combos.Combos()) {
+					for (size_t iAttack = 0; iAttack + moves.size() <= combo.attack_count; ++iAttack) {
+						size_t iMove = 0;
+						while (iMove < moves.size() && combo.attacks[iAttack + iMove].move_id == moves[iMove]) {
+							++iMove;
+						}
+						scan_hit_count += iMove == moves.size();
+					}
+				}
+			}
+		});
+		scan_result.items = scan_query_count;
+		for (size_t iQuery = 0; iQuery < scan_query_count; ++iQuery) {
+			index_hit_count += index.Find(queries[iQuery]).size();
+		}
+		query_result.is_valid = hit_count >= query_count && index_hit_count == scan_hit_count;
+		results.push_back(query_result);
+		results.push_back(scan_result);
+
+		// Replays the index already holds are skipped when added again, and their paths and hashes are saved with it
+		std::vector<MoveNgramReplay> replays(combos.ReplayCount());
+		for (size_t iReplay = 0; iReplay < replays.size(); ++iReplay) {
+			replays[iReplay].path = "replay" + std::to_string(iReplay) + ".slp";
+			replays[iReplay].content_hash = iReplay + 1;
+		}
+		index.Clear();
+		index.Add(combos, replays);
+		const bool skips_indexed = index.Add(combos, replays) == 0 && index.ComboCount() == combos.ComboCount();
+
+		const std::filesystem::path index_path = std::filesystem::temp_directory_path() / (std::string("crunch-bench") + MOVE_NGRAM_FILE_EXTENSION);
+		MoveNgramIndex loaded_index;
+		BenchResult load_result = TimeBest("ngramindex/saveload", static_cast<double>(index.PostingBytes()), 1, [&]() {
+			loaded_index.Clear();
+			index.Save(index_path);
+			loaded_index.Load(index_path);
+		});
+		load_result.is_valid = skips_indexed && loaded_index.ComboCount() == index.ComboCount() && loaded_index.Find(queries[0]).size() == index.Find(queries[0]).size()
+			&& loaded_index.Replays().size() == replays.size() && loaded_index.Replays().back().path == replays.back().path
+			&& loaded_index.Replays().back().content_hash == replays.back().content_hash && loaded_index.Add(combos, replays) == 0;
+		std::filesystem::remove(index_path);
+		results.push_back(load_result);
+		return results;
+	}
+
+	bool RunBenchmarks(const std::vector<std::string>& names) {
+		const std::vector<std::pair<std::string, std::function<std::vector<BenchResult>()>>> benchmarks = {
+			{ "shuffle", []() { return BenchShuffle(); } },
+			{ "shufflecheck", []() { return CheckShuffle(); } },
+			{ "framedecode", []() { return BenchFrameDecode(); } },
+			{ "frameloop", []() { return BenchFrameLoop(); } },
+			{ "livecheck", []() { return CheckLiveParser(); } },
+			{ "chunkedcheck", []() { return CheckChunked(); } },
+			{ "json", []() { return BenchJson(); } },
+			{ "analysisfile", []() { return BenchAnalysisFile(); } },
+			{ "comboscore", []() { return BenchComboScore(); } },
+			{ "combofilter", []() { return BenchComboFilter(); } },
+			{ "ngramindex", []() { return BenchNgramIndex(); } },
+		};
+
+		bool all_ok = true;
+		std::cout << "SIMD level: " << slip::simdLevelName(slip::simdLevel()) << std::endl;
+		for (const auto& name : names) {
+			auto is_known = [&](const auto& benchmark) { return benchmark.first == name; };
+			if (std::none_of(benchmarks.begin(), benchmarks.end(), is_known)) {
+				std::cout << "Unknown benchmark " << name << std::endl;
+				all_ok = false;
+			}
+		}
+		for (const auto& [name, bench_func] : benchmarks) {
+			if (!names.empty() && std::find(names.begin(), names.end(), name) == names.end()) {
+				continue;
+			}
+			for (const auto& result : bench_func()) {
+				PrintBenchResult(result);
+				all_ok &= result.is_valid;
+			}
+		}
+		return all_ok;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Crunch {
+	// One timed measurement; bytes is whatever the benchmark considers its throughput unit
+	struct BenchResult {
+		std::string name;
+		double bytes = 0.0;
+		double seconds = 0.0;
+		bool is_valid = true; // false if the output didn't match the reference implementation
+		size_t items = 0; // if set, the time per item is printed as well
+
+		double GBps() const { return seconds > 0.0 ? bytes / seconds / 1e9 : 0.0; }
+	};
+
+	void PrintBenchResult(const BenchResult& result);
+
+	// Times func over iterations runs (after one warm-up run) and returns the best run, which is the least noisy on a busy machine
+	template<typename F>
+	BenchResult TimeBest(const std::string& name, double bytes_per_run, size_t iterations, F&& func) {
+		func();
+		double best_seconds = std::numeric_limits<double>::max();
+		for (size_t iIteration = 0; iIteration < iterations; ++iIteration) {
+			auto begin_time = std::chrono::steady_clock::now();
+			func();
+			auto end_time = std::chrono::steady_clock::now();
+			best_seconds = std::min(best_seconds, std::chrono::duration<double>(end_time - begin_time).count());
+		}
+		return { name, bytes_per_run, best_seconds };
+	}
+
+	// Event column transpose (Compressor shuffling) bandwidth at every SIMD level the CPU supports
+	std::vector<BenchResult> BenchShuffle(size_t event_count = 1 << 18, size_t iterations = 20);
+
+	// Randomized equivalence check of the event column transpose: trial_count random column tables (every byte width from 1 to 8,
+	// bit columns and message-sized columns) over random entry counts, odd ones and tile boundaries included, shuffled and unshuffled
+	// at every SIMD level the CPU supports and compared byte for byte with the scalar reference; one result per level
+	std::vector<BenchResult> CheckShuffle(size_t trial_count = 2000);
+
+	// Pre-frame decoding: per-field readBE* calls versus the bulk FrameDecoder at every SIMD level the CPU supports; sized to stay in cache so it measures decoding, not memory bandwidth
+	std::vector<BenchResult> BenchFrameDecode(size_t event_count = 1 << 12, size_t iterations = 2000);
+
+	// Frame event loop throughput for every Slippi version band: generic per-field version checks versus the version-specialized loop
+	std::vector<BenchResult> BenchFrameLoop(size_t frame_count = 1 << 12, size_t iterations = 50);
+
+	// Live replay following: writes a synthetic game to a temp file a few hundred bytes at a time like Dolphin does, updating a LiveParser
+	// after every write, and checks that every frame is reported once, in order, only once final, and that the game end, the raw length
+	// filled in last and reopening another file are all handled; one result per scenario
+	std::vector<BenchResult> CheckLiveParser(int32_t frame_count = 2000);
+
+	// Chunked encoding round trip: a synthetic game split into chunk_frames-frame chunks, encoded through the Compressor and through the
+	// per-field predictors, then decoded whole and one chunk's frame window at a time, each compared byte for byte with the source replay;
+	// one result per mode
+	std::vector<BenchResult> CheckChunked(int32_t frame_count = 2000, unsigned chunk_frames = 600);
+
+	// JSON output: escape_json versus the streaming JsonWriter's escaping at every SIMD level, and frame export through an ostringstream versus the writer
+	std::vector<BenchResult> BenchJson(size_t item_count = 1 << 16, size_t iterations = 20);
+
+	// Binary analysis files: serializing, reading attacks in place through a view, and rebuilding full analyses
+	std::vector<BenchResult> BenchAnalysisFile(size_t analysis_count = 64, size_t iterations = 5);
+
+	// Combo ranking: per-metric scans versus one-pass feature extraction, then batch scoring of a combo_count feature table at every SIMD level the CPU supports
+	std::vector<BenchResult> BenchComboScore(size_t combo_count = 10000000, size_t feature_combo_count = 1 << 18, size_t iterations = 5);
+
+	// Combo filters: evaluation cost per combo of a hand-written predicate, a Filter expression and the same query compiled by ComboFilter
+	std::vector<BenchResult> BenchComboFilter(size_t combo_count = 1 << 18, size_t iterations = 20);
+
+	// Move n-gram index: building it from combo_count combos, phrase queries through it versus scanning every combo, and a save / load round trip
+	std::vector<BenchResult> BenchNgramIndex(size_t combo_count = 1 << 20, size_t query_count = 1000, size_t iterations = 3);
+
+	// Runs the named benchmarks (all of them if names is empty) and prints their results; returns false on an unknown name or a mismatch
+	bool RunBenchmarks(const std::vector<std::string>& names);
+}
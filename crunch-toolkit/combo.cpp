@@ -2,62 +2,70 @@
 #include "pch.h"
 
 #include "combo.h"
+#include "combofeatures.h"
 
 namespace Crunch {
-	bool Combo::DidKill() const { 
-		return Dir::NEUT < punish.kill_dir && punish.kill_dir < Dir::__LAST; 
+	bool ComboView::DidKill() const { 
+		return Dir::NEUT < punish->kill_dir && punish->kill_dir < Dir::__LAST; 
 	}
 
-	size_t Combo::TotalMoveCount() const {
-		return attacks.size();
+	size_t ComboView::TotalMoveCount() const {
+		return attack_count;
 	}
 
-	size_t Combo::UniqueMoveCount() const {
-		size_t unique_move_count = 0;
-		std::vector<uint8_t> move_ids(attacks.size());
-		for (const auto& attack : attacks) {
-			if (std::find(move_ids.begin(), move_ids.end(), attack.move_id) == move_ids.end()) {
-				move_ids.push_back(attack.move_id);
-				unique_move_count++;
-			}
+	size_t ComboView::UniqueMoveCount() const {
+		std::bitset<256> seen_move_ids;
+		for (const auto& attack : *this) {
+			seen_move_ids.set(attack.move_id);
 		}
-		return unique_move_count;
+		return seen_move_ids.count();
 	}
 
-	uint16_t Combo::HighestSingleAttackDamage() const {
+	uint16_t ComboView::HighestSingleAttackDamage() const {
 		auto compare_func = [](const slip::Attack& a1, const slip::Attack& a2) { return a1.damage < a2.damage; };
-		auto highest_attack = std::max_element(attacks.begin(), attacks.end(), compare_func);
-		return highest_attack != attacks.end() ? highest_attack->damage : 0;
+		auto highest_attack = std::max_element(begin(), end(), compare_func);
+		return highest_attack != end() ? highest_attack->damage : 0;
 	}
 
-	uint16_t Combo::TotalDamage() const {
+	uint16_t ComboView::TotalDamage() const {
 		uint16_t total_damage = 0;
-		for (const auto& attack : attacks) {
+		for (const auto& attack : *this) {
 			total_damage += attack.damage;
 		}
 		return total_damage;
 	}
 
-	float Combo::HighestSingleAttackDamageRatio() const {
+	float ComboView::HighestSingleAttackDamageRatio() const {
 		auto highest_single_attack_damage = HighestSingleAttackDamage();
 		auto total_damage = TotalDamage();
 		auto ratio = static_cast<float>(highest_single_attack_damage) / static_cast<float>(total_damage);
 		return ratio;
 	}
 
-	bool Combo::ExceedsSingleAttackDamageRatioThreshold(float damage_ratio_threshold) const {
+	bool ComboView::ExceedsSingleAttackDamageRatioThreshold(float damage_ratio_threshold) const {
 		return HighestSingleAttackDamageRatio() > damage_ratio_threshold;
 	}
 
-	int Combo::MovieStartFrame() const { 
-		return punish.start_frame - COMBO_INTRO_FRAMES; 
+	int ComboView::MovieStartFrame() const { 
+		return punish->start_frame - COMBO_INTRO_FRAMES; 
 	}
 
-	int Combo::MovieEndFrame() const {
-		return punish.end_frame + COMBO_OUTRO_FRAMES; 
+	int ComboView::MovieEndFrame() const {
+		return punish->end_frame + COMBO_OUTRO_FRAMES; 
 	}
 
-	int Combo::Score() const {
-		return 0;
+	int ComboView::Score() const {
+		return static_cast<int>(std::lround(ScoreComboFeatures(ComputeComboFeatures(*this), ComboScoreWeights())));
 	}
+
+	bool Combo::DidKill() const { return View().DidKill(); }
+	size_t Combo::TotalMoveCount() const { return View().TotalMoveCount(); }
+	size_t Combo::UniqueMoveCount() const { return View().UniqueMoveCount(); }
+	uint16_t Combo::HighestSingleAttackDamage() const { return View().HighestSingleAttackDamage(); }
+	uint16_t Combo::TotalDamage() const { return View().TotalDamage(); }
+	float Combo::HighestSingleAttackDamageRatio() const { return View().HighestSingleAttackDamageRatio(); }
+	bool Combo::ExceedsSingleAttackDamageRatioThreshold(float damage_ratio_threshold) const { return View().ExceedsSingleAttackDamageRatioThreshold(damage_ratio_threshold); }
+	int Combo::MovieStartFrame() const { return View().MovieStartFrame(); }
+	int Combo::MovieEndFrame() const { return View().MovieEndFrame(); }
+	int Combo::Score() const { return View().Score(); }
 }
@@ -5,10 +5,34 @@
 namespace Crunch {
 	constexpr uint8_t COMBO_INTRO_FRAMES = 60;
 	constexpr uint8_t COMBO_OUTRO_FRAMES = 60;
+	// Non-owning view of a combo's attacks and punish, e.g. a range inside a ComboSet's flat attack array
+	struct ComboView {
+		const slip::Attack* attacks = nullptr;
+		size_t attack_count = 0;
+		const slip::Punish* punish = nullptr;
+
+		const slip::Attack* begin() const { return attacks; }
+		const slip::Attack* end() const { return attacks + attack_count; }
+
+		bool DidKill() const;
+		size_t TotalMoveCount() const;
+		size_t UniqueMoveCount() const;
+		uint16_t HighestSingleAttackDamage() const;
+		uint16_t TotalDamage() const;
+		float HighestSingleAttackDamageRatio() const;
+		bool ExceedsSingleAttackDamageRatioThreshold(float damage_ratio_threshold) const;
+		int MovieStartFrame() const;
+		int MovieEndFrame() const;
+		// Rounded score of the combo's features with the default ComboScoreWeights (see combofeatures.h)
+		int Score() const;
+	};
+
 	struct Combo {
 		std::vector<slip::Attack> attacks;
 		slip::Punish punish;
 
+		ComboView View() const { return { attacks.data(), attacks.size(), &punish }; }
+
 		bool DidKill() const;
 		size_t TotalMoveCount() const;
 		size_t UniqueMoveCount() const;
@@ -0,0 +1,133 @@
+
+#include "pch.h"
+
+#include "combofeatures.h"
+
+namespace Crunch {
+	namespace {
+		using ColumnPointers = std::array<const float*, COMBO_FEATURE_COUNT>;
+
+		// Every kernel adds weight * feature in feature order, one multiply and one add per feature, so all levels round the same way
+		void score_rows_scalar(const ColumnPointers& columns, const ComboScoreWeights& weights, float* scores, size_t begin, size_t end) {
+			for (size_t iCombo = begin; iCombo < end; ++iCombo) {
+				float score = 0.0f;
+				for (size_t iFeature = 0; iFeature < COMBO_FEATURE_COUNT; ++iFeature) {
+					score += weights.weights[iFeature] * columns[iFeature][iCombo];
+				}
+				scores[iCombo] = score;
+			}
+		}
+
+#ifdef SLIP_X86
+		SLIP_TARGET_SSE2 size_t score_rows_sse2(const ColumnPointers& columns, const ComboScoreWeights& weights, float* scores, size_t count) {
+			size_t iCombo = 0;
+			for (; iCombo + 4 <= count; iCombo += 4) {
+				__m128 score = _mm_setzero_ps();
+				for (size_t iFeature = 0; iFeature < COMBO_FEATURE_COUNT; ++iFeature) {
+					score = _mm_add_ps(score, _mm_mul_ps(_mm_set1_ps(weights.weights[iFeature]), _mm_loadu_ps(columns[iFeature] + iCombo)));
+				}
+				_mm_storeu_ps(scores + iCombo, score);
+			}
+			return iCombo;
+		}
+
+		SLIP_TARGET_AVX2 size_t score_rows_avx2(const ColumnPointers& columns, const ComboScoreWeights& weights, float* scores, size_t count) {
+			size_t iCombo = 0;
+			for (; iCombo + 8 <= count; iCombo += 8) {
+				__m256 score = _mm256_setzero_ps();
+				for (size_t iFeature = 0; iFeature < COMBO_FEATURE_COUNT; ++iFeature) {
+					score = _mm256_add_ps(score, _mm256_mul_ps(_mm256_set1_ps(weights.weights[iFeature]), _mm256_loadu_ps(columns[iFeature] + iCombo)));
+				}
+				_mm256_storeu_ps(scores + iCombo, score);
+			}
+			return iCombo;
+		}
+#endif
+	}
+
+	ComboFeatureVector ComputeComboFeatures(const ComboView& combo) {
+		float damage = 0.0f;
+		float highest_attack_damage = 0.0f;
+		std::bitset<256> seen_move_ids;
+		for (const slip::Attack& attack : combo) {
+			damage += attack.damage;
+			highest_attack_damage = std::max(highest_attack_damage, attack.damage);
+			seen_move_ids.set(attack.move_id);
+		}
+
+		ComboFeatureVector features;
+		features[COMBO_FEATURE_DAMAGE] = damage;
+		features[COMBO_FEATURE_HIGHEST_ATTACK_DAMAGE] = highest_attack_damage;
+		features[COMBO_FEATURE_MOVE_COUNT] = static_cast<float>(combo.attack_count);
+		features[COMBO_FEATURE_UNIQUE_MOVE_COUNT] = static_cast<float>(seen_move_ids.count());
+		features[COMBO_FEATURE_KILL] = combo.DidKill() ? 1.0f : 0.0f;
+		features[COMBO_FEATURE_DURATION] = static_cast<float>(combo.punish->end_frame - combo.punish->start_frame);
+		features[COMBO_FEATURE_START_PERCENT] = combo.punish->start_pct;
+		return features;
+	}
+
+	float ScoreComboFeatures(const ComboFeatureVector& features, const ComboScoreWeights& weights) {
+		float score = 0.0f;
+		for (size_t iFeature = 0; iFeature < COMBO_FEATURE_COUNT; ++iFeature) {
+			score += weights.weights[iFeature] * features[iFeature];
+		}
+		return score;
+	}
+
+	void ComboFeatureTable::Add(const ComboFeatureVector& features) {
+		for (size_t iFeature = 0; iFeature < COMBO_FEATURE_COUNT; ++iFeature) {
+			m_columns[iFeature].push_back(features[iFeature]);
+		}
+	}
+
+	void ComboFeatureTable::Append(const ComboSet& combos) {
+		Reserve(Size() + combos.ComboCount());
+		for (ComboView combo : combos.Combos()) {
+			Add(combo);
+		}
+	}
+
+	void ComboFeatureTable::Reserve(size_t combo_count) {
+		for (std::vector<float>& column : m_columns) {
+			column.reserve(combo_count);
+		}
+	}
+
+	void ComboFeatureTable::Clear() {
+		for (std::vector<float>& column : m_columns) {
+			column.clear();
+		}
+	}
+
+	ComboFeatureVector ComboFeatureTable::Row(size_t iCombo) const {
+		ComboFeatureVector features;
+		for (size_t iFeature = 0; iFeature < COMBO_FEATURE_COUNT; ++iFeature) {
+			features[iFeature] = m_columns[iFeature][iCombo];
+		}
+		return features;
+	}
+
+	void ScoreCombos(const ComboFeatureTable& table, const ComboScoreWeights& weights, float* scores, slip::SimdLevel simd_level) {
+		ColumnPointers columns;
+		for (size_t iFeature = 0; iFeature < COMBO_FEATURE_COUNT; ++iFeature) {
+			columns[iFeature] = table.Column(static_cast<ComboFeature>(iFeature));
+		}
+		const size_t count = table.Size();
+		size_t scored_count = 0;
+#ifdef SLIP_X86
+		if (simd_level >= slip::SIMD_AVX2) {
+			scored_count = score_rows_avx2(columns, weights, scores, count);
+		}
+		else if (simd_level >= slip::SIMD_SSE2) {
+			scored_count = score_rows_sse2(columns, weights, scores, count);
+		}
+#endif
+		score_rows_scalar(columns, weights, scores, scored_count, count);
+	}
+
+	std::vector<float> ScoreCombos(const ComboFeatureTable& table, const ComboScoreWeights& weights) {
+		std::vector<float> scores(table.Size());
+		ScoreCombos(table, weights, scores.data());
+		return scores;
+	}
+}
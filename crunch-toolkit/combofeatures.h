@@ -0,0 +1,56 @@
+#pragma once
+
+#include "pch.h"
+
+#include "combo.h"
+#include "comboset.h"
+
+namespace Crunch {
+	// Ranking inputs of a combo, one float each so every feature can be weighted the same way
+	enum ComboFeature : size_t {
+		COMBO_FEATURE_DAMAGE,                // Sum of every attack's damage
+		COMBO_FEATURE_HIGHEST_ATTACK_DAMAGE, // Damage of the strongest single attack
+		COMBO_FEATURE_MOVE_COUNT,            // Number of attacks
+		COMBO_FEATURE_UNIQUE_MOVE_COUNT,     // Number of distinct move ids
+		COMBO_FEATURE_KILL,                  // 1 if the combo killed, 0 otherwise
+		COMBO_FEATURE_DURATION,              // Frames from the punish's start to its end
+		COMBO_FEATURE_START_PERCENT,         // Opponent's percent when the combo started
+		COMBO_FEATURE_COUNT
+	};
+
+	using ComboFeatureVector = std::array<float, COMBO_FEATURE_COUNT>;
+
+	// Score = sum of weight * feature; the defaults favor long, varied, killing combos over single big hits
+	struct ComboScoreWeights {
+		ComboFeatureVector weights = { 1.0f, -0.5f, 2.0f, 4.0f, 30.0f, 0.0f, 0.0f };
+
+		float& operator[](ComboFeature feature) { return weights[feature]; }
+		float operator[](ComboFeature feature) const { return weights[feature]; }
+	};
+
+	// Every feature of a combo in a single pass over its attacks
+	ComboFeatureVector ComputeComboFeatures(const ComboView& combo);
+	float ScoreComboFeatures(const ComboFeatureVector& features, const ComboScoreWeights& weights);
+
+	// Features of many combos as one column per feature (structure of arrays), so a batch can be scored with SIMD
+	class ComboFeatureTable {
+	public:
+		void Add(const ComboView& combo) { Add(ComputeComboFeatures(combo)); }
+		void Add(const ComboFeatureVector& features);
+		// Adds every combo of the set, in order, so row i is the set's combo i
+		void Append(const ComboSet& combos);
+		void Reserve(size_t combo_count);
+		void Clear();
+
+		size_t Size() const { return m_columns[0].size(); }
+		const float* Column(ComboFeature feature) const { return m_columns[feature].data(); }
+		float* Column(ComboFeature feature) { return m_columns[feature].data(); }
+		ComboFeatureVector Row(size_t iCombo) const;
+	private:
+		std::array<std::vector<float>, COMBO_FEATURE_COUNT> m_columns;
+	};
+
+	// Writes the score of every row of the table to scores (table.Size() floats); every SIMD level gives the same scores
+	void ScoreCombos(const ComboFeatureTable& table, const ComboScoreWeights& weights, float* scores, slip::SimdLevel simd_level = slip::simdLevel());
+	std::vector<float> ScoreCombos(const ComboFeatureTable& table, const ComboScoreWeights& weights = {});
+}
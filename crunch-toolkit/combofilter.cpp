@@ -0,0 +1,393 @@
+
+#include "pch.h"
+
+#include "combofilter.h"
+
+namespace Crunch {
+	// Recursive descent over the query, emitting bytecode as it goes; numeric operands are already on the stack
+	// when a rule returns, string operands are only pushed once the comparison they're part of is known
+	class ComboFilterCompiler {
+	public:
+		ComboFilterCompiler(std::string_view query, ComboFilter* filter) : m_query(query), m_filter(filter) {}
+
+		bool Compile() {
+			Next();
+			if (m_token.type != TOKEN_END) {
+				RequireNumber(ParseOr());
+			}
+			if (m_error.empty() && m_token.type != TOKEN_END) {
+				Fail("unexpected '" + std::string(m_token.text) + "'");
+			}
+			if (m_error.empty() && m_max_depth > ComboFilter::MAX_STACK_DEPTH) {
+				Fail("query is nested too deeply");
+			}
+			if (!m_error.empty()) {
+				m_filter->m_error = m_error;
+				return false;
+			}
+			return true;
+		}
+	private:
+		enum TokenType { TOKEN_END, TOKEN_NUMBER, TOKEN_STRING, TOKEN_NAME, TOKEN_SYMBOL };
+		enum OperandType { OPERAND_NUMBER, OPERAND_STRING_FIELD, OPERAND_STRING };
+
+		struct Token {
+			TokenType type = TOKEN_END;
+			std::string_view text;
+			size_t position = 0;
+		};
+
+		struct Operand {
+			OperandType type = OPERAND_NUMBER;
+			ComboField field = COMBO_FIELD_COUNT;
+			std::string text;
+		};
+
+		std::string_view m_query;
+		ComboFilter* m_filter;
+		size_t m_position = 0;
+		Token m_token;
+		size_t m_depth = 0;
+		size_t m_max_depth = 0;
+		std::string m_error;
+
+		void Fail(const std::string& message) {
+			if (m_error.empty()) {
+				m_error = message + " at column " + std::to_string(m_token.position + 1);
+			}
+		}
+
+		void Next() {
+			while (m_position < m_query.size() && std::isspace(static_cast<unsigned char>(m_query[m_position]))) {
+				++m_position;
+			}
+			m_token = { TOKEN_END, {}, m_position };
+			if (m_position >= m_query.size()) {
+				return;
+			}
+			const size_t begin = m_position;
+			const char c = m_query[m_position];
+			if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+				while (m_position < m_query.size() && (std::isdigit(static_cast<unsigned char>(m_query[m_position])) || m_query[m_position] == '.')) {
+					++m_position;
+				}
+				m_token.type = TOKEN_NUMBER;
+			}
+			else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+				while (m_position < m_query.size() && (std::isalnum(static_cast<unsigned char>(m_query[m_position])) || m_query[m_position] == '_' || m_query[m_position] == '.')) {
+					++m_position;
+				}
+				m_token.type = TOKEN_NAME;
+			}
+			else if (c == '"') {
+				size_t end = m_query.find('"', begin + 1);
+				if (end == std::string_view::npos) {
+					Fail("unterminated string");
+					m_position = m_query.size();
+					return;
+				}
+				m_token.type = TOKEN_STRING;
+				m_token.text = m_query.substr(begin + 1, end - begin - 1);
+				m_position = end + 1;
+				return;
+			}
+			else {
+				static const char* const TWO_CHAR_SYMBOLS[] = { "&&", "||", "<=", ">=", "==", "!=" };
+				m_position += 1;
+				for (const char* symbol : TWO_CHAR_SYMBOLS) {
+					if (m_query.substr(begin, 2) == symbol) {
+						m_position = begin + 2;
+					}
+				}
+				m_token.type = TOKEN_SYMBOL;
+			}
+			m_token.text = m_query.substr(begin, m_position - begin);
+		}
+
+		bool Accept(std::string_view symbol) {
+			if ((m_token.type == TOKEN_SYMBOL || m_token.type == TOKEN_NAME) && m_token.text == symbol) {
+				Next();
+				return true;
+			}
+			return false;
+		}
+
+		size_t Emit(ComboFilter::Op op, ComboField field = COMBO_FIELD_COUNT, uint32_t arg = 0, double value = 0.0) {
+			m_filter->m_program.push_back({ op, field, arg, value });
+			return m_filter->m_program.size() - 1;
+		}
+
+		void Push() {
+			m_max_depth = std::max(m_max_depth, ++m_depth);
+		}
+
+		void RequireNumber(const Operand& operand) {
+			if (operand.type != OPERAND_NUMBER) {
+				Fail("strings can only be compared with == or !=");
+			}
+		}
+
+		// or : and (("||" | "or") and)*, with each jump patched to the end of the chain
+		Operand ParseOr() {
+			Operand left = ParseAnd();
+			std::vector<size_t> jumps;
+			while (m_error.empty() && (Accept("||") || Accept("or"))) {
+				RequireNumber(left);
+				jumps.push_back(Emit(ComboFilter::OP_JUMP_IF_TRUE));
+				--m_depth;
+				RequireNumber(left = ParseAnd());
+			}
+			for (size_t jump : jumps) {
+				m_filter->m_program[jump].arg = static_cast<uint32_t>(m_filter->m_program.size());
+			}
+			return left;
+		}
+
+		Operand ParseAnd() {
+			Operand left = ParseNot();
+			std::vector<size_t> jumps;
+			while (m_error.empty() && (Accept("&&") || Accept("and"))) {
+				RequireNumber(left);
+				jumps.push_back(Emit(ComboFilter::OP_JUMP_IF_FALSE));
+				--m_depth;
+				RequireNumber(left = ParseNot());
+			}
+			for (size_t jump : jumps) {
+				m_filter->m_program[jump].arg = static_cast<uint32_t>(m_filter->m_program.size());
+			}
+			return left;
+		}
+
+		Operand ParseNot() {
+			if (Accept("!") || Accept("not")) {
+				Operand operand = ParseNot();
+				RequireNumber(operand);
+				Emit(ComboFilter::OP_NOT);
+				return {};
+			}
+			return ParseCompare();
+		}
+
+		Operand ParseCompare() {
+			static const std::pair<std::string_view, ComboFilter::Op> COMPARE_OPS[] = {
+				{ "<", ComboFilter::OP_LT }, { "<=", ComboFilter::OP_LE }, { ">", ComboFilter::OP_GT },
+				{ ">=", ComboFilter::OP_GE }, { "==", ComboFilter::OP_EQ }, { "!=", ComboFilter::OP_NE },
+			};
+			Operand left = ParseSum();
+			for (const auto& [symbol, op] : COMPARE_OPS) {
+				if (m_token.type != TOKEN_SYMBOL || m_token.text != symbol) {
+					continue;
+				}
+				Next();
+				Operand right = ParseSum();
+				if (left.type == OPERAND_NUMBER && right.type == OPERAND_NUMBER) {
+					Emit(op);
+					--m_depth;
+					return {};
+				}
+				if (op != ComboFilter::OP_EQ && op != ComboFilter::OP_NE) {
+					Fail("strings can only be compared with == or !=");
+					return {};
+				}
+				const Operand* field = left.type == OPERAND_STRING_FIELD ? &left : &right;
+				const Operand* text = left.type == OPERAND_STRING ? &left : &right;
+				if (field->type != OPERAND_STRING_FIELD || text->type != OPERAND_STRING) {
+					Fail("a string field can only be compared with a \"string\"");
+					return {};
+				}
+				m_filter->m_strings.push_back(text->text);
+				Emit(op == ComboFilter::OP_EQ ? ComboFilter::OP_STRING_EQ : ComboFilter::OP_STRING_NE, field->field, static_cast<uint32_t>(m_filter->m_strings.size() - 1));
+				Push();
+				return {};
+			}
+			return left;
+		}
+
+		Operand ParseSum() {
+			Operand left = ParseProduct();
+			while (m_error.empty() && m_token.type == TOKEN_SYMBOL && (m_token.text == "+" || m_token.text == "-")) {
+				ComboFilter::Op op = m_token.text == "+" ? ComboFilter::OP_ADD : ComboFilter::OP_SUB;
+				Next();
+				RequireNumber(left);
+				RequireNumber(ParseProduct());
+				Emit(op);
+				--m_depth;
+			}
+			return left;
+		}
+
+		Operand ParseProduct() {
+			Operand left = ParsePrimary();
+			while (m_error.empty() && m_token.type == TOKEN_SYMBOL && (m_token.text == "*" || m_token.text == "/")) {
+				ComboFilter::Op op = m_token.text == "*" ? ComboFilter::OP_MUL : ComboFilter::OP_DIV;
+				Next();
+				RequireNumber(left);
+				RequireNumber(ParsePrimary());
+				Emit(op);
+				--m_depth;
+			}
+			return left;
+		}
+
+		Operand ParsePrimary() {
+			Operand operand;
+			const Token token = m_token;
+			switch (token.type) {
+			case TOKEN_NUMBER: {
+				double value = 0.0;
+				std::string text(token.text);
+				char* end = nullptr;
+				value = std::strtod(text.c_str(), &end);
+				if (end != text.c_str() + text.size()) {
+					Fail("invalid number '" + text + "'");
+					return operand;
+				}
+				Next();
+				Emit(ComboFilter::OP_CONST, COMBO_FIELD_COUNT, 0, value);
+				Push();
+				return operand;
+			}
+			case TOKEN_STRING:
+				Next();
+				operand.type = OPERAND_STRING;
+				operand.text = std::string(token.text);
+				return operand;
+			case TOKEN_NAME: {
+				Next();
+				if (token.text == "true" || token.text == "false") {
+					Emit(ComboFilter::OP_CONST, COMBO_FIELD_COUNT, 0, token.text == "true" ? 1.0 : 0.0);
+					Push();
+					return operand;
+				}
+				const auto& names = ComboFilter::FieldNames();
+				auto name = std::find_if(names.begin(), names.end(), [&](const auto& entry) { return entry.first == token.text; });
+				if (name == names.end()) {
+					m_token = token;
+					Fail("unknown field '" + std::string(token.text) + "'");
+					return operand;
+				}
+				if (IsStringComboField(name->second)) {
+					operand.type = OPERAND_STRING_FIELD;
+					operand.field = name->second;
+					return operand;
+				}
+				Emit(ComboFilter::OP_FIELD, name->second);
+				Push();
+				return operand;
+			}
+			case TOKEN_SYMBOL:
+				if (Accept("(")) {
+					operand = ParseOr();
+					if (!Accept(")")) {
+						Fail("expected ')'");
+					}
+					return operand;
+				}
+				if (Accept("-")) {
+					Emit(ComboFilter::OP_CONST, COMBO_FIELD_COUNT, 0, 0.0);
+					Push();
+					RequireNumber(ParsePrimary());
+					Emit(ComboFilter::OP_SUB);
+					--m_depth;
+					return operand;
+				}
+				Fail("unexpected '" + std::string(token.text) + "'");
+				return operand;
+			default:
+				Fail("unexpected end of query");
+				return operand;
+			}
+		}
+	};
+
+	bool ComboFilter::Compile(std::string_view query) {
+		m_program.clear();
+		m_strings.clear();
+		m_error.clear();
+		if (!ComboFilterCompiler(query, this).Compile()) {
+			m_program.clear();
+			m_strings.clear();
+			return false;
+		}
+		return true;
+	}
+
+	bool ComboFilter::Matches(const ComboFilterRow& row) const {
+		double stack[MAX_STACK_DEPTH];
+		size_t top = 0;
+		const size_t program_size = m_program.size();
+		size_t pc = 0;
+		while (pc < program_size) {
+			const Instruction& instruction = m_program[pc++];
+			switch (instruction.op) {
+			case OP_CONST: stack[top++] = instruction.value; break;
+			case OP_FIELD: stack[top++] = ComboFieldValue(instruction.field, row); break;
+			case OP_STRING_EQ: stack[top++] = ComboFieldString(instruction.field, row) == m_strings[instruction.arg] ? 1.0 : 0.0; break;
+			case OP_STRING_NE: stack[top++] = ComboFieldString(instruction.field, row) != m_strings[instruction.arg] ? 1.0 : 0.0; break;
+			case OP_ADD: --top; stack[top - 1] += stack[top]; break;
+			case OP_SUB: --top; stack[top - 1] -= stack[top]; break;
+			case OP_MUL: --top; stack[top - 1] *= stack[top]; break;
+			case OP_DIV: --top; stack[top - 1] /= stack[top]; break;
+			case OP_LT: --top; stack[top - 1] = stack[top - 1] < stack[top] ? 1.0 : 0.0; break;
+			case OP_LE: --top; stack[top - 1] = stack[top - 1] <= stack[top] ? 1.0 : 0.0; break;
+			case OP_GT: --top; stack[top - 1] = stack[top - 1] > stack[top] ? 1.0 : 0.0; break;
+			case OP_GE: --top; stack[top - 1] = stack[top - 1] >= stack[top] ? 1.0 : 0.0; break;
+			case OP_EQ: --top; stack[top - 1] = stack[top - 1] == stack[top] ? 1.0 : 0.0; break;
+			case OP_NE: --top; stack[top - 1] = stack[top - 1] != stack[top] ? 1.0 : 0.0; break;
+			case OP_NOT: stack[top - 1] = stack[top - 1] == 0.0 ? 1.0 : 0.0; break;
+			case OP_JUMP_IF_FALSE:
+				if (stack[top - 1] == 0.0) {
+					pc = instruction.arg;
+				}
+				else {
+					--top;
+				}
+				break;
+			case OP_JUMP_IF_TRUE:
+				if (stack[top - 1] != 0.0) {
+					pc = instruction.arg;
+				}
+				else {
+					--top;
+				}
+				break;
+			}
+		}
+		return top == 0 || stack[top - 1] != 0.0;
+	}
+
+	const std::vector<std::pair<std::string_view, ComboField>>& ComboFilter::FieldNames() {
+		static const std::vector<std::pair<std::string_view, ComboField>> field_names = {
+			{ "damage", COMBO_FIELD_DAMAGE },
+			{ "max_hit", COMBO_FIELD_MAX_HIT },
+			{ "max_hit_ratio", COMBO_FIELD_MAX_HIT_RATIO },
+			{ "moves", COMBO_FIELD_MOVES },
+			{ "unique_moves", COMBO_FIELD_UNIQUE_MOVES },
+			{ "kill", COMBO_FIELD_KILL },
+			{ "duration", COMBO_FIELD_DURATION },
+			{ "score", COMBO_FIELD_SCORE },
+			{ "start_frame", COMBO_FIELD_START_FRAME },
+			{ "end_frame", COMBO_FIELD_END_FRAME },
+			{ "start_pct", COMBO_FIELD_START_PCT },
+			{ "end_pct", COMBO_FIELD_END_PCT },
+			{ "stocks", COMBO_FIELD_STOCKS },
+			{ "opening", COMBO_FIELD_OPENING },
+			{ "last_move", COMBO_FIELD_LAST_MOVE },
+			{ "kill_dir", COMBO_FIELD_KILL_DIR },
+			{ "player.port", COMBO_FIELD_PLAYER_PORT },
+			{ "player.char", COMBO_FIELD_PLAYER_CHAR },
+			{ "opponent.char", COMBO_FIELD_OPPONENT_CHAR },
+			{ "won", COMBO_FIELD_WON },
+			{ "stage", COMBO_FIELD_STAGE },
+			{ "game_length", COMBO_FIELD_GAME_LENGTH },
+			{ "player.code", COMBO_FIELD_PLAYER_CODE },
+			{ "player.tag", COMBO_FIELD_PLAYER_TAG },
+			{ "player.char_name", COMBO_FIELD_PLAYER_CHAR_NAME },
+			{ "opponent.code", COMBO_FIELD_OPPONENT_CODE },
+			{ "opponent.tag", COMBO_FIELD_OPPONENT_TAG },
+			{ "opponent.char_name", COMBO_FIELD_OPPONENT_CHAR_NAME },
+			{ "stage_name", COMBO_FIELD_STAGE_NAME },
+		};
+		return field_names;
+	}
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include "pch.h"
+
+#include "combofeatures.h"
+
+namespace Crunch {
+	// Everything a filter can look at: the combo, its features, and optionally the game and which of its players did the combo
+	enum ComboField : uint8_t {
+		// Combo
+		COMBO_FIELD_DAMAGE,
+		COMBO_FIELD_MAX_HIT,
+		COMBO_FIELD_MAX_HIT_RATIO,
+		COMBO_FIELD_MOVES,
+		COMBO_FIELD_UNIQUE_MOVES,
+		COMBO_FIELD_KILL,
+		COMBO_FIELD_DURATION,
+		COMBO_FIELD_SCORE,
+		// Punish
+		COMBO_FIELD_START_FRAME,
+		COMBO_FIELD_END_FRAME,
+		COMBO_FIELD_START_PCT,
+		COMBO_FIELD_END_PCT,
+		COMBO_FIELD_STOCKS,
+		COMBO_FIELD_OPENING,
+		COMBO_FIELD_LAST_MOVE,
+		COMBO_FIELD_KILL_DIR,
+		// Players and replay (0 without an analysis)
+		COMBO_FIELD_PLAYER_PORT,
+		COMBO_FIELD_PLAYER_CHAR,
+		COMBO_FIELD_OPPONENT_CHAR,
+		COMBO_FIELD_WON,
+		COMBO_FIELD_STAGE,
+		COMBO_FIELD_GAME_LENGTH,
+		// Strings ("" without an analysis)
+		COMBO_FIELD_PLAYER_CODE,
+		COMBO_FIELD_PLAYER_TAG,
+		COMBO_FIELD_PLAYER_CHAR_NAME,
+		COMBO_FIELD_OPPONENT_CODE,
+		COMBO_FIELD_OPPONENT_TAG,
+		COMBO_FIELD_OPPONENT_CHAR_NAME,
+		COMBO_FIELD_STAGE_NAME,
+		COMBO_FIELD_COUNT
+	};
+
+	constexpr bool IsStringComboField(ComboField field) {
+		return field >= COMBO_FIELD_PLAYER_CODE;
+	}
+
+	// One combo as seen by a filter; the features are computed once, whatever the number of fields the filter reads
+	struct ComboFilterRow {
+		ComboView combo;
+		ComboFeatureVector features;
+		const slip::Analysis* analysis = nullptr;
+		size_t player = 0; // Index into analysis->ap of the player who did the combo
+
+		explicit ComboFilterRow(const ComboView& combo_view, const slip::Analysis* game_analysis = nullptr, size_t player_index = 0)
+			: combo(combo_view), features(ComputeComboFeatures(combo_view)), analysis(game_analysis), player(player_index) {}
+
+		const slip::AnalysisPlayer* Player() const { return analysis != nullptr ? &analysis->ap[player] : nullptr; }
+		const slip::AnalysisPlayer* Opponent() const { return analysis != nullptr ? &analysis->ap[1 - player] : nullptr; }
+	};
+
+	inline double ComboFieldValue(ComboField field, const ComboFilterRow& row) {
+		const slip::Punish& punish = *row.combo.punish;
+		switch (field) {
+		case COMBO_FIELD_DAMAGE: return row.features[COMBO_FEATURE_DAMAGE];
+		case COMBO_FIELD_MAX_HIT: return row.features[COMBO_FEATURE_HIGHEST_ATTACK_DAMAGE];
+		case COMBO_FIELD_MAX_HIT_RATIO: return row.features[COMBO_FEATURE_HIGHEST_ATTACK_DAMAGE] / row.features[COMBO_FEATURE_DAMAGE];
+		case COMBO_FIELD_MOVES: return row.features[COMBO_FEATURE_MOVE_COUNT];
+		case COMBO_FIELD_UNIQUE_MOVES: return row.features[COMBO_FEATURE_UNIQUE_MOVE_COUNT];
+		case COMBO_FIELD_KILL: return row.features[COMBO_FEATURE_KILL];
+		case COMBO_FIELD_DURATION: return row.features[COMBO_FEATURE_DURATION];
+		case COMBO_FIELD_SCORE: return ScoreComboFeatures(row.features, ComboScoreWeights());
+		case COMBO_FIELD_START_FRAME: return punish.start_frame;
+		case COMBO_FIELD_END_FRAME: return punish.end_frame;
+		case COMBO_FIELD_START_PCT: return punish.start_pct;
+		case COMBO_FIELD_END_PCT: return punish.end_pct;
+		case COMBO_FIELD_STOCKS: return punish.stocks;
+		case COMBO_FIELD_OPENING: return punish.opening;
+		case COMBO_FIELD_LAST_MOVE: return punish.last_move_id;
+		case COMBO_FIELD_KILL_DIR: return punish.kill_dir;
+		default: break;
+		}
+		if (row.analysis == nullptr) {
+			return 0.0;
+		}
+		switch (field) {
+		case COMBO_FIELD_PLAYER_PORT: return row.Player()->port;
+		case COMBO_FIELD_PLAYER_CHAR: return row.Player()->char_id;
+		case COMBO_FIELD_OPPONENT_CHAR: return row.Opponent()->char_id;
+		case COMBO_FIELD_WON: return row.analysis->winner_port == static_cast<int>(row.Player()->port) ? 1.0 : 0.0;
+		case COMBO_FIELD_STAGE: return row.analysis->stage_id;
+		case COMBO_FIELD_GAME_LENGTH: return row.analysis->game_length;
+		default: return 0.0;
+		}
+	}
+
+	inline std::string_view ComboFieldString(ComboField field, const ComboFilterRow& row) {
+		if (row.analysis == nullptr) {
+			return {};
+		}
+		switch (field) {
+		case COMBO_FIELD_PLAYER_CODE: return row.Player()->tag_code;
+		case COMBO_FIELD_PLAYER_TAG: return row.Player()->tag_player;
+		case COMBO_FIELD_PLAYER_CHAR_NAME: return row.Player()->char_name;
+		case COMBO_FIELD_OPPONENT_CODE: return row.Opponent()->tag_code;
+		case COMBO_FIELD_OPPONENT_TAG: return row.Opponent()->tag_player;
+		case COMBO_FIELD_OPPONENT_CHAR_NAME: return row.Opponent()->char_name;
+		case COMBO_FIELD_STAGE_NAME: return row.analysis->stage_name;
+		default: return {};
+		}
+	}
+
+	// Filter parsed at runtime, e.g. "kill && moves >= 7 && damage >= 60 && max_hit_ratio <= 0.25 && player.code == \"YOYO#278\"":
+	//   expr    : or-chains of and-chains of comparisons ("||" / "or", "&&" / "and", "!" / "not"), with parentheses
+	//   compare : numbers with + - * / and < <= > >= == !=; strings with == and != only
+	//   values  : fields (see ComboFilter::FieldNames), numbers, "strings", true and false; any non-zero number is true
+	// Compiled to flat bytecode for a small stack machine, with && and || short-circuiting through jumps.
+	class ComboFilter {
+	public:
+		// Returns false (see Error()) if the query doesn't parse; an empty query matches every combo
+		bool Compile(std::string_view query);
+		const std::string& Error() const { return m_error; }
+
+		bool Matches(const ComboFilterRow& row) const;
+		bool operator()(const ComboFilterRow& row) const { return Matches(row); }
+
+		// Field name and field pairs, e.g. "damage" or "player.code"
+		static const std::vector<std::pair<std::string_view, ComboField>>& FieldNames();
+
+		enum Op : uint8_t {
+			OP_CONST,         // push value
+			OP_FIELD,         // push a numeric field
+			OP_STRING_EQ,     // push whether a string field equals m_strings[arg]
+			OP_STRING_NE,
+			OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+			OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+			OP_NOT,
+			OP_JUMP_IF_FALSE, // if the top is false jump to arg keeping it, otherwise pop it
+			OP_JUMP_IF_TRUE,
+		};
+
+		struct Instruction {
+			Op op;
+			ComboField field;
+			uint32_t arg;
+			double value;
+		};
+
+		const std::vector<Instruction>& Program() const { return m_program; }
+	private:
+		static constexpr size_t MAX_STACK_DEPTH = 32;
+
+		std::vector<Instruction> m_program;
+		std::vector<std::string> m_strings;
+		std::string m_error;
+
+		friend class ComboFilterCompiler;
+	};
+
+	// Filters known at build time, written as C++ expressions over the same fields and evaluated fully inline, e.g.
+	//   constexpr auto filter = Filter::kill && Filter::moves >= 7 && Filter::player_code == "YOYO#278";
+	//   if (filter(ComboFilterRow(combo, &analysis, iPlayer))) { ... }
+	namespace Filter {
+		struct Expr {};
+
+		template<typename T>
+		constexpr bool IS_EXPR = std::is_base_of_v<Expr, T>;
+
+		struct Const : Expr {
+			double value;
+			constexpr explicit Const(double v) : value(v) {}
+			constexpr double operator()(const ComboFilterRow&) const { return value; }
+		};
+
+		template<ComboField F>
+		struct Field : Expr {
+			static_assert(!IsStringComboField(F), "string fields can only be compared with == and !=");
+			double operator()(const ComboFilterRow& row) const { return ComboFieldValue(F, row); }
+		};
+
+		template<typename T>
+		constexpr auto wrap(const T& value) {
+			if constexpr (IS_EXPR<T>) {
+				return value;
+			}
+			else {
+				return Const(static_cast<double>(value));
+			}
+		}
+
+		template<typename Op, typename L, typename R>
+		struct Binary : Expr {
+			L left;
+			R right;
+			constexpr Binary(L l, R r) : left(l), right(r) {}
+			auto operator()(const ComboFilterRow& row) const { return Op()(left(row), right(row)); }
+		};
+
+		template<typename L, typename R>
+		struct And : Expr {
+			L left;
+			R right;
+			constexpr And(L l, R r) : left(l), right(r) {}
+			bool operator()(const ComboFilterRow& row) const { return left(row) && right(row); }
+		};
+
+		template<typename L, typename R>
+		struct Or : Expr {
+			L left;
+			R right;
+			constexpr Or(L l, R r) : left(l), right(r) {}
+			bool operator()(const ComboFilterRow& row) const { return left(row) || right(row); }
+		};
+
+		template<typename E>
+		struct Not : Expr {
+			E expr;
+			constexpr explicit Not(E e) : expr(e) {}
+			bool operator()(const ComboFilterRow& row) const { return !expr(row); }
+		};
+
+		template<ComboField F, bool IS_EQUAL>
+		struct StringCompare : Expr {
+			std::string_view value;
+			constexpr explicit StringCompare(std::string_view v) : value(v) {}
+			bool operator()(const ComboFilterRow& row) const { return (ComboFieldString(F, row) == value) == IS_EQUAL; }
+		};
+
+		template<ComboField F>
+		struct StringField {
+			static_assert(IsStringComboField(F), "numeric fields are Filter::Field");
+			constexpr StringCompare<F, true> operator==(std::string_view value) const { return StringCompare<F, true>(value); }
+			constexpr StringCompare<F, false> operator!=(std::string_view value) const { return StringCompare<F, false>(value); }
+		};
+
+		template<typename L, typename R>
+		using EnableIfExpr = std::enable_if_t<(IS_EXPR<L> || IS_EXPR<R>) && (IS_EXPR<L> || std::is_arithmetic_v<L>) && (IS_EXPR<R> || std::is_arithmetic_v<R>), int>;
+
+#define CRUNCH_FILTER_BINARY_OP(op, Func) \
+		template<typename L, typename R, EnableIfExpr<L, R> = 0> \
+		constexpr auto operator op(const L& left, const R& right) { \
+			return Binary<Func, decltype(wrap(left)), decltype(wrap(right))>(wrap(left), wrap(right)); \
+		}
+		CRUNCH_FILTER_BINARY_OP(+, std::plus<>)
+		CRUNCH_FILTER_BINARY_OP(-, std::minus<>)
+		CRUNCH_FILTER_BINARY_OP(*, std::multiplies<>)
+		CRUNCH_FILTER_BINARY_OP(/, std::divides<>)
+		CRUNCH_FILTER_BINARY_OP(<, std::less<>)
+		CRUNCH_FILTER_BINARY_OP(<=, std::less_equal<>)
+		CRUNCH_FILTER_BINARY_OP(>, std::greater<>)
+		CRUNCH_FILTER_BINARY_OP(>=, std::greater_equal<>)
+		CRUNCH_FILTER_BINARY_OP(==, std::equal_to<>)
+		CRUNCH_FILTER_BINARY_OP(!=, std::not_equal_to<>)
+#undef CRUNCH_FILTER_BINARY_OP
+
+		template<typename L, typename R, std::enable_if_t<IS_EXPR<L> && IS_EXPR<R>, int> = 0>
+		constexpr auto operator&&(const L& left, const R& right) { return And<L, R>(left, right); }
+		template<typename L, typename R, std::enable_if_t<IS_EXPR<L> && IS_EXPR<R>, int> = 0>
+		constexpr auto operator||(const L& left, const R& right) { return Or<L, R>(left, right); }
+		template<typename E, std::enable_if_t<IS_EXPR<E>, int> = 0>
+		constexpr auto operator!(const E& expr) { return Not<E>(expr); }
+
+		constexpr Field<COMBO_FIELD_DAMAGE> damage{};
+		constexpr Field<COMBO_FIELD_MAX_HIT> max_hit{};
+		constexpr Field<COMBO_FIELD_MAX_HIT_RATIO> max_hit_ratio{};
+		constexpr Field<COMBO_FIELD_MOVES> moves{};
+		constexpr Field<COMBO_FIELD_UNIQUE_MOVES> unique_moves{};
+		constexpr Field<COMBO_FIELD_KILL> kill{};
+		constexpr Field<COMBO_FIELD_DURATION> duration{};
+		constexpr Field<COMBO_FIELD_SCORE> score{};
+		constexpr Field<COMBO_FIELD_START_FRAME> start_frame{};
+		constexpr Field<COMBO_FIELD_END_FRAME> end_frame{};
+		constexpr Field<COMBO_FIELD_START_PCT> start_pct{};
+		constexpr Field<COMBO_FIELD_END_PCT> end_pct{};
+		constexpr Field<COMBO_FIELD_STOCKS> stocks{};
+		constexpr Field<COMBO_FIELD_OPENING> opening{};
+		constexpr Field<COMBO_FIELD_LAST_MOVE> last_move{};
+		constexpr Field<COMBO_FIELD_KILL_DIR> kill_dir{};
+		constexpr Field<COMBO_FIELD_PLAYER_PORT> player_port{};
+		constexpr Field<COMBO_FIELD_PLAYER_CHAR> player_char{};
+		constexpr Field<COMBO_FIELD_OPPONENT_CHAR> opponent_char{};
+		constexpr Field<COMBO_FIELD_WON> won{};
+		constexpr Field<COMBO_FIELD_STAGE> stage{};
+		constexpr Field<COMBO_FIELD_GAME_LENGTH> game_length{};
+		constexpr StringField<COMBO_FIELD_PLAYER_CODE> player_code{};
+		constexpr StringField<COMBO_FIELD_PLAYER_TAG> player_tag{};
+		constexpr StringField<COMBO_FIELD_PLAYER_CHAR_NAME> player_char_name{};
+		constexpr StringField<COMBO_FIELD_OPPONENT_CODE> opponent_code{};
+		constexpr StringField<COMBO_FIELD_OPPONENT_TAG> opponent_tag{};
+		constexpr StringField<COMBO_FIELD_OPPONENT_CHAR_NAME> opponent_char_name{};
+		constexpr StringField<COMBO_FIELD_STAGE_NAME> stage_name{};
+	}
+}
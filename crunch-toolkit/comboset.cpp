@@ -0,0 +1,63 @@
+
+#include "pch.h"
+
+#include "comboset.h"
+
+namespace Crunch {
+	size_t ComboSet::BeginReplay() {
+		m_replay_offsets.push_back(static_cast<uint32_t>(m_combos.size()));
+		return ReplayCount() - 1;
+	}
+
+	void ComboSet::AddCombo(const slip::Attack* attacks, size_t attack_count, const slip::Punish& punish) {
+		if (ReplayCount() == 0) {
+			BeginReplay();
+		}
+		ComboRecord record;
+		record.attack_begin = static_cast<uint32_t>(m_attacks.size());
+		record.attack_count = static_cast<uint32_t>(attack_count);
+		record.punish = punish;
+		m_attacks.insert(m_attacks.end(), attacks, attacks + attack_count);
+		m_combos.push_back(record);
+		m_replay_offsets.back() = static_cast<uint32_t>(m_combos.size());
+	}
+
+	void ComboSet::Merge(ComboSet&& other) {
+		if (Empty()) {
+			*this = std::move(other);
+			other.Clear();
+			return;
+		}
+		const uint32_t attack_base = static_cast<uint32_t>(m_attacks.size());
+		const uint32_t combo_base = static_cast<uint32_t>(m_combos.size());
+		m_attacks.insert(m_attacks.end(), other.m_attacks.begin(), other.m_attacks.end());
+		m_combos.reserve(m_combos.size() + other.m_combos.size());
+		for (ComboRecord record : other.m_combos) {
+			record.attack_begin += attack_base;
+			m_combos.push_back(record);
+		}
+		m_replay_offsets.reserve(m_replay_offsets.size() + other.ReplayCount());
+		for (size_t iReplay = 1; iReplay < other.m_replay_offsets.size(); ++iReplay) {
+			m_replay_offsets.push_back(other.m_replay_offsets[iReplay] + combo_base);
+		}
+		other.Clear();
+	}
+
+	void ComboSet::Reserve(size_t replay_count, size_t combo_count, size_t attack_count) {
+		m_replay_offsets.reserve(replay_count + 1);
+		m_combos.reserve(combo_count);
+		m_attacks.reserve(attack_count);
+	}
+
+	void ComboSet::Clear() {
+		m_attacks.clear();
+		m_combos.clear();
+		m_replay_offsets.assign(1, 0);
+	}
+
+	size_t ComboSet::ReplayOf(size_t iCombo) const {
+		// The first replay whose end is past the combo; empty replays share their end with the previous one
+		auto replay_end = std::upper_bound(m_replay_offsets.begin() + 1, m_replay_offsets.end(), static_cast<uint32_t>(iCombo));
+		return static_cast<size_t>(replay_end - m_replay_offsets.begin()) - 1;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "pch.h"
+
+#include "combo.h"
+
+namespace Crunch {
+	// Combos found across many replays, stored contiguously (compressed sparse rows) instead of one heap allocation per combo:
+	//   attacks : every combo's attacks, back to back
+	//   combos  : one record per combo, an [attack_begin, attack_begin + attack_count) range into attacks plus its punish
+	//   replays : replay i owns combos [replay_offsets[i], replay_offsets[i + 1])
+	// Sets are move-only; merging another set moves its arrays in when this one is empty and appends them otherwise.
+	class ComboSet {
+	public:
+		struct ComboRecord {
+			uint32_t attack_begin = 0;
+			uint32_t attack_count = 0;
+			slip::Punish punish;
+		};
+
+		class Iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = ComboView;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = ComboView;
+
+			Iterator(const ComboSet* set, size_t iCombo) : m_set(set), m_combo_index(iCombo) {}
+			ComboView operator*() const { return m_set->Combo(m_combo_index); }
+			Iterator& operator++() { ++m_combo_index; return *this; }
+			bool operator==(const Iterator& other) const { return m_combo_index == other.m_combo_index; }
+			bool operator!=(const Iterator& other) const { return m_combo_index != other.m_combo_index; }
+			size_t Index() const { return m_combo_index; }
+		private:
+			const ComboSet* m_set;
+			size_t m_combo_index;
+		};
+
+		struct Range {
+			Iterator first;
+			Iterator last;
+			Iterator begin() const { return first; }
+			Iterator end() const { return last; }
+			size_t size() const { return last.Index() - first.Index(); }
+		};
+
+		ComboSet() = default;
+		ComboSet(ComboSet&&) = default;
+		ComboSet& operator=(ComboSet&&) = default;
+		ComboSet(const ComboSet&) = delete;
+		ComboSet& operator=(const ComboSet&) = delete;
+
+		// Starts the next replay's combos; returns its index
+		size_t BeginReplay();
+		// Adds a combo to the current replay, copying its attacks into the flat array
+		void AddCombo(const slip::Attack* attacks, size_t attack_count, const slip::Punish& punish);
+		void AddCombo(const ComboView& combo) { AddCombo(combo.attacks, combo.attack_count, *combo.punish); }
+		// Appends every replay of another set after this set's replays, leaving the other set empty
+		void Merge(ComboSet&& other);
+		void Reserve(size_t replay_count, size_t combo_count, size_t attack_count);
+		void Clear();
+
+		size_t ReplayCount() const { return m_replay_offsets.size() - 1; }
+		size_t ComboCount() const { return m_combos.size(); }
+		size_t AttackCount() const { return m_attacks.size(); }
+		bool Empty() const { return m_combos.empty() && ReplayCount() == 0; }
+
+		ComboView Combo(size_t iCombo) const {
+			const ComboRecord& record = m_combos[iCombo];
+			return { m_attacks.data() + record.attack_begin, record.attack_count, &record.punish };
+		}
+		// Index of the replay a combo was found in
+		size_t ReplayOf(size_t iCombo) const;
+		Range ReplayCombos(size_t iReplay) const { return { { this, m_replay_offsets[iReplay] }, { this, m_replay_offsets[iReplay + 1] } }; }
+		Range Combos() const { return { { this, 0 }, { this, m_combos.size() } }; }
+
+		const std::vector<slip::Attack>& Attacks() const { return m_attacks; }
+		const std::vector<ComboRecord>& Records() const { return m_combos; }
+		const std::vector<uint32_t>& ReplayOffsets() const { return m_replay_offsets; }
+	private:
+		std::vector<slip::Attack> m_attacks;
+		std::vector<ComboRecord> m_combos;
+		std::vector<uint32_t> m_replay_offsets = { 0 };
+	};
+}
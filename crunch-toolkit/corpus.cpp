@@ -0,0 +1,441 @@
+
+#include "pch.h"
+
+#include "corpus.h"
+#include "hash.h"
+
+namespace Crunch {
+	namespace {
+		constexpr size_t PLAYER_BLOCK_SIZE = 0x24;
+		constexpr size_t DISP_NAME_SIZE = 0x1F;
+		constexpr size_t CONN_CODE_SIZE = 0x0A;
+		constexpr size_t SLIPPI_UID_SIZE = 0x1D;
+		constexpr size_t CORPUS_HEADER_SIZE = 16;
+
+		// The fixed-size string field of a port, up to its first null; empty if the event is too short to hold it
+		std::string read_field(const char* game_start, size_t game_start_size, size_t offset, size_t field_size, size_t iPort) {
+			offset += field_size * iPort;
+			if (offset + field_size > game_start_size) {
+				return {};
+			}
+			std::string field(&game_start[offset], field_size);
+			field.erase(std::find(field.begin(), field.end(), '\0'), field.end());
+			return field;
+		}
+
+		// Fills the entry's size, fingerprint and ports from the game start block of a raw replay; false if it isn't one
+		bool read_game_start(const char* slp, size_t size, CorpusEntry* entry) {
+			slip::EventStream event_stream;
+			if (!event_stream.open(slp, static_cast<uint32_t>(size)) || !event_stream.valid() || event_stream.code() != Event::GAME_START) {
+				return false;
+			}
+			const char* game_start = event_stream.data();
+			for (size_t iPort = 0; iPort < 4; ++iPort) {
+				entry->player_types[iPort] = static_cast<uint8_t>(game_start[slip::O_PLAYERDATA + PLAYER_BLOCK_SIZE * iPort + slip::O_PLAYER_TYPE]);
+			}
+			ReadPlayerIdentities(game_start, event_stream.eventSize(), &entry->players);
+			entry->size = size;
+			entry->fingerprint = ReplayFingerprint(slp, size);
+			return true;
+		}
+
+		// Manifest paths are canonical, so a replay is found in m_locations however it's reached again, and crunches of the manifest
+		// don't depend on the working directory it was built from
+		std::string manifest_path(const std::filesystem::path& path) {
+			std::error_code error;
+			std::filesystem::path canonical_path = std::filesystem::weakly_canonical(path, error);
+			return error ? path.generic_string() : canonical_path.generic_string();
+		}
+
+		// Decodes a pack member that isn't stored raw back into its .slp bytes
+		bool decode_member(const ReplayPack& pack, size_t index, std::string* slp) {
+			auto [data, size] = pack.MemberView(index);
+			if (pack.Entries()[index].encoding == PackEncoding::Lzma) {
+				*slp = slip::decompressWithLzma(data, size);
+				return !slp->empty();
+			}
+			// The compressor takes ownership of its read buffer, and turns .zlp bytes back into the original replay
+			std::unique_ptr<slip::Compressor> compressor = std::make_unique<slip::Compressor>(0);
+			char* read_buffer = new char[size];
+			std::memcpy(read_buffer, data, size);
+			if (!compressor->loadFromBuff(&read_buffer, static_cast<unsigned>(size))) {
+				return false;
+			}
+			char* write_buffer = nullptr;
+			unsigned write_size = compressor->saveToBuff(&write_buffer);
+			if (write_size == 0 || write_buffer == nullptr) {
+				return false;
+			}
+			slp->assign(write_buffer, write_size);
+			delete[] write_buffer;
+			return true;
+		}
+
+		template<typename Func>
+		void parallel_for(size_t count, size_t thread_count, Func func) {
+			if (thread_count == 0) {
+				thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+			}
+			std::atomic_size_t next_index = 0;
+			auto worker_func = [&]() {
+				for (size_t index = next_index++; index < count; index = next_index++) {
+					func(index);
+				}
+			};
+			std::vector<std::thread> threads;
+			for (size_t iThread = 1; iThread < std::min(thread_count, count); ++iThread) {
+				threads.emplace_back(worker_func);
+			}
+			worker_func();
+			for (auto& thread : threads) {
+				thread.join();
+			}
+		}
+
+		// Calls func(entry, raw .slp bytes, size) for each of the listed entries on thread_count threads; loose replays are
+		// mapped (so func only reads in what it touches), raw pack members read in place and encoded ones decoded first.
+		// Entries that can't be read are skipped
+		template<typename Func>
+		void for_each_replay(std::vector<CorpusEntry>& entries, const std::vector<uint32_t>& indices, size_t thread_count, Func func) {
+			std::map<std::string, std::unique_ptr<ReplayPack>> packs;
+			for (uint32_t iEntry : indices) {
+				const CorpusEntry& entry = entries[iEntry];
+				if (entry.member != NO_PACK_MEMBER && packs.count(entry.path) == 0) {
+					auto pack = std::make_unique<ReplayPack>();
+					packs[entry.path] = pack->Open(entry.path) ? std::move(pack) : nullptr;
+				}
+			}
+			parallel_for(indices.size(), thread_count, [&](size_t index) {
+				CorpusEntry& entry = entries[indices[index]];
+				if (entry.member == NO_PACK_MEMBER) {
+					MappedFile file;
+					if (file.Open(entry.path)) {
+						func(entry, file.Data(), file.Size());
+					}
+					return;
+				}
+				const ReplayPack* pack = packs.at(entry.path).get();
+				if (pack == nullptr || entry.member >= pack->Entries().size()) {
+					return;
+				}
+				if (pack->Entries()[entry.member].encoding == PackEncoding::Raw) {
+					auto [data, size] = pack->MemberView(entry.member);
+					func(entry, data, size);
+				}
+				else if (std::string slp; decode_member(*pack, entry.member, &slp)) {
+					func(entry, slp.data(), slp.size());
+				}
+			});
+		}
+
+		template<typename T>
+		void write_le(std::string* out, T value) {
+			char bytes[sizeof(T)];
+			std::memcpy(bytes, &value, sizeof(T));
+			out->append(bytes, sizeof(T));
+		}
+
+		void write_str(std::string* out, const std::string& str) {
+			write_le<uint16_t>(out, static_cast<uint16_t>(str.size()));
+			out->append(str);
+		}
+
+		// Bounds-checked little-endian reader over the manifest
+		struct ManifestReader {
+			const char* pos;
+			const char* end;
+			bool ok = true;
+
+			template<typename T>
+			T read() {
+				T value{};
+				if (end - pos < static_cast<ptrdiff_t>(sizeof(T))) {
+					ok = false;
+					return value;
+				}
+				std::memcpy(&value, pos, sizeof(T));
+				pos += sizeof(T);
+				return value;
+			}
+
+			std::string read_str() {
+				uint16_t length = read<uint16_t>();
+				if (!ok || end - pos < length) {
+					ok = false;
+					return {};
+				}
+				std::string str(pos, length);
+				pos += length;
+				return str;
+			}
+		};
+
+		void write_entry(std::string* out, const CorpusEntry& entry) {
+			write_str(out, entry.path);
+			write_le(out, entry.member);
+			write_le(out, entry.size);
+			write_le(out, entry.fingerprint);
+			write_le(out, entry.content_hash);
+			write_le(out, entry.duplicate_of);
+			for (size_t iPort = 0; iPort < 4; ++iPort) {
+				write_le(out, entry.player_types[iPort]);
+				write_str(out, entry.players[iPort].tag_code);
+				write_str(out, entry.players[iPort].slippi_uid);
+				write_str(out, entry.players[iPort].disp_name);
+			}
+		}
+
+		CorpusEntry read_entry(ManifestReader* reader, uint32_t version) {
+			CorpusEntry entry;
+			entry.path = reader->read_str();
+			entry.member = reader->read<uint32_t>();
+			entry.size = reader->read<uint64_t>();
+			if (version >= 2) {
+				entry.fingerprint = reader->read<uint64_t>();
+				entry.content_hash = reader->read<uint64_t>();
+				entry.duplicate_of = reader->read<uint32_t>();
+			}
+			for (size_t iPort = 0; iPort < 4; ++iPort) {
+				entry.player_types[iPort] = reader->read<uint8_t>();
+				entry.players[iPort].tag_code = reader->read_str();
+				entry.players[iPort].slippi_uid = reader->read_str();
+				entry.players[iPort].disp_name = reader->read_str();
+			}
+			return entry;
+		}
+	}
+
+	void ReadPlayerIdentities(const char* game_start, size_t game_start_size, std::array<PlayerIdentity, 4>* players) {
+		for (size_t iPort = 0; iPort < 4; ++iPort) {
+			PlayerIdentity& player = (*players)[iPort];
+			player.tag_code = slip::parseConnCode(read_field(game_start, game_start_size, slip::O_CONN_CODE, CONN_CODE_SIZE, iPort));
+			player.slippi_uid = read_field(game_start, game_start_size, slip::O_SLIPPI_UID, SLIPPI_UID_SIZE, iPort);
+			player.disp_name = slip::sj2utf8(read_field(game_start, game_start_size, slip::O_DISP_NAME, DISP_NAME_SIZE, iPort));
+		}
+	}
+
+	uint64_t ReplayFingerprint(const char* slp, size_t size) {
+		slip::EventStream event_stream;
+		if (!event_stream.open(slp, static_cast<uint32_t>(size)) || !event_stream.valid() || event_stream.code() != Event::GAME_START) {
+			return 0;
+		}
+		// Everything up to the end of the game start block: the file header, the payload sizes event and the game start event
+		size_t game_start_end = static_cast<size_t>(event_stream.data() - slp) + event_stream.eventSize();
+		uint64_t seed = event_stream.eventSize() >= slip::O_RNG_GAME_START + 4 ? slip::readBE4U(const_cast<char*>(&event_stream.data()[slip::O_RNG_GAME_START])) : 0;
+		uint64_t seed_and_size[2] = { seed, static_cast<uint64_t>(size) };
+		return Hash64(seed_and_size, sizeof(seed_and_size), Hash64(slp, game_start_end));
+	}
+
+	size_t CorpusManifest::AddPath(const std::filesystem::path& path, size_t thread_count) {
+		std::vector<std::filesystem::path> file_paths;
+		if (std::filesystem::is_directory(path)) {
+			for (const auto& file_entry : std::filesystem::recursive_directory_iterator(path)) {
+				if (file_entry.is_regular_file()) {
+					file_paths.push_back(file_entry.path());
+				}
+			}
+			std::sort(file_paths.begin(), file_paths.end());
+		}
+		else {
+			file_paths.push_back(path);
+		}
+
+		// List the replays that aren't in the manifest yet, then read them all in parallel
+		std::vector<CorpusEntry> new_entries;
+		for (const std::filesystem::path& file_path : file_paths) {
+			if (ReplayPack::IsPack(file_path)) {
+				ReplayPack pack;
+				if (!pack.Open(file_path)) {
+					continue;
+				}
+				for (size_t iMember = 0; iMember < pack.Entries().size(); ++iMember) {
+					CorpusEntry entry;
+					entry.path = manifest_path(file_path);
+					entry.member = static_cast<uint32_t>(iMember);
+					entry.content_hash = pack.Entries()[iMember].content_hash;
+					if (m_locations.count({ entry.path, entry.member }) == 0) {
+						new_entries.push_back(std::move(entry));
+					}
+				}
+			}
+			else if (file_path.extension() == ".slp") {
+				CorpusEntry entry;
+				entry.path = manifest_path(file_path);
+				if (m_locations.count({ entry.path, entry.member }) == 0) {
+					new_entries.push_back(std::move(entry));
+				}
+			}
+		}
+		std::vector<uint32_t> indices(new_entries.size());
+		std::iota(indices.begin(), indices.end(), 0);
+		for_each_replay(new_entries, indices, thread_count, [](CorpusEntry& entry, const char* slp, size_t size) {
+			read_game_start(slp, size, &entry);
+		});
+
+		size_t added_count = 0;
+		for (CorpusEntry& entry : new_entries) {
+			if (entry.fingerprint == 0) {
+				std::cout << "Skipping " << entry.path << ", not a valid replay" << std::endl;
+				continue;
+			}
+			if (AddEntry(std::move(entry))) {
+				++added_count;
+			}
+		}
+		return added_count;
+	}
+
+	size_t CorpusManifest::Deduplicate(size_t thread_count) {
+		// Entries from manifests written before fingerprints get theirs first
+		std::vector<uint32_t> unfingerprinted;
+		for (uint32_t iEntry = 0; iEntry < m_entries.size(); ++iEntry) {
+			if (m_entries[iEntry].fingerprint == 0) {
+				unfingerprinted.push_back(iEntry);
+			}
+		}
+		for_each_replay(m_entries, unfingerprinted, thread_count, [](CorpusEntry& entry, const char* slp, size_t size) {
+			entry.fingerprint = ReplayFingerprint(slp, size);
+		});
+
+		// Only entries sharing a fingerprint can be copies of each other, so only those get their whole content hashed
+		std::unordered_map<uint64_t, std::vector<uint32_t>> fingerprint_groups;
+		for (uint32_t iEntry = 0; iEntry < m_entries.size(); ++iEntry) {
+			if (m_entries[iEntry].fingerprint != 0) {
+				fingerprint_groups[m_entries[iEntry].fingerprint].push_back(iEntry);
+			}
+		}
+		std::vector<uint32_t> unhashed;
+		for (const auto& [fingerprint, group] : fingerprint_groups) {
+			if (group.size() > 1) {
+				std::copy_if(group.begin(), group.end(), std::back_inserter(unhashed), [this](uint32_t iEntry) { return m_entries[iEntry].content_hash == 0; });
+			}
+		}
+		for_each_replay(m_entries, unhashed, thread_count, [](CorpusEntry& entry, const char* slp, size_t size) {
+			entry.content_hash = Hash64(slp, size);
+		});
+
+		// The first entry with some content is the original, every later one a duplicate of it
+		size_t duplicate_count = 0;
+		for (CorpusEntry& entry : m_entries) {
+			entry.duplicate_of = NO_DUPLICATE;
+		}
+		for (const auto& [fingerprint, group] : fingerprint_groups) {
+			std::unordered_map<uint64_t, uint32_t> originals;
+			for (uint32_t iEntry : group) {
+				if (group.size() < 2 || m_entries[iEntry].content_hash == 0) {
+					continue;
+				}
+				auto [original, is_original] = originals.emplace(m_entries[iEntry].content_hash, iEntry);
+				if (!is_original) {
+					m_entries[iEntry].duplicate_of = original->second;
+					++duplicate_count;
+				}
+			}
+		}
+		IndexPlayers();
+		return duplicate_count;
+	}
+
+	void CorpusManifest::Clear() {
+		m_entries.clear();
+		m_player_games.clear();
+		m_locations.clear();
+	}
+
+	bool CorpusManifest::Save(const std::filesystem::path& path) const {
+		std::string out;
+		write_le(&out, CORPUS_MANIFEST_MAGIC);
+		write_le(&out, CORPUS_MANIFEST_VERSION);
+		write_le<uint64_t>(&out, m_entries.size());
+		for (const CorpusEntry& entry : m_entries) {
+			write_entry(&out, entry);
+		}
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(out.data(), out.size());
+		return static_cast<bool>(file);
+	}
+
+	bool CorpusManifest::Load(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		std::string in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (in.size() < CORPUS_HEADER_SIZE) {
+			return false;
+		}
+		ManifestReader reader{ in.data(), in.data() + in.size() };
+		uint32_t magic = reader.read<uint32_t>();
+		uint32_t version = reader.read<uint32_t>();
+		uint64_t entry_count = reader.read<uint64_t>();
+		if (magic != CORPUS_MANIFEST_MAGIC || version > CORPUS_MANIFEST_VERSION) {
+			return false;
+		}
+		std::vector<CorpusEntry> entries;
+		for (uint64_t iEntry = 0; iEntry < entry_count && reader.ok; ++iEntry) {
+			entries.push_back(read_entry(&reader, version));
+			// A duplicate always comes after its original
+			if (entries.back().duplicate_of != NO_DUPLICATE && entries.back().duplicate_of >= iEntry) {
+				return false;
+			}
+		}
+		if (!reader.ok) {
+			return false;
+		}
+		Clear();
+		for (CorpusEntry& entry : entries) {
+			if (!AddEntry(std::move(entry))) {
+				Clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const std::vector<PlayerGame>& CorpusManifest::FindPlayer(const std::string& player) const {
+		static const std::vector<PlayerGame> no_games;
+		auto found = m_player_games.find(player);
+		return found != m_player_games.end() ? found->second : no_games;
+	}
+
+	size_t CorpusManifest::DuplicateCount() const {
+		return std::count_if(m_entries.begin(), m_entries.end(), [](const CorpusEntry& entry) { return entry.duplicate_of != NO_DUPLICATE; });
+	}
+
+	bool CorpusManifest::AddEntry(CorpusEntry entry) {
+		if (!m_locations.insert({ entry.path, entry.member }).second) {
+			return false;
+		}
+		m_entries.push_back(std::move(entry));
+		IndexEntry(static_cast<uint32_t>(m_entries.size() - 1));
+		return true;
+	}
+
+	void CorpusManifest::IndexEntry(uint32_t iEntry) {
+		const CorpusEntry& entry = m_entries[iEntry];
+		if (entry.duplicate_of != NO_DUPLICATE) {
+			return;
+		}
+		for (size_t iPort = 0; iPort < 4; ++iPort) {
+			if (entry.player_types[iPort] == 3) {
+				continue;
+			}
+			const PlayerIdentity& player = entry.players[iPort];
+			for (const std::string* identity : { &player.tag_code, &player.slippi_uid, &player.disp_name }) {
+				if (identity->empty()) {
+					continue;
+				}
+				// A display name can be the same as the connect code, and one identity can be on both ports (e.g. a display name),
+				// the game should only be listed once, with the first of its ports
+				std::vector<PlayerGame>& games = m_player_games[*identity];
+				if (games.empty() || games.back().entry != iEntry) {
+					games.push_back({ iEntry, static_cast<uint8_t>(iPort) });
+				}
+			}
+		}
+	}
+
+	void CorpusManifest::IndexPlayers() {
+		m_player_games.clear();
+		for (uint32_t iEntry = 0; iEntry < m_entries.size(); ++iEntry) {
+			IndexEntry(iEntry);
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "pch.h"
+
+#include "pack.h"
+
+namespace Crunch {
+	// Persistent manifest of a replay corpus: one entry per loose .slp or pack member, with who played on each port as read
+	// from the game start block alone, and an index from every player identity (connect code, Slippi UID or display name)
+	// to the games they played, so a crunch can be limited to one player's games without parsing anything else.
+	// Copies of the same game (from several setups or backups) are found by Deduplicate() and left out of the index and of crunches.
+	// Saved as ".slpcorpus" (magic "SLCM"), all integers little-endian:
+	//   header  : magic | u32 version | u64 entry count
+	//   entries : one variable-length CorpusEntry record per entry (see corpus.cpp)
+	// The identity index isn't saved, it's rebuilt from the entries on load.
+	constexpr uint32_t CORPUS_MANIFEST_MAGIC = 0x4D434C53; // "SLCM"
+	constexpr uint32_t CORPUS_MANIFEST_VERSION = 2; // 2: fingerprints, content hashes and duplicates
+	constexpr const char* CORPUS_MANIFEST_EXTENSION = ".slpcorpus";
+	constexpr uint32_t NO_PACK_MEMBER = std::numeric_limits<uint32_t>::max();
+	constexpr uint32_t NO_DUPLICATE = std::numeric_limits<uint32_t>::max();
+
+	// Slippi Online identity of whoever played on a port, all empty for offline players
+	struct PlayerIdentity {
+		std::string tag_code;   // connect code, e.g. "YOYO#278"
+		std::string slippi_uid; // Firebase UID of the Slippi account
+		std::string disp_name;  // Slippi Online display name
+	};
+
+	struct CorpusEntry {
+		std::string path;                 // the .slp file, or the .slpack holding the replay, canonical
+		uint32_t member = NO_PACK_MEMBER; // index of the replay in its pack
+		uint64_t size = 0;                // size of the .slp file (decoded, for pack members)
+		uint64_t fingerprint = 0;         // see ReplayFingerprint, 0 if it hasn't been computed
+		uint64_t content_hash = 0;        // Hash64 of the whole .slp, 0 until a fingerprint collision needs it (packs record it for free)
+		uint32_t duplicate_of = NO_DUPLICATE; // the first entry with the same content, if this is a copy of it
+		std::array<uint8_t, 4> player_types = { 3, 3, 3, 3 };
+		std::array<PlayerIdentity, 4> players;
+	};
+
+	// One game of a player: which manifest entry, and the port they played on in it
+	struct PlayerGame {
+		uint32_t entry;
+		uint8_t port;
+	};
+
+	// Reads the ports' identities out of a raw game start event (the event code included); identities older replays don't record stay empty
+	void ReadPlayerIdentities(const char* game_start, size_t game_start_size, std::array<PlayerIdentity, 4>* players);
+	// Cheap identity of a raw replay: Hash64 of its header and payload sizes, its game start block, its RNG seed and its size,
+	// so only the start of the file is read. Copies of a game always share it and distinct games practically never do, but
+	// it's only a candidate match: duplicates are confirmed with a full content hash. 0 if it isn't a raw replay
+	uint64_t ReplayFingerprint(const char* slp, size_t size);
+
+	class CorpusManifest {
+	public:
+		// Adds every .slp and pack member under the path (a directory, a .slp or a .slpack) that isn't in the manifest yet, on
+		// thread_count threads (0 = one per core); returns the number of entries added. Loose replays and raw pack members are mapped
+		// and only read up to their game start block, but LZMA and .zlp members have to be decoded whole first
+		size_t AddPath(const std::filesystem::path& path, size_t thread_count = 0);
+		// Dedup stage: groups the entries by fingerprint, hashes the full content of only the groups of more than one entry
+		// (in parallel, and once: hashes are kept in the manifest), and marks every copy of an earlier entry as its duplicate.
+		// Returns the number of duplicates
+		size_t Deduplicate(size_t thread_count = 0);
+		void Clear();
+
+		bool Save(const std::filesystem::path& path) const;
+		bool Load(const std::filesystem::path& path);
+
+		const std::vector<CorpusEntry>& Entries() const { return m_entries; }
+		// Every game of the player whose connect code, Slippi UID or display name is player, once each in entry order, duplicates left out
+		const std::vector<PlayerGame>& FindPlayer(const std::string& player) const;
+		size_t IdentityCount() const { return m_player_games.size(); }
+		size_t DuplicateCount() const;
+	private:
+		std::vector<CorpusEntry> m_entries;
+		std::unordered_map<std::string, std::vector<PlayerGame>> m_player_games;
+		std::set<std::pair<std::string, uint32_t>> m_locations;
+
+		bool AddEntry(CorpusEntry entry);
+		void IndexEntry(uint32_t iEntry);
+		void IndexPlayers();
+	};
+}
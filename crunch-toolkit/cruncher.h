@@ -1,6 +1,9 @@
 #pragma once
 
 #include "pch.h"
+#include "pack.h"
+#include "corpus.h"
+#include "comboset.h"
 
 //template<typename R>
 //void worker_thread_func(std::promise<R>&& promise) {
@@ -15,56 +18,279 @@ namespace Crunch {
 		std::vector<Combo> Crunch(const ComboScoreFunc combo_score_func);
 	};
 	using CrunchFuncPtr = std::add_pointer_t<void*(const slip::SlippiReplay& combo)>;*/
+	// Context type for crunch functions that don't keep per-worker state
+	struct NoCrunchContext {};
+
+	template<typename R, typename Context>
+	struct DefaultCrunchFunc {
+		using type = R(*)(std::unique_ptr<slip::Parser>, Context&);
+	};
 	template<typename R>
+	struct DefaultCrunchFunc<R, NoCrunchContext> {
+		using type = R(*)(std::unique_ptr<slip::Parser>);
+	};
+
+	// crunch_func is any callable taking the loaded parser (plus the worker's Context& when Context isn't NoCrunchContext) and returning R.
+	// Each worker thread calls its own copy of crunch_func, so stateful functors need no locking, and owns one Context,
+	// made by context_factory (or default-constructed if there's none) on that thread and kept until the next Crunch() so per-worker
+	// accumulators can be read back through Cruncher::Contexts(). A Context that isn't default-constructible needs a context_factory.
+	template<typename R, typename Context = NoCrunchContext, typename Func = typename DefaultCrunchFunc<R, Context>::type>
 	struct CruncherDesc {
-		R(*crunch_func)(std::unique_ptr<slip::Parser>) = nullptr;
+		Func crunch_func = {};
+		std::function<Context()> context_factory;
 		std::filesystem::path path;
 		bool is_recursive = false;
+		// When corpus is set, its entries are crunched instead of everything under path, without the duplicates it found
+		// (see CorpusManifest::Deduplicate). player then selects only the games of one player (a connect code, Slippi UID or
+		// display name), and CrunchInput::Port() is the player's port in each of them
+		const CorpusManifest* corpus = nullptr;
+		std::string player;
+
+		CruncherDesc() = default;
+		explicit CruncherDesc(Func func) : crunch_func(std::move(func)) {}
 	};
-	template<typename R>
+
+	// Deduces the result type from a callable, e.g. MakeCruncherDesc([&](std::unique_ptr<slip::Parser> parser) { ... });
+	// Cruncher cruncher(cruncher_desc) then deduces the rest
+	template<typename Context = NoCrunchContext, typename Func>
+	auto MakeCruncherDesc(Func func) {
+		if constexpr (std::is_same_v<Context, NoCrunchContext>) {
+			return CruncherDesc<std::invoke_result_t<Func&, std::unique_ptr<slip::Parser>>, Context, Func>(std::move(func));
+		}
+		else {
+			return CruncherDesc<std::invoke_result_t<Func&, std::unique_ptr<slip::Parser>, Context&>, Context, Func>(std::move(func));
+		}
+	}
+	// One unit of work: either a loose .slp file or a member of an open replay pack
+	struct CrunchItem {
+		std::filesystem::path path;
+		const ReplayPack* pack = nullptr;
+		size_t pack_index = 0;
+		int port = -1; // port of the selected player, from the corpus manifest
+	};
+
+	// One parsed replay shared by every job of a fan-out crunch (see Cruncher::CrunchJobs); the analysis is only
+	// computed the first time a job asks for it, then reused by the others
+	class CrunchInput {
+	public:
+		CrunchInput(std::unique_ptr<slip::Parser> parser, const CrunchItem& item) : m_parser(std::move(parser)), m_item(&item) {}
+		slip::Parser& Parser() const { return *m_parser; }
+		// Where the replay was read from
+		const CrunchItem& Item() const { return *m_item; }
+		// Port of the CruncherDesc's selected player in this replay, -1 when the crunch has no player selector
+		int Port() const { return m_item->port; }
+		const slip::Analysis& Analysis() const {
+			if (!m_analysis) {
+				m_analysis.reset(m_parser->analyze());
+			}
+			return *m_analysis;
+		}
+	private:
+		std::unique_ptr<slip::Parser> m_parser;
+		mutable std::unique_ptr<slip::Analysis> m_analysis;
+		const CrunchItem* m_item;
+	};
+
+	// One job of a fan-out crunch, with its own accumulator and reducer:
+	//   map(A& accumulator, const CrunchInput& input[, Context&]) folds a replay into a worker's accumulator
+	//   combine(A& into, A&& from) merges two workers' accumulators (see Cruncher::CrunchReduce)
+	// Every worker starts from a value-initialized A.
+	template<typename A, typename Map, typename Combine>
+	struct CrunchJob {
+		using Accumulator = A;
+		Map map;
+		Combine combine;
+	};
+
+	template<typename A, typename Map, typename Combine>
+	CrunchJob<A, Map, Combine> MakeCrunchJob(Map map, Combine combine) {
+		return { std::move(map), std::move(combine) };
+	}
+
+	// Job whose result stream is one func(const CrunchInput&[, Context&]) -> R per replay, like Cruncher::Crunch()
+	template<typename R, typename Func>
+	auto MakeCollectJob(Func func) {
+		return MakeCrunchJob<std::vector<R>>(
+			[func](std::vector<R>& results, const CrunchInput& input, auto&... context) mutable { results.push_back(std::invoke(func, input, context...)); },
+			[](std::vector<R>& into, std::vector<R>&& from) { into.insert(into.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end())); });
+	}
+
+	template<typename R, typename Context = NoCrunchContext, typename Func = typename DefaultCrunchFunc<R, Context>::type>
 	class Cruncher {
 		//typedef RETURN_TYPE(*FUNC_PTR)(const slip::SlippiReplay& replay);
 		//FUNC_PTR func;
 	public:
-		Cruncher(CruncherDesc<R> cruncher_desc) : m_cruncher_desc(cruncher_desc) {
+		Cruncher(CruncherDesc<R, Context, Func> cruncher_desc) : m_cruncher_desc(std::move(cruncher_desc)) {
 			// empty ctor, nothing to do here (m_cruncher_desc already assigned through initializer list)
 		}
 		std::vector<R> Crunch() {
+			std::vector<std::vector<R>> thread_results = run_workers<std::vector<R>>([this](std::queue<CrunchItem>* file_entry_queue, std::atomic_size_t* processed_file_count, Context& context) {
+				std::vector<R> results;
+				Func crunch_func = m_cruncher_desc.crunch_func;
+				for_each_parsed(file_entry_queue, processed_file_count, [&](std::unique_ptr<slip::Parser> parser, const CrunchItem&) {
+					results.push_back(invoke_with_context(crunch_func, context, std::move(parser)));
+				});
+				return results;
+			});
+
+			// Aggregate the results of each thread into a single vector of results
+			// Each element of the returned results vector is the result of a call to crunch_func,
+			// i.e. one element of the results vector = the result of crunch_func'ing one slip::Parser/.slp replay file
+			std::vector<R> results;
+			for (auto& thread_result : thread_results) {
+				results.insert(results.end(), std::make_move_iterator(thread_result.begin()), std::make_move_iterator(thread_result.end()));
+			}
+			return results;
+		}
+
+		// Map-reduce variant for aggregations: returns only the final aggregate instead of one R per file.
+		// Each worker folds its files into its own copy of init with map(A& accumulator, std::unique_ptr<slip::Parser>[, Context&]),
+		// then the per-worker accumulators are merged pairwise in parallel rounds with combine(A& into, A&& from), keeping worker order.
+		// combine is called concurrently on distinct pairs, so it must not touch shared state; crunch_func is not used.
+		template<typename A, typename Map, typename Combine>
+		A CrunchReduce(A init, Map map, Combine combine) {
+			auto item_map = ignore_item(std::move(map));
+			return crunch_reduce([&init]() { return init; }, item_map, combine);
+		}
+		// Same, with each worker starting from a value-initialized A (for move-only accumulators)
+		template<typename A, typename Map, typename Combine>
+		A CrunchReduce(Map map, Combine combine) {
+			auto item_map = ignore_item(std::move(map));
+			return crunch_reduce([]() { return A{}; }, item_map, combine);
+		}
+
+		// Fan-out variant: runs several jobs (see CrunchJob) over one load, parse and analysis of each replay,
+		// and returns a tuple with each job's final accumulator, in job order.
+		// Each worker gets its own copy of every job's map; crunch_func is not used.
+		template<typename... Jobs>
+		std::tuple<typename Jobs::Accumulator...> CrunchJobs(Jobs... jobs) {
+			using Accumulators = std::tuple<typename Jobs::Accumulator...>;
+			std::tuple<Jobs...> job_tuple(std::move(jobs)...);
+			auto map = [job_tuple](Accumulators& accumulators, std::unique_ptr<slip::Parser> parser, const CrunchItem& item, auto&... context) mutable {
+				CrunchInput input(std::move(parser), item);
+				map_jobs(job_tuple, accumulators, input, std::index_sequence_for<Jobs...>(), context...);
+			};
+			auto combine = [&job_tuple](Accumulators& into, Accumulators&& from) {
+				combine_jobs(job_tuple, into, std::move(from), std::index_sequence_for<Jobs...>());
+			};
+			return crunch_reduce([]() { return Accumulators{}; }, map, combine);
+		}
+
+		// Each worker's context from the last Crunch(), in worker order
+		const std::vector<std::unique_ptr<Context>>& Contexts() const {
+			return m_contexts;
+		}
+	private:
+		CruncherDesc<R, Context, Func> m_cruncher_desc;
+		std::vector<std::unique_ptr<ReplayPack>> m_packs; // packs stay mapped while the workers read their members
+		std::vector<std::unique_ptr<Context>> m_contexts;
+
+		// Queues every replay under the desc's path, then runs worker(queue, processed count, context) -> T on each worker thread
+		// while logging their progress; returns each worker's T, in worker order
+		template<typename T, typename Worker>
+		std::vector<T> run_workers(Worker worker) {
 			const size_t processor_count = std::thread::hardware_concurrency();
 			const size_t worker_thread_count = processor_count > 2 ? processor_count - 1 : 1; // leave 1 processor free for main thread if possible
 			// for processor_count, make it std::max(1, processor_count - 1)
 			// that way we can have a main thread free for printing info, if not we'll just have to live
 			// with the CPU being hogged and having slow info printing
 
-			std::vector<std::queue<std::filesystem::directory_entry>> file_entry_queues(worker_thread_count);
+			std::vector<std::queue<CrunchItem>> file_entry_queues(worker_thread_count);
 			std::vector<std::atomic_size_t> processed_file_counts(worker_thread_count);
 			
 			// Setup the file queues for each thread
 			std::chrono::steady_clock::time_point file_begin_time = std::chrono::steady_clock::now();
 			size_t file_count = 0;
-			for (const auto& file_entry : std::filesystem::recursive_directory_iterator(m_cruncher_desc.path)) {
-				bool is_file = !file_entry.is_directory() && (file_entry.is_regular_file() || file_entry.is_symlink());
-				bool is_slp_file = is_file && file_entry.path().has_extension() && file_entry.path().extension() == ".slp";
-				if (is_slp_file) {
-					std::cout << "Adding " << file_entry.path() << " to the parse queue" << std::endl;
-					file_entry_queues[file_count % worker_thread_count].push(file_entry);
+			auto queue_pack = [&](const std::filesystem::path& pack_path) {
+				auto pack = std::make_unique<ReplayPack>();
+				if (!pack->Open(pack_path)) {
+					return;
+				}
+				std::cout << "Adding " << pack->Entries().size() << " replays from pack " << pack_path << " to the parse queue" << std::endl;
+				for (size_t iMember = 0; iMember < pack->Entries().size(); ++iMember) {
+					file_entry_queues[file_count % worker_thread_count].push({ pack_path, pack.get(), iMember });
 					file_count++;
 				}
+				m_packs.push_back(std::move(pack));
+			};
+			if (m_cruncher_desc.corpus != nullptr) {
+				// Straight from the manifest: only the selected player's games, or every game once, and nothing else is opened
+				const CorpusManifest& corpus = *m_cruncher_desc.corpus;
+				std::vector<PlayerGame> corpus_games;
+				if (!m_cruncher_desc.player.empty()) {
+					corpus_games = corpus.FindPlayer(m_cruncher_desc.player);
+				}
+				else {
+					for (uint32_t iEntry = 0; iEntry < corpus.Entries().size(); ++iEntry) {
+						if (corpus.Entries()[iEntry].duplicate_of == NO_DUPLICATE) {
+							corpus_games.push_back({ iEntry, 0 });
+						}
+					}
+				}
+				std::map<std::string, const ReplayPack*> corpus_packs;
+				for (const PlayerGame& game : corpus_games) {
+					const CorpusEntry& entry = corpus.Entries()[game.entry];
+					CrunchItem item = { entry.path, nullptr, entry.member, m_cruncher_desc.player.empty() ? -1 : game.port };
+					if (entry.member != NO_PACK_MEMBER) {
+						auto [pack_it, is_new_pack] = corpus_packs.emplace(entry.path, nullptr);
+						if (is_new_pack) {
+							auto pack = std::make_unique<ReplayPack>();
+							if (pack->Open(entry.path)) {
+								pack_it->second = pack.get();
+								m_packs.push_back(std::move(pack));
+							}
+						}
+						if (pack_it->second == nullptr || entry.member >= pack_it->second->Entries().size()) {
+							continue;
+						}
+						item.pack = pack_it->second;
+					}
+					file_entry_queues[file_count % worker_thread_count].push(std::move(item));
+					file_count++;
+				}
+				std::cout << "Adding " << file_count << " games" << (m_cruncher_desc.player.empty() ? "" : " of " + m_cruncher_desc.player) << " from the corpus manifest to the parse queue" << std::endl;
+			}
+			else if (ReplayPack::IsPack(m_cruncher_desc.path)) {
+				queue_pack(m_cruncher_desc.path);
+			}
+			else {
+				for (const auto& file_entry : std::filesystem::recursive_directory_iterator(m_cruncher_desc.path)) {
+					bool is_file = !file_entry.is_directory() && (file_entry.is_regular_file() || file_entry.is_symlink());
+					bool is_slp_file = is_file && file_entry.path().has_extension() && file_entry.path().extension() == ".slp";
+					if (is_slp_file) {
+						std::cout << "Adding " << file_entry.path() << " to the parse queue" << std::endl;
+						file_entry_queues[file_count % worker_thread_count].push({ file_entry.path() });
+						file_count++;
+					}
+					else if (is_file && ReplayPack::IsPack(file_entry.path())) {
+						queue_pack(file_entry.path());
+					}
+				}
 			}
 			std::chrono::steady_clock::time_point file_end_time = std::chrono::steady_clock::now();
 			std::cout << "Added " << file_count << " files in " << std::chrono::duration_cast<std::chrono::seconds>(file_end_time - file_begin_time).count() << " seconds" << std::endl;
 			std::cin.get();
 
 			std::vector<std::thread> threads;
-			std::vector<std::future<std::vector<R>>> thread_futures;
+			std::vector<std::future<T>> thread_futures;
+			m_contexts.clear();
+			m_contexts.resize(worker_thread_count);
 			
-			// Spawn the threads
+			// Spawn the threads, each with its own copy of its queue and a context made on that thread
 			std::cout << "Starting " << worker_thread_count << " worker threads to parse " << file_count << " files" << std::endl;
 			std::chrono::steady_clock::time_point crunch_begin_time = std::chrono::steady_clock::now();
 			for (size_t iThread = 0; iThread < worker_thread_count; ++iThread) {
-				std::promise<std::vector<R>> promise;
+				std::promise<T> promise;
 				thread_futures.emplace_back(std::move(promise.get_future()));
-				threads.emplace_back(&Cruncher<R>::worker_thread_func, this, file_entry_queues[iThread], &(processed_file_counts[iThread]), std::move(promise));
+				threads.emplace_back([this, &worker, file_entry_queue = file_entry_queues[iThread], processed_file_count = &(processed_file_counts[iThread]), context = &(m_contexts[iThread]), promise = std::move(promise)]() mutable {
+					if constexpr (std::is_default_constructible_v<Context>) {
+						*context = m_cruncher_desc.context_factory ? std::make_unique<Context>(m_cruncher_desc.context_factory()) : std::make_unique<Context>();
+					}
+					else {
+						*context = std::make_unique<Context>(m_cruncher_desc.context_factory());
+					}
+					promise.set_value(worker(&file_entry_queue, processed_file_count, **context));
+				});
 			}
 
 			// Log the threads' progress
@@ -85,43 +311,102 @@ namespace Crunch {
 			std::chrono::steady_clock::time_point crunch_end_time = std::chrono::steady_clock::now();
 			std::cout << "Crunched " << file_count << " files in " << std::chrono::duration_cast<std::chrono::seconds>(crunch_end_time - crunch_begin_time).count() << " seconds" << std::endl;
 
-			// Aggregate the results of each thread into a single vector of results
-			// Each element of the returned results vector is the result of a call to crunch_func,
-			// i.e. one element of the results vector = the result of crunch_func'ing one slip::Parser/.slp replay file
-			std::vector<R> results;
+			std::vector<T> thread_results;
 			for (auto& thread_future : thread_futures) {
-				auto thread_future_result = thread_future.get();
-				results.insert(results.end(), thread_future_result.begin(), thread_future_result.end());
+				thread_results.push_back(thread_future.get());
 			}
-			return results;
+			m_packs.clear();
+			return thread_results;
 		}
-	private:
-		CruncherDesc<R> m_cruncher_desc;
 
-		// should be floating function or not?
-		// should templated stuff be marked inline or not?
-		void worker_thread_func(std::queue<std::filesystem::directory_entry> file_entry_queue, std::atomic_size_t* processed_file_count, std::promise<std::vector<R>>&& promise) {
-			std::vector<R> results;
+		// map(A& accumulator, std::unique_ptr<slip::Parser>, const CrunchItem&[, Context&]) folds each replay into its worker's accumulator
+		template<typename MakeAccumulator, typename Map, typename Combine>
+		auto crunch_reduce(MakeAccumulator make_accumulator, Map& map, Combine& combine) {
+			using A = decltype(make_accumulator());
+			std::vector<A> accumulators = run_workers<A>([&](std::queue<CrunchItem>* file_entry_queue, std::atomic_size_t* processed_file_count, Context& context) {
+				A accumulator = make_accumulator();
+				Map worker_map = map;
+				for_each_parsed(file_entry_queue, processed_file_count, [&](std::unique_ptr<slip::Parser> parser, const CrunchItem& item) {
+					invoke_with_context(worker_map, context, accumulator, std::move(parser), item);
+				});
+				return accumulator;
+			});
+			return tree_reduce(std::move(accumulators), combine);
+		}
+
+		// Adapts a CrunchReduce map to crunch_reduce, which also hands maps the replay's CrunchItem
+		template<typename Map>
+		static auto ignore_item(Map map) {
+			return [map = std::move(map)](auto& accumulator, std::unique_ptr<slip::Parser> parser, const CrunchItem&, auto&... context) mutable {
+				std::invoke(map, accumulator, std::move(parser), context...);
+			};
+		}
 
-			auto curr_file_entry = pop_file_entry(&file_entry_queue);
+		// Loads each queued replay and hands the parser and its CrunchItem to on_parsed, counting the ones that parsed
+		template<typename OnParsed>
+		void for_each_parsed(std::queue<CrunchItem>* file_entry_queue, std::atomic_size_t* processed_file_count, OnParsed&& on_parsed) {
+			auto curr_file_entry = pop_file_entry(file_entry_queue);
 			while (curr_file_entry.has_value()) {
 				//std::cout << "Parsing " << curr_file_entry.value().path() << std::endl;
-				std::unique_ptr<slip::Parser> parser = std::make_unique<slip::Parser>(0);
-				bool did_parse = parser->load(curr_file_entry.value().path().string().c_str());
+				std::unique_ptr<slip::Parser> parser;
+				bool did_parse = false;
+				if (curr_file_entry.value().pack != nullptr) {
+					parser = curr_file_entry.value().pack->LoadMember(curr_file_entry.value().pack_index);
+					did_parse = parser != nullptr;
+				}
+				else {
+					parser = std::make_unique<slip::Parser>(0);
+					did_parse = parser->load(curr_file_entry.value().path.string().c_str());
+				}
 				if (did_parse) {
 					//std::cout << "Crunching " << curr_file_entry.value().path() << std::endl;
-					R func_result = m_cruncher_desc.crunch_func(std::move(parser));
-					results.push_back(func_result);
+					on_parsed(std::move(parser), curr_file_entry.value());
 					processed_file_count->store(processed_file_count->load() + 1);
 				}
 
-				curr_file_entry = pop_file_entry(&file_entry_queue);
+				curr_file_entry = pop_file_entry(file_entry_queue);
 			}
+		}
 
-			promise.set_value(results);
+		// Calls func(args...), adding the worker's context as the last argument when there is one
+		template<typename F, typename... Args>
+		static decltype(auto) invoke_with_context(F& func, Context& context, Args&&... args) {
+			if constexpr (std::is_same_v<Context, NoCrunchContext>) {
+				return std::invoke(func, std::forward<Args>(args)...);
+			}
+			else {
+				return std::invoke(func, std::forward<Args>(args)..., context);
+			}
+		}
+
+		template<typename JobTuple, typename Accumulators, size_t... I, typename... WorkerContext>
+		static void map_jobs(JobTuple& jobs, Accumulators& accumulators, const CrunchInput& input, std::index_sequence<I...>, WorkerContext&... context) {
+			(std::invoke(std::get<I>(jobs).map, std::get<I>(accumulators), input, context...), ...);
+		}
+
+		template<typename JobTuple, typename Accumulators, size_t... I>
+		static void combine_jobs(JobTuple& jobs, Accumulators& into, Accumulators&& from, std::index_sequence<I...>) {
+			(std::invoke(std::get<I>(jobs).combine, std::get<I>(into), std::move(std::get<I>(from))), ...);
+		}
+
+		// Merges accumulators pairwise, each round in parallel, until only the first one is left
+		template<typename A, typename Combine>
+		static A tree_reduce(std::vector<A> accumulators, Combine& combine) {
+			for (size_t stride = 1; stride < accumulators.size(); stride *= 2) {
+				std::vector<std::thread> threads;
+				for (size_t iInto = 0; iInto + stride < accumulators.size(); iInto += 2 * stride) {
+					threads.emplace_back([&accumulators, &combine, iInto, stride]() {
+						combine(accumulators[iInto], std::move(accumulators[iInto + stride]));
+					});
+				}
+				for (auto& thread : threads) {
+					thread.join();
+				}
+			}
+			return std::move(accumulators.front());
 		}
 
-		std::optional<std::filesystem::directory_entry> pop_file_entry(std::queue<std::filesystem::directory_entry>* file_entry_queue) {
+		std::optional<CrunchItem> pop_file_entry(std::queue<CrunchItem>* file_entry_queue) {
 			if (!file_entry_queue->empty()) {
 				auto file_entry = file_entry_queue->front();
 				file_entry_queue->pop();
@@ -130,7 +415,8 @@ namespace Crunch {
 			return std::nullopt;
 		}
 
-		bool are_threads_running(std::vector<std::future<std::vector<R>>>* thread_futures) {
+		template<typename T>
+		bool are_threads_running(std::vector<std::future<T>>* thread_futures) {
 			for (const auto& thread_future : (*thread_futures)) {
 				auto status = thread_future.wait_for(std::chrono::milliseconds::zero());
 				if (status != std::future_status::ready) {
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Crunch {
+	// 64-bit non-cryptographic content hash (XXH64), used to identify replays independently of their file name
+	uint64_t Hash64(const void* data, size_t length, uint64_t seed = 0);
+	uint64_t HashFile(const std::filesystem::path& path);
+}
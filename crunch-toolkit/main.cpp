@@ -3,31 +3,31 @@
 
 #include "cruncher.h"
 #include "combo.h"
+#include "combofilter.h"
 
-bool is_combo_valid(const Crunch::Combo& combo) {
-	return combo.DidKill() && combo.TotalMoveCount() >= 7 && combo.TotalDamage() >= 60 && !combo.ExceedsSingleAttackDamageRatioThreshold(0.25f);
-}
+constexpr auto COMBO_FILTER = Crunch::Filter::kill && Crunch::Filter::moves >= 7 && Crunch::Filter::damage >= 60
+	&& Crunch::Filter::max_hit_ratio <= 0.25 && Crunch::Filter::player_code == "YOYO#278";
 
 std::vector<Crunch::Combo> find_combos_from_analysis(const slip::Analysis& analysis) {
 	std::vector<Crunch::Combo> combos;
 
-	int port_to_use = analysis.ap[0].tag_code == "YOYO#278" ? 0 : 1;
-	const slip::AnalysisPlayer& player_analysis = analysis.ap[port_to_use];
+	for (size_t iPlayer = 0; iPlayer < 2; ++iPlayer) {
+		const slip::AnalysisPlayer& player_analysis = analysis.ap[iPlayer];
 
-	Crunch::Combo curr_combo;
-	for (size_t iAttack = 0; player_analysis.attacks[iAttack].frame > 0; ++iAttack) {
-		const slip::Attack& curr_attack = player_analysis.attacks[iAttack];
-		const slip::Punish& curr_punish = player_analysis.punishes[curr_attack.punish_id];
+		Crunch::Combo curr_combo;
+		for (size_t iAttack = 0; player_analysis.attacks[iAttack].frame > 0; ++iAttack) {
+			const slip::Attack& curr_attack = player_analysis.attacks[iAttack];
 
-		if (!curr_combo.attacks.empty() && curr_attack.punish_id != curr_combo.attacks.back().punish_id) {
-			curr_combo.punish = player_analysis.punishes[curr_combo.attacks.back().punish_id];
-			if (is_combo_valid(curr_combo)) {
-				combos.push_back(curr_combo);
+			if (!curr_combo.attacks.empty() && curr_attack.punish_id != curr_combo.attacks.back().punish_id) {
+				curr_combo.punish = player_analysis.punishes[curr_combo.attacks.back().punish_id];
+				if (COMBO_FILTER(Crunch::ComboFilterRow(curr_combo.View(), &analysis, iPlayer))) {
+					combos.push_back(curr_combo);
+				}
+				curr_combo = {};
 			}
-			curr_combo = {};
-		}
 
-		curr_combo.attacks.push_back(curr_attack);
+			curr_combo.attacks.push_back(curr_attack);
+		}
 	}
 
 	return combos;
@@ -0,0 +1,382 @@
+
+#include "pch.h"
+
+#include "movepattern.h"
+
+namespace Crunch {
+	namespace {
+		std::string to_lower(std::string_view text) {
+			std::string lower(text);
+			std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			return lower;
+		}
+	}
+
+	int FindMoveId(std::string_view name) {
+		// Numbers first: some shortnames are numeric placeholders that don't match their own id (66 is "6")
+		int number = 0;
+		auto [end, error] = std::from_chars(name.data(), name.data() + name.size(), number);
+		if (error == std::errc() && end == name.data() + name.size()) {
+			return number >= 0 && number < Move::__LAST ? number : -1;
+		}
+		// Keyed without punctuation, which move names can't contain ("Misc." is "misc")
+		static const std::unordered_map<std::string, int> move_ids = []() {
+			std::unordered_map<std::string, int> ids;
+			for (int iMove = 0; iMove < Move::__LAST; ++iMove) {
+				std::string key;
+				for (char c : to_lower(Move::shortname[iMove])) {
+					if (std::isalnum(static_cast<unsigned char>(c))) {
+						key += c;
+					}
+				}
+				if (!key.empty() && !std::isdigit(static_cast<unsigned char>(key[0]))) {
+					ids.emplace(key, iMove);
+				}
+			}
+			return ids;
+		}();
+		auto move_id = move_ids.find(to_lower(name));
+		return move_id != move_ids.end() ? move_id->second : -1;
+	}
+
+	// Thompson construction: each rule returns an NFA fragment whose dangling edges are patched to whatever follows it
+	class MovePatternParser {
+	public:
+		MovePatternParser(std::string_view pattern, std::vector<MovePatternSet::NfaState>* nfa) : m_pattern(pattern), m_nfa(nfa) {}
+
+		// Returns the fragment's start state, ending in a MATCH state for the pattern, or -1 (see Error())
+		int Parse(uint32_t pattern_index) {
+			Fragment fragment = ParseAlternation();
+			SkipSeparators();
+			if (m_error.empty() && m_position < m_pattern.size()) {
+				Fail(std::string("unexpected '") + m_pattern[m_position] + "'");
+			}
+			if (!m_error.empty()) {
+				return -1;
+			}
+			int match = AddState(MovePatternSet::NfaState::MATCH);
+			(*m_nfa)[match].pattern = pattern_index;
+			Patch(fragment, match);
+			return fragment.start;
+		}
+		const std::string& Error() const { return m_error; }
+	private:
+		struct Fragment {
+			int start = -1;
+			std::vector<std::pair<int, bool>> outs; // (state, whether it's the state's out1 edge)
+		};
+
+		std::string_view m_pattern;
+		std::vector<MovePatternSet::NfaState>* m_nfa;
+		size_t m_position = 0;
+		std::string m_error;
+
+		void Fail(const std::string& message) {
+			if (m_error.empty()) {
+				m_error = message + " at column " + std::to_string(m_position + 1);
+			}
+		}
+
+		int AddState(MovePatternSet::NfaState::Type type) {
+			m_nfa->emplace_back();
+			m_nfa->back().type = type;
+			return static_cast<int>(m_nfa->size() - 1);
+		}
+
+		void Patch(const Fragment& fragment, int target) {
+			for (const auto& [state, is_out1] : fragment.outs) {
+				(is_out1 ? (*m_nfa)[state].out1 : (*m_nfa)[state].out) = target;
+			}
+		}
+
+		void SkipSeparators() {
+			while (m_position < m_pattern.size()) {
+				if (std::isspace(static_cast<unsigned char>(m_pattern[m_position])) || m_pattern[m_position] == ',') {
+					m_position += 1;
+				}
+				else if (m_pattern.substr(m_position, 2) == "->") {
+					m_position += 2;
+				}
+				else if (m_pattern.substr(m_position, 3) == "\xE2\x86\x92") { // →
+					m_position += 3;
+				}
+				else {
+					break;
+				}
+			}
+		}
+
+		bool Accept(char c) {
+			SkipSeparators();
+			if (m_position < m_pattern.size() && m_pattern[m_position] == c) {
+				m_position += 1;
+				return true;
+			}
+			return false;
+		}
+
+		std::string_view ReadName() {
+			SkipSeparators();
+			const size_t begin = m_position;
+			if (m_position < m_pattern.size() && m_pattern[m_position] == '.') {
+				m_position += 1;
+			}
+			else {
+				while (m_position < m_pattern.size() && std::isalnum(static_cast<unsigned char>(m_pattern[m_position]))) {
+					m_position += 1;
+				}
+			}
+			return m_pattern.substr(begin, m_position - begin);
+		}
+
+		Fragment ParseAlternation() {
+			Fragment fragment = ParseSequence();
+			while (m_error.empty() && Accept('|')) {
+				Fragment other = ParseSequence();
+				int split = AddState(MovePatternSet::NfaState::SPLIT);
+				(*m_nfa)[split].out = fragment.start;
+				(*m_nfa)[split].out1 = other.start;
+				fragment.start = split;
+				fragment.outs.insert(fragment.outs.end(), other.outs.begin(), other.outs.end());
+			}
+			return fragment;
+		}
+
+		Fragment ParseSequence() {
+			Fragment sequence;
+			while (m_error.empty()) {
+				SkipSeparators();
+				if (m_position >= m_pattern.size() || m_pattern[m_position] == '|' || m_pattern[m_position] == ')') {
+					break;
+				}
+				Fragment next = ParseRepeat();
+				if (sequence.start < 0) {
+					sequence = std::move(next);
+				}
+				else {
+					Patch(sequence, next.start);
+					sequence.outs = std::move(next.outs);
+				}
+			}
+			if (m_error.empty() && sequence.start < 0) {
+				Fail("expected a move");
+			}
+			return sequence;
+		}
+
+		Fragment ParseRepeat() {
+			Fragment fragment = ParseAtom();
+			while (m_error.empty()) {
+				SkipSeparators();
+				const char c = m_position < m_pattern.size() ? m_pattern[m_position] : '\0';
+				if (c != '*' && c != '+' && c != '?') {
+					break;
+				}
+				m_position += 1;
+				int split = AddState(MovePatternSet::NfaState::SPLIT);
+				(*m_nfa)[split].out = fragment.start;
+				if (c == '*') {
+					Patch(fragment, split);
+					fragment = { split, { { split, true } } };
+				}
+				else if (c == '+') {
+					Patch(fragment, split);
+					fragment.outs = { { split, true } };
+				}
+				else {
+					fragment.start = split;
+					fragment.outs.push_back({ split, true });
+				}
+			}
+			return fragment;
+		}
+
+		Fragment ParseAtom() {
+			if (Accept('(')) {
+				Fragment fragment = ParseAlternation();
+				if (m_error.empty() && !Accept(')')) {
+					Fail("expected ')'");
+				}
+				return fragment;
+			}
+			std::bitset<256> moves;
+			if (Accept('[')) {
+				const bool is_negated = Accept('^');
+				while (m_error.empty() && !Accept(']')) {
+					if (m_position >= m_pattern.size()) {
+						Fail("expected ']'");
+						break;
+					}
+					AddMove(ReadName(), &moves);
+				}
+				if (is_negated) {
+					moves.flip();
+				}
+			}
+			else {
+				AddMove(ReadName(), &moves);
+			}
+			int state = AddState(MovePatternSet::NfaState::MOVE);
+			(*m_nfa)[state].moves = moves;
+			return { state, { { state, false } } };
+		}
+
+		void AddMove(std::string_view name, std::bitset<256>* moves) {
+			if (name == ".") {
+				moves->set();
+				return;
+			}
+			int move_id = FindMoveId(name);
+			if (move_id < 0) {
+				Fail(name.empty() ? std::string("expected a move") : "unknown move '" + std::string(name) + "'");
+				return;
+			}
+			moves->set(move_id);
+		}
+	};
+
+	namespace {
+		// MOVE and MATCH states reachable through epsilon edges, sorted, which is what identifies a DFA state
+		template<typename NfaState>
+		std::vector<int> epsilon_closure(const std::vector<NfaState>& nfa, std::vector<int> pending) {
+			std::vector<int> closure;
+			std::vector<bool> visited(nfa.size());
+			while (!pending.empty()) {
+				int state = pending.back();
+				pending.pop_back();
+				if (state < 0 || visited[state]) {
+					continue;
+				}
+				visited[state] = true;
+				if (nfa[state].type == NfaState::SPLIT) {
+					pending.push_back(nfa[state].out);
+					pending.push_back(nfa[state].out1);
+				}
+				else {
+					closure.push_back(state);
+				}
+			}
+			std::sort(closure.begin(), closure.end());
+			return closure;
+		}
+	}
+
+	bool MovePatternSet::Add(std::string_view pattern) {
+		m_error.clear();
+		const size_t nfa_size = m_nfa.size();
+		MovePatternParser parser(pattern, &m_nfa);
+		int start = parser.Parse(static_cast<uint32_t>(m_patterns.size()));
+		if (start < 0) {
+			m_error = parser.Error();
+			m_nfa.resize(nfa_size);
+			return false;
+		}
+		for (int state : epsilon_closure(m_nfa, { start })) {
+			if (m_nfa[state].type == NfaState::MATCH) {
+				m_error = "pattern matches an empty move sequence";
+				m_nfa.resize(nfa_size);
+				return false;
+			}
+		}
+		m_patterns.emplace_back(pattern);
+		m_pattern_starts.push_back(start);
+		return true;
+	}
+
+	bool MovePatternSet::Compile() {
+		m_error.clear();
+
+		// Split the moves into classes that every MOVE state either fully accepts or fully rejects
+		std::array<uint16_t, 256> move_classes = {};
+		uint32_t class_count = 1;
+		for (const NfaState& state : m_nfa) {
+			if (state.type != NfaState::MOVE) {
+				continue;
+			}
+			std::map<std::pair<uint16_t, bool>, uint16_t> refined_classes;
+			for (size_t iMove = 0; iMove < 256; ++iMove) {
+				auto key = std::make_pair(move_classes[iMove], static_cast<bool>(state.moves[iMove]));
+				move_classes[iMove] = refined_classes.emplace(key, static_cast<uint16_t>(refined_classes.size())).first->second;
+			}
+			class_count = static_cast<uint32_t>(refined_classes.size());
+		}
+		std::vector<int> class_moves(class_count);
+		for (size_t iMove = 0; iMove < 256; ++iMove) {
+			class_moves[move_classes[iMove]] = static_cast<int>(iMove);
+		}
+
+		// Subset construction; every state also holds the patterns' starts, so a match can begin at any attack
+		const std::vector<int> start_closure = epsilon_closure(m_nfa, m_pattern_starts);
+		std::map<std::vector<int>, uint32_t> state_ids;
+		std::vector<const std::vector<int>*> states;
+		auto find_state = [&](std::vector<int> closure) {
+			auto [state_id, is_new] = state_ids.emplace(std::move(closure), static_cast<uint32_t>(states.size()));
+			if (is_new) {
+				states.push_back(&state_id->first);
+			}
+			return state_id->second;
+		};
+		find_state(start_closure);
+
+		std::vector<uint32_t> transitions;
+		std::vector<uint32_t> accept_offsets = { 0 };
+		std::vector<uint32_t> accept_patterns;
+		for (size_t iState = 0; iState < states.size(); ++iState) {
+			if (states.size() > MAX_MOVE_PATTERN_STATES) {
+				m_error = "patterns need more than " + std::to_string(MAX_MOVE_PATTERN_STATES) + " DFA states";
+				return false;
+			}
+			const std::vector<int> nfa_states = *states[iState];
+			const size_t accept_begin = accept_patterns.size();
+			for (int nfa_state : nfa_states) {
+				if (m_nfa[nfa_state].type == NfaState::MATCH) {
+					accept_patterns.push_back(m_nfa[nfa_state].pattern);
+				}
+			}
+			std::sort(accept_patterns.begin() + accept_begin, accept_patterns.end());
+			accept_patterns.erase(std::unique(accept_patterns.begin() + accept_begin, accept_patterns.end()), accept_patterns.end());
+			accept_offsets.push_back(static_cast<uint32_t>(accept_patterns.size()));
+
+			for (uint32_t iClass = 0; iClass < class_count; ++iClass) {
+				std::vector<int> next = m_pattern_starts;
+				for (int nfa_state : nfa_states) {
+					if (m_nfa[nfa_state].type == NfaState::MOVE && m_nfa[nfa_state].moves[class_moves[iClass]]) {
+						next.push_back(m_nfa[nfa_state].out);
+					}
+				}
+				transitions.push_back(find_state(epsilon_closure(m_nfa, std::move(next))));
+			}
+		}
+
+		m_move_classes = move_classes;
+		m_class_count = class_count;
+		m_start_state = 0;
+		m_transitions = std::move(transitions);
+		m_accept_offsets = std::move(accept_offsets);
+		m_accept_patterns = std::move(accept_patterns);
+		return true;
+	}
+
+	bool MovePatternSet::Matches(const ComboView& combo) const {
+		uint32_t state = m_start_state;
+		for (size_t iAttack = 0; iAttack < combo.attack_count; ++iAttack) {
+			state = m_transitions[state * m_class_count + m_move_classes[combo.attacks[iAttack].move_id]];
+			if (m_accept_offsets[state] != m_accept_offsets[state + 1]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t MovePatternSet::MatchedPatterns(const ComboView& combo, std::vector<bool>* matched) const {
+		matched->assign(PatternCount(), false);
+		size_t matched_count = 0;
+		Scan(combo, [&](size_t iPattern, size_t) {
+			if (!(*matched)[iPattern]) {
+				(*matched)[iPattern] = true;
+				++matched_count;
+			}
+		});
+		return matched_count;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "pch.h"
+
+#include "combo.h"
+
+namespace Crunch {
+	constexpr size_t MAX_MOVE_PATTERN_STATES = 1 << 16;
+
+	// Move id from a move id number or a Move::shortname (any case and without its punctuation, e.g. "uair" or "misc"), -1 if it's neither
+	int FindMoveId(std::string_view name);
+
+	// Regex-like patterns over a combo's Attack::move_id sequence, e.g. "uthrow -> uair uair -> fair":
+	//   moves       : Move::shortname, case-insensitive (uthrow, uair, fair, ...), or a move id number
+	//   .           : any move
+	//   [a b c]     : any of the listed moves; [^a b c] any move but those
+	//   ( ) | * + ? : grouping, alternation, and repetition, as in regular expressions
+	// Moves are separated by spaces, commas, "->" or "→". Each attack is one symbol, and a pattern matches
+	// wherever it occurs in the sequence (it doesn't have to span the whole combo).
+	// All the patterns of a set are compiled into a single DFA, which finds every match of every pattern in one pass
+	// over the attacks (for plain move sequences this is the Aho-Corasick automaton of the set).
+	class MovePatternSet {
+	public:
+		// Parses a pattern and adds it to the set under the next pattern index; returns false (see Error()) if it doesn't parse
+		bool Add(std::string_view pattern);
+		// Builds the DFA of every pattern added so far; returns false (see Error()) if it would exceed MAX_MOVE_PATTERN_STATES
+		bool Compile();
+		const std::string& Error() const { return m_error; }
+
+		size_t PatternCount() const { return m_patterns.size(); }
+		const std::string& Pattern(size_t iPattern) const { return m_patterns[iPattern]; }
+		size_t StateCount() const { return m_accept_offsets.empty() ? 0 : m_accept_offsets.size() - 1; }
+
+		// Calls on_match(pattern index, index of the match's last attack) for every match, in attack order
+		template<typename OnMatch>
+		void Scan(const ComboView& combo, OnMatch&& on_match) const {
+			uint32_t state = m_start_state;
+			for (size_t iAttack = 0; iAttack < combo.attack_count; ++iAttack) {
+				state = m_transitions[state * m_class_count + m_move_classes[combo.attacks[iAttack].move_id]];
+				for (uint32_t iAccept = m_accept_offsets[state]; iAccept < m_accept_offsets[state + 1]; ++iAccept) {
+					on_match(static_cast<size_t>(m_accept_patterns[iAccept]), iAttack);
+				}
+			}
+		}
+
+		// Whether any pattern occurs in the combo; stops at the first match
+		bool Matches(const ComboView& combo) const;
+		// Sets matched[i] for every pattern i that occurs in the combo (matched is resized to PatternCount()); returns how many did
+		size_t MatchedPatterns(const ComboView& combo, std::vector<bool>* matched) const;
+	private:
+		struct NfaState {
+			enum Type : uint8_t { MOVE, SPLIT, MATCH };
+			Type type = SPLIT;
+			std::bitset<256> moves; // MOVE: the move ids this state consumes
+			int out = -1;
+			int out1 = -1;          // SPLIT: second epsilon edge
+			uint32_t pattern = 0;   // MATCH: which pattern matched
+		};
+
+		std::vector<std::string> m_patterns;
+		std::vector<NfaState> m_nfa;
+		std::vector<int> m_pattern_starts;
+		std::string m_error;
+
+		// DFA: moves are first mapped to classes of moves no pattern tells apart, then each state has one transition per class
+		std::array<uint16_t, 256> m_move_classes = {};
+		uint32_t m_class_count = 1;
+		uint32_t m_start_state = 0;
+		std::vector<uint32_t> m_transitions = { 0 };
+		// Patterns that match on entering each state: state i accepts m_accept_patterns[m_accept_offsets[i] .. m_accept_offsets[i + 1])
+		std::vector<uint32_t> m_accept_offsets = { 0, 0 };
+		std::vector<uint32_t> m_accept_patterns;
+
+		friend class MovePatternParser;
+	};
+}
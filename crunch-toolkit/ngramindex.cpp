@@ -0,0 +1,380 @@
+
+#include "pch.h"
+
+#include "ngramindex.h"
+
+namespace Crunch {
+	namespace {
+		void write_varint(std::vector<uint8_t>* out, uint32_t value) {
+			while (value >= 0x80) {
+				out->push_back(static_cast<uint8_t>(value | 0x80));
+				value >>= 7;
+			}
+			out->push_back(static_cast<uint8_t>(value));
+		}
+
+		// Stops at end, so a damaged list can't be read past
+		uint32_t read_varint(const uint8_t** p, const uint8_t* end) {
+			uint32_t value = 0;
+			for (uint32_t shift = 0; *p < end && shift < 35; shift += 7) {
+				const uint8_t byte = *(*p)++;
+				value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0) {
+					break;
+				}
+			}
+			return value;
+		}
+
+		template<typename T>
+		void append_pod(std::string* out, const T* data, size_t count) {
+			out->append(reinterpret_cast<const char*>(data), count * sizeof(T));
+		}
+
+		template<typename T>
+		bool read_pod(const std::string& in, size_t* offset, T* data, size_t count) {
+			if (in.size() - *offset < count * sizeof(T)) {
+				return false;
+			}
+			if (count > 0) {
+				std::memcpy(data, in.data() + *offset, count * sizeof(T));
+			}
+			*offset += count * sizeof(T);
+			return true;
+		}
+	}
+
+	// Walks one posting list entry by entry; an entry's positions are only decoded when asked for
+	class MoveNgramIndex::Cursor {
+	public:
+		explicit Cursor(const PostingList& list) : m_list(&list), m_next(list.bytes.data()), m_end(list.bytes.data() + list.bytes.size()) {
+			Next();
+		}
+
+		bool Valid() const { return m_is_valid; }
+		uint32_t Combo() const { return m_combo; }
+		size_t EntryCount() const { return m_list->entry_count; }
+
+		const std::vector<uint32_t>& Positions() {
+			if (!m_is_decoded) {
+				const uint8_t* p = m_positions;
+				uint32_t position = 0;
+				m_decoded_positions.resize(m_position_count);
+				for (uint32_t iPosition = 0; iPosition < m_position_count; ++iPosition) {
+					position += read_varint(&p, m_end);
+					m_decoded_positions[iPosition] = position;
+				}
+				m_is_decoded = true;
+			}
+			return m_decoded_positions;
+		}
+
+		void Next() {
+			// Skip the current entry's positions, one varint per byte without the continuation bit
+			for (uint32_t iPosition = 0; iPosition < m_position_count && m_next < m_end; m_next++) {
+				iPosition += (*m_next & 0x80) == 0;
+			}
+			if (m_next >= m_end) {
+				m_is_valid = false;
+				return;
+			}
+			m_combo += read_varint(&m_next, m_end);
+			m_position_count = read_varint(&m_next, m_end);
+			m_positions = m_next;
+			m_is_decoded = false;
+		}
+
+		// Moves to the first entry at or after the combo
+		void SkipTo(uint32_t combo) {
+			if (!m_is_valid || m_combo >= combo) {
+				return;
+			}
+			const std::vector<Skip>& skips = m_list->skips;
+			auto skip = std::lower_bound(skips.begin(), skips.end(), combo, [](const Skip& s, uint32_t c) { return s.combo < c; });
+			if (skip != skips.begin()) {
+				--skip;
+				const uint8_t* skip_target = m_list->bytes.data() + skip->offset;
+				if (skip_target > m_positions) {
+					m_combo = skip->combo;
+					m_next = skip_target;
+					m_position_count = 0;
+					Next();
+				}
+			}
+			while (m_is_valid && m_combo < combo) {
+				Next();
+			}
+		}
+	private:
+		const PostingList* m_list;
+		const uint8_t* m_next;
+		const uint8_t* m_end;
+		const uint8_t* m_positions = nullptr;
+		uint32_t m_combo = 0;
+		uint32_t m_position_count = 0;
+		bool m_is_valid = true;
+		bool m_is_decoded = false;
+		std::vector<uint32_t> m_decoded_positions;
+	};
+
+	MoveNgramIndex::MoveNgramIndex(size_t ngram_size) : m_ngram_size(std::clamp<size_t>(ngram_size, 1, MAX_MOVE_NGRAM_SIZE)) {}
+
+	uint32_t MoveNgramIndex::Key(const uint8_t* moves) const {
+		uint32_t key = 0;
+		for (size_t iMove = 0; iMove < m_ngram_size; ++iMove) {
+			key = (key << 8) | moves[iMove];
+		}
+		return key;
+	}
+
+	size_t MoveNgramIndex::Add(const ComboSet& combos, const std::vector<MoveNgramReplay>& replays) {
+		std::vector<std::pair<uint32_t, uint32_t>> ngrams;
+		size_t added_count = 0;
+		for (size_t iReplay = 0; iReplay < combos.ReplayCount(); ++iReplay) {
+			MoveNgramReplay replay = iReplay < replays.size() ? replays[iReplay] : MoveNgramReplay();
+			if (replay.content_hash != 0 && !m_replay_hashes.insert(replay.content_hash).second) {
+				continue;
+			}
+			m_replays.push_back(std::move(replay));
+			m_replay_offsets.push_back(m_replay_offsets.back());
+			for (ComboView combo : combos.ReplayCombos(iReplay)) {
+				AddCombo(m_replay_offsets.back()++, combo, &ngrams);
+			}
+			added_count++;
+		}
+		return added_count;
+	}
+
+	void MoveNgramIndex::AddCombo(uint32_t combo, const ComboView& view, std::vector<std::pair<uint32_t, uint32_t>>* ngrams) {
+		if (view.attack_count < m_ngram_size) {
+			return;
+		}
+		uint8_t moves[MAX_MOVE_NGRAM_SIZE] = {};
+		ngrams->clear();
+		for (size_t iAttack = 0; iAttack + m_ngram_size <= view.attack_count; ++iAttack) {
+			for (size_t iMove = 0; iMove < m_ngram_size; ++iMove) {
+				moves[iMove] = view.attacks[iAttack + iMove].move_id;
+			}
+			ngrams->emplace_back(Key(moves), static_cast<uint32_t>(iAttack));
+		}
+		std::sort(ngrams->begin(), ngrams->end());
+
+		for (size_t iBegin = 0; iBegin < ngrams->size(); ) {
+			const uint32_t key = (*ngrams)[iBegin].first;
+			size_t iEnd = iBegin;
+			while (iEnd < ngrams->size() && (*ngrams)[iEnd].first == key) {
+				++iEnd;
+			}
+			PostingList& list = m_lists[key];
+			if (list.entry_count > 0 && list.entry_count % MOVE_NGRAM_SKIP_INTERVAL == 0) {
+				list.skips.push_back({ list.last_combo, static_cast<uint32_t>(list.bytes.size()) });
+			}
+			write_varint(&list.bytes, combo - list.last_combo);
+			write_varint(&list.bytes, static_cast<uint32_t>(iEnd - iBegin));
+			uint32_t previous_position = 0;
+			for (size_t iNgram = iBegin; iNgram < iEnd; ++iNgram) {
+				write_varint(&list.bytes, (*ngrams)[iNgram].second - previous_position);
+				previous_position = (*ngrams)[iNgram].second;
+			}
+			list.last_combo = combo;
+			list.entry_count++;
+			iBegin = iEnd;
+		}
+	}
+
+	void MoveNgramIndex::Clear() {
+		m_lists.clear();
+		m_replay_offsets.assign(1, 0);
+		m_replays.clear();
+		m_replay_hashes.clear();
+	}
+
+	size_t MoveNgramIndex::PostingBytes() const {
+		size_t byte_count = 0;
+		for (const auto& [key, list] : m_lists) {
+			byte_count += list.bytes.size() + list.skips.size() * sizeof(Skip);
+		}
+		return byte_count;
+	}
+
+	uint32_t MoveNgramIndex::ReplayOf(uint32_t combo) const {
+		auto replay_end = std::upper_bound(m_replay_offsets.begin() + 1, m_replay_offsets.end(), combo);
+		return static_cast<uint32_t>(replay_end - m_replay_offsets.begin()) - 1;
+	}
+
+	std::vector<MoveNgramIndex::Hit> MoveNgramIndex::Find(const uint8_t* moves, size_t move_count) const {
+		std::vector<Hit> hits;
+		if (move_count < m_ngram_size) {
+			return hits;
+		}
+		// n-grams that cover the whole sequence: every n-th one, plus the last
+		std::vector<uint32_t> offsets;
+		for (size_t offset = 0; offset + m_ngram_size <= move_count; offset += m_ngram_size) {
+			offsets.push_back(static_cast<uint32_t>(offset));
+		}
+		if (offsets.back() + m_ngram_size < move_count) {
+			offsets.push_back(static_cast<uint32_t>(move_count - m_ngram_size));
+		}
+		std::vector<Cursor> cursors;
+		cursors.reserve(offsets.size());
+		for (uint32_t offset : offsets) {
+			auto list = m_lists.find(Key(moves + offset));
+			if (list == m_lists.end()) {
+				return hits;
+			}
+			cursors.emplace_back(list->second);
+		}
+		// Led by the shortest list, leapfrog every cursor to the same combo, then line up the positions
+		std::vector<size_t> order(cursors.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cursors[a].EntryCount() < cursors[b].EntryCount(); });
+
+		Cursor& lead = cursors[order[0]];
+		while (lead.Valid()) {
+			uint32_t combo = lead.Combo();
+			bool is_aligned = true;
+			for (size_t iOrder = 1; iOrder < order.size() && is_aligned; ++iOrder) {
+				Cursor& cursor = cursors[order[iOrder]];
+				cursor.SkipTo(combo);
+				if (!cursor.Valid()) {
+					return hits;
+				}
+				if (cursor.Combo() != combo) {
+					lead.SkipTo(cursor.Combo());
+					is_aligned = false;
+				}
+			}
+			if (!is_aligned) {
+				continue;
+			}
+			const uint32_t replay = ReplayOf(combo);
+			for (uint32_t position : cursors[0].Positions()) {
+				bool is_match = true;
+				for (size_t iCursor = 1; iCursor < cursors.size() && is_match; ++iCursor) {
+					const std::vector<uint32_t>& positions = cursors[iCursor].Positions();
+					is_match = std::binary_search(positions.begin(), positions.end(), position + offsets[iCursor]);
+				}
+				if (is_match) {
+					hits.push_back({ replay, combo, position });
+				}
+			}
+			lead.Next();
+		}
+		return hits;
+	}
+
+	std::vector<uint32_t> MoveNgramIndex::FindCombos(const std::vector<uint8_t>& moves) const {
+		std::vector<uint32_t> combos;
+		for (const Hit& hit : Find(moves)) {
+			if (combos.empty() || combos.back() != hit.combo) {
+				combos.push_back(hit.combo);
+			}
+		}
+		return combos;
+	}
+
+	bool MoveNgramIndex::Save(const std::filesystem::path& path) const {
+		std::vector<uint32_t> keys;
+		keys.reserve(m_lists.size());
+		for (const auto& [key, list] : m_lists) {
+			keys.push_back(key);
+		}
+		std::sort(keys.begin(), keys.end());
+
+		MoveNgramFileHeader header;
+		header.ngram_size = static_cast<uint32_t>(m_ngram_size);
+		header.replay_count = static_cast<uint32_t>(ReplayCount());
+		header.combo_count = static_cast<uint32_t>(ComboCount());
+		header.list_count = static_cast<uint32_t>(keys.size());
+		std::string out;
+		append_pod(&out, &header, 1);
+		append_pod(&out, m_replay_offsets.data(), m_replay_offsets.size());
+		for (const MoveNgramReplay& replay : m_replays) {
+			const uint32_t path_length = static_cast<uint32_t>(replay.path.size());
+			append_pod(&out, &replay.content_hash, 1);
+			append_pod(&out, &replay.member, 1);
+			append_pod(&out, &path_length, 1);
+			append_pod(&out, replay.path.data(), replay.path.size());
+		}
+		for (uint32_t key : keys) {
+			const PostingList& list = m_lists.at(key);
+			MoveNgramFileList file_list;
+			file_list.key = key;
+			file_list.entry_count = list.entry_count;
+			file_list.byte_count = static_cast<uint32_t>(list.bytes.size());
+			file_list.skip_count = static_cast<uint32_t>(list.skips.size());
+			file_list.last_combo = list.last_combo;
+			append_pod(&out, &file_list, 1);
+		}
+		for (uint32_t key : keys) {
+			const PostingList& list = m_lists.at(key);
+			append_pod(&out, list.bytes.data(), list.bytes.size());
+			append_pod(&out, list.skips.data(), list.skips.size());
+		}
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(out.data(), out.size());
+		return static_cast<bool>(file);
+	}
+
+	bool MoveNgramIndex::Load(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		std::string in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		size_t offset = 0;
+		MoveNgramFileHeader header;
+		if (!read_pod(in, &offset, &header, 1) || header.magic != MOVE_NGRAM_FILE_MAGIC || header.version > MOVE_NGRAM_FILE_VERSION
+			|| header.ngram_size == 0 || header.ngram_size > MAX_MOVE_NGRAM_SIZE) {
+			return false;
+		}
+		std::vector<uint32_t> replay_offsets(size_t(header.replay_count) + 1);
+		if (!read_pod(in, &offset, replay_offsets.data(), replay_offsets.size())
+			|| replay_offsets.front() != 0 || replay_offsets.back() != header.combo_count || !std::is_sorted(replay_offsets.begin(), replay_offsets.end())) {
+			return false;
+		}
+		// Replays of version 1 indexes stay unknown: no path, and no hash to skip them by
+		std::vector<MoveNgramReplay> replays(header.replay_count);
+		for (MoveNgramReplay& replay : replays) {
+			if (header.version < 2) {
+				break;
+			}
+			uint32_t path_length = 0;
+			if (!read_pod(in, &offset, &replay.content_hash, 1) || !read_pod(in, &offset, &replay.member, 1) || !read_pod(in, &offset, &path_length, 1)
+				|| in.size() - offset < path_length) {
+				return false;
+			}
+			replay.path.assign(in, offset, path_length);
+			offset += path_length;
+		}
+		std::vector<MoveNgramFileList> file_lists(header.list_count);
+		if (!read_pod(in, &offset, file_lists.data(), file_lists.size())) {
+			return false;
+		}
+		std::unordered_map<uint32_t, PostingList> lists;
+		lists.reserve(file_lists.size());
+		for (const MoveNgramFileList& file_list : file_lists) {
+			PostingList& list = lists[file_list.key];
+			list.bytes.resize(file_list.byte_count);
+			list.skips.resize(file_list.skip_count);
+			list.entry_count = file_list.entry_count;
+			list.last_combo = file_list.last_combo;
+			if (!read_pod(in, &offset, list.bytes.data(), list.bytes.size()) || !read_pod(in, &offset, list.skips.data(), list.skips.size())) {
+				return false;
+			}
+			for (const Skip& skip : list.skips) {
+				if (skip.offset > list.bytes.size()) {
+					return false;
+				}
+			}
+		}
+		m_ngram_size = header.ngram_size;
+		m_replay_offsets = std::move(replay_offsets);
+		m_replays = std::move(replays);
+		m_replay_hashes.clear();
+		for (const MoveNgramReplay& replay : m_replays) {
+			if (replay.content_hash != 0) {
+				m_replay_hashes.insert(replay.content_hash);
+			}
+		}
+		m_lists = std::move(lists);
+		return true;
+	}
+}
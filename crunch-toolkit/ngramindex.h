@@ -0,0 +1,102 @@
+#pragma once
+
+#include "pch.h"
+
+#include "comboset.h"
+#include "corpus.h"
+
+namespace Crunch {
+	// Inverted index from move id n-grams to the combos containing them, for instant move-sequence queries over a crunched corpus.
+	// Combos are numbered in the order they're added (so an index built from a sequence of ComboSets numbers its combos like the
+	// merge of those sets, less the replays it skipped as already indexed), and every posting list holds, for each combo containing
+	// the n-gram, the attack positions it starts at:
+	//   entry : varint(combo - previous combo), varint(position count), varint(first position), varint(position - previous position)...
+	// with a skip entry every MOVE_NGRAM_SKIP_INTERVAL entries so intersections can jump ahead without decoding everything.
+	// Saved as ".slpngram" (magic "SLNG"): a header, the replay offsets, the replays (u64 content hash | u32 member | u32 path length | path),
+	// one MoveNgramFileList per n-gram, then each list's bytes and skips.
+	constexpr uint32_t MOVE_NGRAM_FILE_MAGIC = 0x474E4C53; // "SLNG"
+	constexpr uint32_t MOVE_NGRAM_FILE_VERSION = 2; // 2: replay paths and content hashes
+	constexpr const char* MOVE_NGRAM_FILE_EXTENSION = ".slpngram";
+	constexpr size_t MOVE_NGRAM_SKIP_INTERVAL = 64;
+	constexpr size_t MAX_MOVE_NGRAM_SIZE = 4;
+
+	struct MoveNgramFileHeader {
+		uint32_t magic = MOVE_NGRAM_FILE_MAGIC;
+		uint32_t version = MOVE_NGRAM_FILE_VERSION;
+		uint32_t ngram_size = 0;
+		uint32_t replay_count = 0;
+		uint32_t combo_count = 0;
+		uint32_t list_count = 0;
+	};
+
+	// Where an indexed replay came from, so hits can be traced back to it and it's never indexed twice
+	struct MoveNgramReplay {
+		std::string path;                 // the .slp file, or the .slpack holding the replay
+		uint32_t member = NO_PACK_MEMBER; // index of the replay in its pack
+		uint64_t content_hash = 0;        // Hash64 of the whole .slp, 0 if unknown (indexes written before version 2)
+	};
+
+	struct MoveNgramFileList {
+		uint32_t key = 0;
+		uint32_t entry_count = 0;
+		uint32_t byte_count = 0;
+		uint32_t skip_count = 0;
+		uint32_t last_combo = 0;
+	};
+
+	class MoveNgramIndex {
+	public:
+		struct Hit {
+			uint32_t replay;
+			uint32_t combo;    // Combo number across the whole index
+			uint32_t position; // Index of the combo's attack the sequence starts at
+		};
+
+		explicit MoveNgramIndex(size_t ngram_size = 3);
+
+		// Indexes every replay and combo of the set after those already in the index; replays, when given, describes the set's
+		// replays in order, and those whose content hash the index already holds are skipped. Returns the number of replays added
+		size_t Add(const ComboSet& combos, const std::vector<MoveNgramReplay>& replays = {});
+		void Clear();
+
+		bool Save(const std::filesystem::path& path) const;
+		bool Load(const std::filesystem::path& path);
+
+		// Every occurrence of the move sequence (at least NgramSize() moves long) in the indexed combos, by combo then position
+		std::vector<Hit> Find(const uint8_t* moves, size_t move_count) const;
+		std::vector<Hit> Find(const std::vector<uint8_t>& moves) const { return Find(moves.data(), moves.size()); }
+		// Each combo containing the sequence once, in combo order
+		std::vector<uint32_t> FindCombos(const std::vector<uint8_t>& moves) const;
+
+		size_t NgramSize() const { return m_ngram_size; }
+		size_t ReplayCount() const { return m_replay_offsets.size() - 1; }
+		const std::vector<MoveNgramReplay>& Replays() const { return m_replays; }
+		size_t ComboCount() const { return m_replay_offsets.back(); }
+		size_t NgramCount() const { return m_lists.size(); }
+		size_t PostingBytes() const;
+		uint32_t ReplayOf(uint32_t combo) const;
+	private:
+		struct Skip {
+			uint32_t combo;  // Last combo before the skip point
+			uint32_t offset; // Byte offset of the entry after it
+		};
+
+		struct PostingList {
+			std::vector<uint8_t> bytes;
+			std::vector<Skip> skips;
+			uint32_t entry_count = 0;
+			uint32_t last_combo = 0;
+		};
+
+		class Cursor;
+
+		size_t m_ngram_size;
+		std::unordered_map<uint32_t, PostingList> m_lists;
+		std::vector<uint32_t> m_replay_offsets = { 0 };
+		std::vector<MoveNgramReplay> m_replays;
+		std::unordered_set<uint64_t> m_replay_hashes;
+
+		uint32_t Key(const uint8_t* moves) const;
+		void AddCombo(uint32_t combo, const ComboView& view, std::vector<std::pair<uint32_t, uint32_t>>* ngrams);
+	};
+}
@@ -0,0 +1,468 @@
+
+#include "pch.h"
+
+#include "pack.h"
+#include "hash.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Crunch {
+	namespace {
+		constexpr size_t PLAYER_BLOCK_SIZE = 0x24;
+		constexpr size_t CONN_CODE_SIZE = 0x0A;
+		constexpr size_t APPEND_BATCH_SIZE = 256;
+
+		template<typename T>
+		void write_le(std::string* out, T value) {
+			char bytes[sizeof(T)];
+			std::memcpy(bytes, &value, sizeof(T));
+			out->append(bytes, sizeof(T));
+		}
+
+		void write_str(std::string* out, const std::string& str) {
+			write_le<uint16_t>(out, static_cast<uint16_t>(str.size()));
+			out->append(str);
+		}
+
+		// Bounds-checked little-endian reader over the index
+		struct IndexReader {
+			const char* pos;
+			const char* end;
+			bool ok = true;
+
+			template<typename T>
+			T read() {
+				T value{};
+				if (end - pos < static_cast<ptrdiff_t>(sizeof(T))) {
+					ok = false;
+					return value;
+				}
+				std::memcpy(&value, pos, sizeof(T));
+				pos += sizeof(T);
+				return value;
+			}
+
+			std::string read_str() {
+				uint16_t length = read<uint16_t>();
+				if (!ok || end - pos < length) {
+					ok = false;
+					return {};
+				}
+				std::string str(pos, length);
+				pos += length;
+				return str;
+			}
+		};
+
+		void write_entry(std::string* out, const PackEntry& entry) {
+			write_le(out, entry.offset);
+			write_le(out, entry.size);
+			write_le(out, entry.raw_size);
+			write_le(out, entry.content_hash);
+			write_le(out, static_cast<uint8_t>(entry.encoding));
+			write_le(out, entry.summary.slippi_maj);
+			write_le(out, entry.summary.slippi_min);
+			write_le(out, entry.summary.slippi_rev);
+			write_le(out, entry.summary.stage);
+			for (size_t iPort = 0; iPort < 4; ++iPort) {
+				write_le(out, entry.summary.ext_char_ids[iPort]);
+				write_le(out, entry.summary.player_types[iPort]);
+				write_str(out, entry.summary.tag_codes[iPort]);
+			}
+			write_str(out, entry.name);
+		}
+
+		PackEntry read_entry(IndexReader* reader) {
+			PackEntry entry;
+			entry.offset = reader->read<uint64_t>();
+			entry.size = reader->read<uint64_t>();
+			entry.raw_size = reader->read<uint64_t>();
+			entry.content_hash = reader->read<uint64_t>();
+			entry.encoding = static_cast<PackEncoding>(reader->read<uint8_t>());
+			entry.summary.slippi_maj = reader->read<uint8_t>();
+			entry.summary.slippi_min = reader->read<uint8_t>();
+			entry.summary.slippi_rev = reader->read<uint8_t>();
+			entry.summary.stage = reader->read<uint16_t>();
+			for (size_t iPort = 0; iPort < 4; ++iPort) {
+				entry.summary.ext_char_ids[iPort] = reader->read<uint8_t>();
+				entry.summary.player_types[iPort] = reader->read<uint8_t>();
+				entry.summary.tag_codes[iPort] = reader->read_str();
+			}
+			entry.name = reader->read_str();
+			return entry;
+		}
+
+		std::string read_file(const std::filesystem::path& path) {
+			std::ifstream file(path, std::ios::binary);
+			return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		}
+
+		// Runs the replay through a reset compressor; on failure falls back to plain LZMA
+		void encode_member(slip::Compressor* compressor, const std::string& slp, std::string* out, PackEncoding* encoding) {
+			compressor->reset();
+			char* read_buffer = new char[slp.size()];
+			std::memcpy(read_buffer, slp.data(), slp.size());
+			if (compressor->loadFromBuff(&read_buffer, static_cast<unsigned>(slp.size()))) {
+				char* write_buffer = nullptr;
+				unsigned write_size = compressor->saveToBuff(&write_buffer);
+				if (write_size > 0 && write_buffer != nullptr) {
+					out->assign(write_buffer, write_size);
+					delete[] write_buffer;
+					*encoding = PackEncoding::Compressed;
+					return;
+				}
+			}
+			*out = slip::compressWithLzma(slp.data(), slp.size());
+			*encoding = PackEncoding::Lzma;
+		}
+	}
+
+	bool SummarizeGameStart(const char* slp, size_t size, GameStartSummary* summary) {
+		slip::EventStream event_stream;
+		if (!event_stream.open(slp, static_cast<uint32_t>(size)) || !event_stream.valid() || event_stream.code() != Event::GAME_START) {
+			return false;
+		}
+		const char* game_start = event_stream.data();
+		size_t game_start_size = event_stream.eventSize();
+		summary->slippi_maj = static_cast<uint8_t>(game_start[slip::O_SLP_MAJ]);
+		summary->slippi_min = static_cast<uint8_t>(game_start[slip::O_SLP_MIN]);
+		summary->slippi_rev = static_cast<uint8_t>(game_start[slip::O_SLP_REV]);
+		summary->stage = slip::readBE2U(const_cast<char*>(&game_start[slip::O_STAGE]));
+		for (size_t iPort = 0; iPort < 4; ++iPort) {
+			const char* player_block = &game_start[slip::O_PLAYERDATA + PLAYER_BLOCK_SIZE * iPort];
+			summary->ext_char_ids[iPort] = static_cast<uint8_t>(player_block[slip::O_PLAYER_ID]);
+			summary->player_types[iPort] = static_cast<uint8_t>(player_block[slip::O_PLAYER_TYPE]);
+			size_t code_offset = slip::O_CONN_CODE + CONN_CODE_SIZE * iPort;
+			if (code_offset + CONN_CODE_SIZE <= game_start_size) {
+				std::string code(&game_start[code_offset], CONN_CODE_SIZE);
+				code.erase(std::find(code.begin(), code.end(), '\0'), code.end());
+				summary->tag_codes[iPort] = slip::parseConnCode(code);
+			}
+		}
+		return true;
+	}
+
+	MappedFile::~MappedFile() {
+		Close();
+	}
+
+	bool MappedFile::Open(const std::filesystem::path& path) {
+		Close();
+#ifdef _WIN32
+		HANDLE file_handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file_handle == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) {
+			CloseHandle(file_handle);
+			return false;
+		}
+		HANDLE mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_handle == nullptr) {
+			CloseHandle(file_handle);
+			return false;
+		}
+		void* data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+		if (data == nullptr) {
+			CloseHandle(mapping_handle);
+			CloseHandle(file_handle);
+			return false;
+		}
+		m_file_handle = file_handle;
+		m_mapping_handle = mapping_handle;
+		m_data = static_cast<const char*>(data);
+		m_size = static_cast<size_t>(file_size.QuadPart);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		off_t file_size = lseek(fd, 0, SEEK_END);
+		if (file_size <= 0) {
+			close(fd);
+			return false;
+		}
+		void* data = mmap(nullptr, static_cast<size_t>(file_size), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd); // the mapping keeps its own reference to the file
+		if (data == MAP_FAILED) {
+			return false;
+		}
+		m_data = static_cast<const char*>(data);
+		m_size = static_cast<size_t>(file_size);
+#endif
+		return true;
+	}
+
+	void MappedFile::Close() {
+#ifdef _WIN32
+		if (m_data != nullptr) {
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mapping_handle != nullptr) {
+			CloseHandle(m_mapping_handle);
+		}
+		if (m_file_handle != nullptr) {
+			CloseHandle(m_file_handle);
+		}
+		m_file_handle = nullptr;
+		m_mapping_handle = nullptr;
+#else
+		if (m_data != nullptr) {
+			munmap(const_cast<char*>(m_data), m_size);
+		}
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	bool ReplayPack::Create(const std::filesystem::path& path) {
+		std::string header;
+		write_le(&header, PACK_MAGIC);
+		write_le(&header, PACK_VERSION);
+		write_le<uint64_t>(&header, PACK_HEADER_SIZE); // empty index right after the header
+		write_le<uint64_t>(&header, 0);
+		write_le<uint64_t>(&header, 0);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(header.data(), header.size());
+		return file.good();
+	}
+
+	bool ReplayPack::IsPack(const std::filesystem::path& path) {
+		if (!std::filesystem::is_regular_file(path) || path.extension() != PACK_EXTENSION) {
+			return false;
+		}
+		std::ifstream file(path, std::ios::binary);
+		uint32_t magic = 0;
+		file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		return file.good() && magic == PACK_MAGIC;
+	}
+
+	bool ReplayPack::Open(const std::filesystem::path& path) {
+		Close();
+		m_path = path;
+		if (!m_file.Open(path)) {
+			return false;
+		}
+		if (!ReadIndex()) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void ReplayPack::Close() {
+		m_file.Close();
+		m_entries.clear();
+		m_hashes.clear();
+	}
+
+	bool ReplayPack::ReadIndex() {
+		IndexReader header_reader{ m_file.Data(), m_file.Data() + m_file.Size() };
+		uint32_t magic = header_reader.read<uint32_t>();
+		uint32_t version = header_reader.read<uint32_t>();
+		uint64_t index_offset = header_reader.read<uint64_t>();
+		uint64_t index_size = header_reader.read<uint64_t>();
+		uint64_t member_count = header_reader.read<uint64_t>();
+		if (!header_reader.ok || magic != PACK_MAGIC) {
+			std::cout << m_path << " is not a replay pack" << std::endl;
+			return false;
+		}
+		if (version > PACK_VERSION) {
+			std::cout << m_path << " has pack version " << version << ", newer than supported version " << PACK_VERSION << std::endl;
+			return false;
+		}
+		if (index_offset > m_file.Size() || index_size > m_file.Size() - index_offset) {
+			std::cout << m_path << " has a truncated index" << std::endl;
+			return false;
+		}
+
+		IndexReader reader{ m_file.Data() + index_offset, m_file.Data() + index_offset + index_size };
+		m_entries.reserve(static_cast<size_t>(member_count));
+		for (uint64_t iMember = 0; iMember < member_count && reader.ok; ++iMember) {
+			PackEntry entry = read_entry(&reader);
+			if (reader.ok && entry.offset <= m_file.Size() && entry.size <= m_file.Size() - entry.offset) {
+				m_hashes.insert(entry.content_hash);
+				m_entries.push_back(std::move(entry));
+			}
+			else {
+				reader.ok = false;
+			}
+		}
+		if (!reader.ok) {
+			std::cout << m_path << " has a corrupt index entry at member " << m_entries.size() << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	std::pair<const char*, size_t> ReplayPack::MemberView(size_t index) const {
+		const PackEntry& entry = m_entries.at(index);
+		return { m_file.Data() + entry.offset, static_cast<size_t>(entry.size) };
+	}
+
+	std::unique_ptr<slip::Parser> ReplayPack::LoadMember(size_t index, int debug_level) const {
+		auto [data, size] = MemberView(index);
+		const PackEntry& entry = m_entries[index];
+
+		// The parser takes ownership of (and may modify) its buffer, so hand it a copy of the mapped bytes
+		char* buffer = nullptr;
+		size_t buffer_size = 0;
+		if (entry.encoding == PackEncoding::Lzma) {
+			std::string raw = slip::decompressWithLzma(data, size);
+			buffer_size = raw.size();
+			buffer = new char[buffer_size];
+			std::memcpy(buffer, raw.data(), buffer_size);
+		}
+		else {
+			buffer_size = size;
+			buffer = new char[buffer_size];
+			std::memcpy(buffer, data, buffer_size);
+		}
+
+		std::unique_ptr<slip::Parser> parser = std::make_unique<slip::Parser>(debug_level);
+		if (!parser->loadFromBuff(buffer, static_cast<unsigned>(buffer_size))) {
+			return nullptr;
+		}
+		return parser;
+	}
+
+	size_t ReplayPack::AppendDirectory(const std::filesystem::path& dir, size_t thread_count) {
+		std::vector<std::filesystem::path> replay_paths;
+		for (const auto& file_entry : std::filesystem::recursive_directory_iterator(dir)) {
+			if (file_entry.is_regular_file() && file_entry.path().extension() == ".slp") {
+				replay_paths.push_back(file_entry.path());
+			}
+		}
+		std::sort(replay_paths.begin(), replay_paths.end());
+		return Append(replay_paths, dir, thread_count);
+	}
+
+	size_t ReplayPack::Append(const std::vector<std::filesystem::path>& replay_paths, const std::filesystem::path& base_dir, size_t thread_count) {
+		if (!std::filesystem::exists(m_path) && !Create(m_path)) {
+			return 0;
+		}
+		if (m_file.Data() == nullptr && !Open(m_path)) {
+			return 0;
+		}
+		if (thread_count == 0) {
+			thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		}
+
+		// New data goes after everything currently in the file, old index included
+		uint64_t write_offset = m_file.Size();
+		std::vector<PackEntry> entries = m_entries;
+		std::unordered_set<uint64_t> hashes = m_hashes;
+		m_file.Close(); // can't keep the file mapped while growing it on every platform
+
+		std::fstream file(m_path, std::ios::binary | std::ios::in | std::ios::out);
+		if (!file) {
+			Open(m_path);
+			return 0;
+		}
+		file.seekp(static_cast<std::streamoff>(write_offset));
+
+		// Encode in batches on worker threads (one reusable compressor per worker), write in order on this thread
+		size_t added_count = 0;
+		for (size_t batch_begin = 0; batch_begin < replay_paths.size(); batch_begin += APPEND_BATCH_SIZE) {
+			size_t batch_size = std::min(APPEND_BATCH_SIZE, replay_paths.size() - batch_begin);
+			std::vector<PackEntry> batch_entries(batch_size);
+			std::vector<std::string> batch_data(batch_size);
+			std::vector<uint8_t> batch_valid(batch_size, false); // not vector<bool>: workers set neighbouring elements concurrently
+			std::vector<uint8_t> batch_packed(batch_size, false);
+			std::atomic_size_t next_index = 0;
+			auto worker_func = [&]() {
+				std::unique_ptr<slip::Compressor> compressor = std::make_unique<slip::Compressor>(0);
+				for (size_t iBatch = next_index++; iBatch < batch_size; iBatch = next_index++) {
+					const std::filesystem::path& replay_path = replay_paths[batch_begin + iBatch];
+					std::string slp = read_file(replay_path);
+					PackEntry& entry = batch_entries[iBatch];
+					if (!SummarizeGameStart(slp.data(), slp.size(), &entry.summary)) {
+						continue;
+					}
+					entry.raw_size = slp.size();
+					entry.content_hash = Hash64(slp.data(), slp.size());
+					if (hashes.count(entry.content_hash) != 0) {
+						batch_packed[iBatch] = true; // already packed, so don't spend an encode on it (hashes only changes between batches)
+						continue;
+					}
+					entry.name = std::filesystem::relative(replay_path, base_dir).generic_string();
+					encode_member(compressor.get(), slp, &batch_data[iBatch], &entry.encoding);
+					batch_valid[iBatch] = true;
+				}
+			};
+			std::vector<std::thread> threads;
+			for (size_t iThread = 1; iThread < std::min(thread_count, batch_size); ++iThread) {
+				threads.emplace_back(worker_func);
+			}
+			worker_func();
+			for (auto& thread : threads) {
+				thread.join();
+			}
+
+			for (size_t iBatch = 0; iBatch < batch_size; ++iBatch) {
+				PackEntry& entry = batch_entries[iBatch];
+				if (batch_packed[iBatch]) {
+					continue;
+				}
+				if (!batch_valid[iBatch]) {
+					std::cout << "Skipping " << replay_paths[batch_begin + iBatch] << ", not a valid replay" << std::endl;
+					continue;
+				}
+				if (!hashes.insert(entry.content_hash).second) {
+					continue; // a duplicate within this batch
+				}
+				entry.offset = write_offset;
+				entry.size = batch_data[iBatch].size();
+				file.write(batch_data[iBatch].data(), batch_data[iBatch].size());
+				if (!file) {
+					break;
+				}
+				write_offset += entry.size;
+				entries.push_back(std::move(entry));
+				added_count++;
+			}
+			if (!file) {
+				break;
+			}
+		}
+
+		// Write the new index, then point the header at it; if anything failed to write, the header is left pointing
+		// at the old index (which appending never overwrites), so the pack stays as it was before the append
+		std::string index;
+		for (const auto& entry : entries) {
+			write_entry(&index, entry);
+		}
+		file.write(index.data(), index.size());
+		file.flush();
+		if (!file) {
+			std::cout << "Failed to write to " << m_path << ", the pack is left unchanged" << std::endl;
+			file.close();
+			Open(m_path);
+			return 0;
+		}
+		std::string header;
+		write_le(&header, PACK_MAGIC);
+		write_le(&header, PACK_VERSION);
+		write_le<uint64_t>(&header, write_offset);
+		write_le<uint64_t>(&header, index.size());
+		write_le<uint64_t>(&header, entries.size());
+		file.seekp(0);
+		file.write(header.data(), header.size());
+		file.close();
+		if (!file) {
+			std::cout << "Failed to write the header of " << m_path << std::endl;
+			Open(m_path);
+			return 0;
+		}
+
+		Open(m_path);
+		return added_count;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Crunch {
+	// Replay pack (.slpack) layout, all integers little-endian:
+	//   header   : magic "SLPK" | u32 version | u64 index offset | u64 index size | u64 member count
+	//   members  : encoded replays, back to back
+	//   index    : one variable-length PackEntry record per member (see pack.cpp)
+	// Appending writes the new members and a fresh index after the current end of the file and only then
+	// rewrites the header, so a pack stays readable if an append is interrupted.
+	constexpr uint32_t PACK_MAGIC = 0x4B504C53; // "SLPK"
+	constexpr uint32_t PACK_VERSION = 1;
+	constexpr size_t PACK_HEADER_SIZE = 32;
+	constexpr const char* PACK_EXTENSION = ".slpack";
+
+	enum class PackEncoding : uint8_t {
+		Raw = 0,        // plain .slp bytes
+		Lzma = 1,       // LZMA-compressed .slp bytes (fallback when the compressor can't encode a replay)
+		Compressed = 2, // slippc Compressor output (.zlp bytes)
+	};
+
+	// Small summary of a replay's game start block, enough to filter members without decoding them
+	struct GameStartSummary {
+		uint8_t slippi_maj = 0;
+		uint8_t slippi_min = 0;
+		uint8_t slippi_rev = 0;
+		uint16_t stage = 0;
+		std::array<uint8_t, 4> ext_char_ids = {};
+		std::array<uint8_t, 4> player_types = { 3, 3, 3, 3 };
+		std::array<std::string, 4> tag_codes;
+	};
+
+	struct PackEntry {
+		uint64_t offset = 0;       // offset of the member's data in the pack
+		uint64_t size = 0;         // size of the member's data in the pack
+		uint64_t raw_size = 0;     // size of the original .slp file
+		uint64_t content_hash = 0; // Hash64 of the original .slp file
+		PackEncoding encoding = PackEncoding::Raw;
+		std::string name;          // original file name, relative to the directory it was added from
+		GameStartSummary summary;
+	};
+
+	// Read-only memory mapping of a whole file
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		bool Open(const std::filesystem::path& path);
+		void Close();
+		const char* Data() const { return m_data; }
+		size_t Size() const { return m_size; }
+	private:
+		const char* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file_handle = nullptr;
+		void* m_mapping_handle = nullptr;
+#endif
+	};
+
+	class ReplayPack {
+	public:
+		// Creates an empty pack, overwriting whatever is at path
+		static bool Create(const std::filesystem::path& path);
+		static bool IsPack(const std::filesystem::path& path);
+
+		bool Open(const std::filesystem::path& path);
+		void Close();
+
+		// Encodes and appends replays, skipping any whose content hash is already in the pack; returns the number added
+		size_t Append(const std::vector<std::filesystem::path>& replay_paths, const std::filesystem::path& base_dir, size_t thread_count = 0);
+		size_t AppendDirectory(const std::filesystem::path& dir, size_t thread_count = 0);
+
+		const std::vector<PackEntry>& Entries() const { return m_entries; }
+		bool Contains(uint64_t content_hash) const { return m_hashes.count(content_hash) != 0; }
+
+		// Zero-copy view of a member's stored bytes inside the mapping
+		std::pair<const char*, size_t> MemberView(size_t index) const;
+		// Decodes a member into a freshly loaded parser, nullptr on failure
+		std::unique_ptr<slip::Parser> LoadMember(size_t index, int debug_level = 0) const;
+	private:
+		std::filesystem::path m_path;
+		MappedFile m_file;
+		std::vector<PackEntry> m_entries;
+		std::unordered_set<uint64_t> m_hashes;
+
+		bool ReadIndex();
+	};
+
+	bool SummarizeGameStart(const char* slp, size_t size, GameStartSummary* summary);
+}
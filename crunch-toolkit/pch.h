@@ -21,19 +21,45 @@
 #include <filesystem>
 #include <queue>
 #include <optional>
+#include <array>
+#include <bitset>
+#include <tuple>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+#include <unordered_map>
+#include <map>
+#include <set>
+#include <charconv>
+#include <numeric>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <random>
 
 //slippc
 #include "analysis.h"
 #include "analyzer.h"
+#include "chunked.h"
 #include "compressor.h"
 #include "enums.h"
+#include "eventindex.h"
+#include "eventstream.h"
+#include "framedecode.h"
+#include "frameloop.h"
 #include "gecko-legacy.h"
+#include "jsonwriter.h"
+#include "liveparser.h"
 #include "lzma.h"
 #include "parser.h"
 #include "portable-file-dialogs.h"
 #include "replay.h"
 #include "schema.h"
 #include "shiftjis.h"
+#include "shuffle.h"
+#include "simd.h"
 #include "util.h"
+#include "visitor.h"
 
 #endif //PCH_H
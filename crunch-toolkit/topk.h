@@ -0,0 +1,89 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Crunch {
+	// Bounded top-K selection that can be split across workers, e.g. as a CrunchReduce accumulator:
+	//   TopK<T> top(k) makes an empty selection; every copy of it is a worker-local min-heap of at most k entries
+	//   that shares one threshold with the original, so a worker can discard a candidate that another worker
+	//   has already proven can't make the top k. Merging the workers' heaps gives the global top k.
+	// Memory is O(k) per copy whatever the number of candidates. Key must be trivially copyable (an atomic is kept).
+	template<typename T, typename Key = int>
+	class TopK {
+	public:
+		struct Entry {
+			Key key;
+			T item;
+		};
+
+		explicit TopK(size_t k = 0) : m_k(k), m_threshold(std::make_shared<std::atomic<Key>>(std::numeric_limits<Key>::lowest())) {
+			m_heap.reserve(k);
+		}
+
+		size_t Capacity() const { return m_k; }
+		size_t Size() const { return m_heap.size(); }
+		bool Empty() const { return m_heap.empty(); }
+
+		// Whether a candidate with this key could still be kept; cheap enough to call before building the item
+		bool Accepts(Key key) const {
+			if (m_k == 0 || key < m_threshold->load(std::memory_order_relaxed)) {
+				return false;
+			}
+			return m_heap.size() < m_k || m_heap.front().key < key;
+		}
+
+		// Keeps make_item() under this key if it's among the k best seen; make_item is only called when it is
+		template<typename MakeItem>
+		bool Offer(Key key, MakeItem&& make_item) {
+			if (!Accepts(key)) {
+				return false;
+			}
+			if (m_heap.size() == m_k) {
+				std::pop_heap(m_heap.begin(), m_heap.end(), &TopK::is_worse_first);
+				m_heap.back().key = key;
+				m_heap.back().item = std::invoke(std::forward<MakeItem>(make_item));
+			}
+			else {
+				m_heap.push_back({ key, std::invoke(std::forward<MakeItem>(make_item)) });
+			}
+			std::push_heap(m_heap.begin(), m_heap.end(), &TopK::is_worse_first);
+			if (m_heap.size() == m_k) {
+				raise_threshold(m_heap.front().key);
+			}
+			return true;
+		}
+		bool Push(Key key, T item) {
+			return Offer(key, [&item]() { return std::move(item); });
+		}
+
+		// Offers every entry of another selection, leaving it empty
+		void Merge(TopK&& other) {
+			for (Entry& entry : other.m_heap) {
+				Offer(entry.key, [&entry]() { return std::move(entry.item); });
+			}
+			other.m_heap.clear();
+		}
+
+		// Takes the kept entries, best first
+		std::vector<Entry> TakeSorted() {
+			std::sort_heap(m_heap.begin(), m_heap.end(), &TopK::is_worse_first);
+			return std::move(m_heap);
+		}
+	private:
+		size_t m_k;
+		std::vector<Entry> m_heap;
+		// Lower bound on the final k-th key: the smallest key of any copy whose heap is full
+		std::shared_ptr<std::atomic<Key>> m_threshold;
+
+		static bool is_worse_first(const Entry& a, const Entry& b) {
+			return b.key < a.key;
+		}
+
+		// Only called when a full heap's minimum rises, so the shared line is rarely written
+		void raise_threshold(Key key) {
+			Key current = m_threshold->load(std::memory_order_relaxed);
+			while (current < key && !m_threshold->compare_exchange_weak(current, key, std::memory_order_relaxed)) {
+			}
+		}
+	};
+}
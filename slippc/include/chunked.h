@@ -0,0 +1,746 @@
+#ifndef CHUNKED_H_
+#define CHUNKED_H_
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+#include "util.h"
+#include "enums.h"
+#include "schema.h"
+#include "compressor.h"
+#include "eventstream.h"
+#include "shuffle.h"
+
+// Chunked encoding: the replay's events are split into windows of N frames and each window is run
+//   through its own (reset) Compressor as a self-contained mini replay, so predictor state never crosses
+//   a chunk boundary. Chunks can therefore be encoded and decoded independently, in parallel, and a frame
+//   window can be decoded without touching the rest of the file.
+//
+// Predicted chunks (CHUNK_FLAG_PREDICTED) skip the Compressor: pre-frame and post-frame payloads are pulled
+//   out of the event stream, each field is replaced by its residual against a predictor picked per field on
+//   the first chunk (recorded in the predictor table), and the fields are stored column by column under LZMA.
+//
+// Layout (all integers big-endian):
+//   0x00  magic "SLPC"
+//   0x04  format version (1 byte) + 3 reserved bytes
+//   0x08  frames per chunk
+//   0x0C  number of chunks
+//   0x10  raw event length of the original replay
+//   0x14  prelude length (event payloads + game start, repeated at the start of every chunk after the first)
+//   0x18  chunk index, CHUNK_ENTRY_SIZE bytes per chunk:
+//           +0x00 offset of the chunk's data in the file
+//           +0x04 size of the chunk's data
+//           +0x08 lowest frame number of any frame event in the chunk
+//           +0x0C highest frame number of any frame event in the chunk
+//           +0x10 flags (CHUNK_FLAG_*)
+//   ...   predictor table (version 2+), for pre-frame then post-frame payloads:
+//           +0x00 number of columns (1 byte)
+//           +0x01 per column: width (2 bytes) + predictor (1 byte, Pred::*)
+//   ...   chunk data
+
+const uint32_t    CHUNKED_HEADER        = BYTE4(0x53,0x4c,0x50,0x43); // SLPC
+const uint8_t     CHUNKED_VERSION       = 2;   //Internal version of the chunked container
+const unsigned    CHUNKED_HEADER_SIZE   = 0x18;
+const unsigned    CHUNK_ENTRY_SIZE      = 0x14;
+const uint32_t    CHUNK_FLAG_LZMA       = 0x01; //Chunk data was LZMA-compressed by us on top of the Compressor output
+const uint32_t    CHUNK_FLAG_PREDICTED  = 0x02; //Chunk data was encoded with the predictor table instead of the Compressor
+const unsigned    DEFAULT_CHUNK_FRAMES  = 600;  //10 seconds of gameplay per chunk
+
+//Metadata block for mini replays that don't carry the original one
+const std::string EMPTY_SLP_METADATA    = std::string("U\x08metadata{}}",13);
+
+namespace slip {
+
+//Index entry for a single chunk
+struct ChunkInfo {
+  uint32_t offset    = 0;  //Offset of the chunk's data in the chunked file
+  uint32_t size      = 0;  //Size of the chunk's data
+  int32_t  min_frame = 0;  //Lowest frame number in the chunk
+  int32_t  max_frame = 0;  //Highest frame number in the chunk (rollbacks can make chunks overlap)
+  uint32_t flags     = 0;  //CHUNK_FLAG_* bits
+};
+
+//Predictors a predicted chunk can use for a frame event field
+namespace Pred {
+  enum : uint8_t {
+    RAW   = 0,  //Store the value as-is
+    XOR   = 1,  //XOR with the previous value
+    VELOC = 2,  //Linear extrapolation from the previous two values
+    ACCEL = 3,  //Quadratic extrapolation from the previous three values
+    JOLT  = 4,  //Cubic extrapolation from the previous four values
+    COUNT = 5
+  };
+}
+
+const unsigned PRED_HISTORY = 4;  //Previous values kept per field
+const unsigned PRED_SLOTS   = 8;  //Separate histories for every (port, follower) pair
+
+//Column layout of a frame event's payload (without its command byte) and the predictor for each column
+struct PredictedFields {
+  std::vector<uint16_t> widths;    //Width of each column in bytes
+  std::vector<uint8_t>  preds;     //Pred:: value for each column
+  uint32_t              size = 0;  //Payload size (sum of widths)
+
+  //Lay out columns from a CW_* width table, cut down to the payload size this replay actually uses
+  inline void layout(const int32_t* cw, uint32_t payload_size) {
+    widths.clear();
+    size          = payload_size;
+    uint32_t left = payload_size;
+    for (unsigned c = 1; cw[c] > 0 && left > 0; ++c) {  //Column 0 is the command byte
+      uint16_t w = uint16_t(std::min<uint32_t>(uint32_t(cw[c]),left));
+      widths.push_back(w);
+      left -= w;
+    }
+    if (left > 0) {  //Fields newer than the width table
+      widths.push_back(uint16_t(left));
+    }
+    preds.assign(widths.size(),Pred::RAW);
+  }
+
+  //Whether the column at payload offset off may use a predictor other than RAW
+  //  -> the port and follower bytes pick the history slot, so they must be readable before un-predicting
+  inline bool predictable(size_t c, uint32_t off) const {
+    uint32_t w = widths[c];
+    if (w != 1 && w != 2 && w != 4) {
+      return false;
+    }
+    return !(off <= O_PLAYER-1 && O_PLAYER-1 < off+w) && !(off <= O_FOLLOWER-1 && O_FOLLOWER-1 < off+w);
+  }
+};
+
+//Read a big-endian field of 1, 2, or 4 bytes
+inline uint32_t readField(const char* p, unsigned w) {
+  uint32_t v = 0;
+  for (unsigned b = 0; b < w; ++b) {
+    v = (v << 8) | uint8_t(p[b]);
+  }
+  return v;
+}
+
+//Write the low w bytes of a value as a big-endian field
+inline void writeField(uint32_t v, char* p, unsigned w) {
+  for (unsigned b = w; b-- > 0; v >>= 8) {
+    p[b] = char(v & 0xff);
+  }
+}
+
+//Value a predictor expects for a field given its previous values (h[0] is the most recent)
+inline uint32_t predictField(uint8_t pred, const uint32_t* h) {
+  switch (pred) {
+    case Pred::XOR:   return h[0];
+    case Pred::VELOC: return 2*h[0] - h[1];
+    case Pred::ACCEL: return 3*h[0] - 3*h[1] + h[2];
+    case Pred::JOLT:  return 4*h[0] - 6*h[1] + 4*h[2] - h[3];
+    default:          return 0;
+  }
+}
+
+class ChunkedCompressor {
+private:
+  int                    _debug;           //Current debug level
+  unsigned               _chunk_frames;    //Number of frames per chunk when encoding
+  unsigned               _threads;         //Number of worker threads (0 = one per core)
+  const char*            _buf     = nullptr; //Loaded chunked file
+  uint32_t               _size    = 0;     //Size of the loaded chunked file
+  uint32_t               _raw_len = 0;     //Raw event length of the original replay
+  uint32_t               _prelude = 0;     //Length of the prelude repeated in each chunk
+  std::vector<ChunkInfo> _chunks;          //Chunk index of the loaded file
+  bool                   _predicted;       //Whether to encode chunks with the predictor table instead of the Compressor
+  PredictedFields        _pre_fields;      //Pre-frame payload columns and predictors
+  PredictedFields        _post_fields;     //Post-frame payload columns and predictors
+
+  //Run a buffer through a reset Compressor: raw replays come back encoded, encoded replays come back raw
+  //  -> loadFromBuff() takes ownership of the read buffer, saveToBuff() hands us ownership of the write buffer
+  static inline bool _transcode(Compressor* c, const std::string &in, std::string* out) {
+    c->reset();
+    char* rb = new char[in.size()];
+    memcpy(rb,in.data(),in.size());
+    if (!c->loadFromBuff(&rb,unsigned(in.size()))) {
+      return false;
+    }
+    char* wb       = nullptr;
+    unsigned wsize = c->saveToBuff(&wb);
+    if (wsize == 0 || wb == nullptr) {
+      return false;
+    }
+    out->assign(wb,wsize);
+    delete[] wb;
+    return true;
+  }
+
+  //Wrap raw events in a replay header and metadata block
+  static inline std::string _wrapRaw(const std::string &raw, const std::string &tail) {
+    std::string slp(N_HEADER_BYTES,'\0');
+    memcpy(&slp[0],"{U\x03raw[$U#l",11);
+    writeBE4U(uint32_t(raw.size()),&slp[11]);
+    slp += raw;
+    slp += tail;
+    return slp;
+  }
+
+  //Run f(chunk_index, compressor) over [0,n) on a pool of workers, each with its own reusable Compressor
+  template<typename F>
+  inline bool _forEachChunk(size_t n, F f) const {
+    unsigned nthreads = _threads ? _threads : std::max(std::thread::hardware_concurrency(),1u);
+    nthreads          = unsigned(std::min<size_t>(nthreads,std::max<size_t>(n,1)));
+    std::atomic<size_t> next(0);
+    std::atomic<bool>   failed(false);
+    auto worker = [&]() {
+      std::unique_ptr<Compressor> c = std::make_unique<Compressor>(_debug);
+      for (size_t i = next++; i < n && !failed; i = next++) {
+        if (!f(i,c.get())) {
+          failed = true;
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < nthreads; ++t) {
+      workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& w : workers) {
+      w.join();
+    }
+    return !failed;
+  }
+
+  //History slot of a frame event payload
+  static inline unsigned _predSlot(const char* payload, uint32_t size) {
+    if (size < O_FOLLOWER) {
+      return 0;
+    }
+    return (uint8_t(payload[O_PLAYER-1]) & 0x03)*2 + (uint8_t(payload[O_FOLLOWER-1]) & 0x01);
+  }
+
+  //Replace n payload rows by their residuals, or (unpredict) turn residual rows back into payloads
+  static inline void _predictRows(const PredictedFields &f, const char* in, char* out, uint32_t n, bool unpredict) {
+    size_t ncols = f.widths.size();
+    std::vector<uint32_t> hist(PRED_SLOTS*ncols*PRED_HISTORY,0);
+    for (uint32_t r = 0; r < n; ++r) {
+      const char* src = &in[size_t(r)*f.size];
+      char*       dst = &out[size_t(r)*f.size];
+      uint32_t*   h   = &hist[_predSlot(src,f.size)*ncols*PRED_HISTORY];
+      uint32_t    off = 0;
+      for (size_t c = 0; c < ncols; off += f.widths[c], ++c, h += PRED_HISTORY) {
+        unsigned w = f.widths[c];
+        if (f.preds[c] == Pred::RAW) {
+          memcpy(&dst[off],&src[off],w);
+          continue;
+        }
+        uint32_t mask = (w == 4) ? 0xffffffff : ((1u << (8*w)) - 1);
+        uint32_t p    = predictField(f.preds[c],h);
+        uint32_t x    = readField(&src[off],w);
+        uint32_t y    = (f.preds[c] == Pred::XOR) ? (x ^ p) : unpredict ? (x + p) : (x - p);
+        writeField(y,&dst[off],w);
+        memmove(&h[1],&h[0],(PRED_HISTORY-1)*sizeof(uint32_t));
+        h[0] = (unpredict ? y : x) & mask;
+      }
+    }
+  }
+
+  //Pick the predictor for each column that leaves the fewest nonzero residual bytes over n payload rows
+  static inline void _choosePredictors(PredictedFields* f, const char* rows, uint32_t n) {
+    size_t ncols = f->widths.size();
+    std::vector<uint64_t> cost(ncols*Pred::COUNT,0);
+    std::vector<uint32_t> hist(PRED_SLOTS*ncols*PRED_HISTORY,0);
+    char res[4];
+    for (uint32_t r = 0; r < n; ++r) {
+      const char* src = &rows[size_t(r)*f->size];
+      uint32_t*   h   = &hist[_predSlot(src,f->size)*ncols*PRED_HISTORY];
+      uint32_t    off = 0;
+      for (size_t c = 0; c < ncols; off += f->widths[c], ++c, h += PRED_HISTORY) {
+        if (!f->predictable(c,off)) {
+          continue;
+        }
+        unsigned w = f->widths[c];
+        uint32_t x = readField(&src[off],w);
+        for (uint8_t pred = 0; pred < Pred::COUNT; ++pred) {
+          uint32_t p = predictField(pred,h);
+          writeField((pred == Pred::XOR) ? (x ^ p) : (x - p),res,w);
+          for (unsigned b = 0; b < w; ++b) {
+            cost[c*Pred::COUNT+pred] += (res[b] != 0);
+          }
+        }
+        memmove(&h[1],&h[0],(PRED_HISTORY-1)*sizeof(uint32_t));
+        h[0] = x;
+      }
+    }
+    for (size_t c = 0; c < ncols; ++c) {
+      uint8_t best = Pred::RAW;
+      for (uint8_t pred = 1; pred < Pred::COUNT; ++pred) {
+        if (cost[c*Pred::COUNT+pred] < cost[c*Pred::COUNT+best]) {
+          best = pred;
+        }
+      }
+      f->preds[c] = best;
+    }
+  }
+
+  //Transpose n payload rows into columns (or back), so each field's bytes sit together for LZMA
+  static inline void _transposeFields(const PredictedFields &f, const char* in, char* out, uint32_t n, bool inverse) {
+    std::vector<int> col_widths(f.widths.begin(),f.widths.end());
+    col_widths.push_back(0);
+    transposeColumns(out,in,n,col_widths.data(),inverse);
+  }
+
+  //Predict and transpose n payload rows
+  static inline std::string _packRows(const PredictedFields &f, const std::string &rows, uint32_t n) {
+    std::string res(rows.size(),'\0');
+    std::string cols(rows.size(),'\0');
+    if (!rows.empty()) {
+      _predictRows(f,rows.data(),&res[0],n,false);
+      _transposeFields(f,res.data(),&cols[0],n,false);
+    }
+    return cols;
+  }
+
+  //Untranspose and unpredict n payload rows
+  static inline std::string _unpackRows(const PredictedFields &f, const char* cols, uint32_t n) {
+    std::string res(size_t(n)*f.size,'\0');
+    std::string rows(size_t(n)*f.size,'\0');
+    if (!rows.empty()) {
+      _transposeFields(f,cols,&res[0],n,true);
+      _predictRows(f,res.data(),&rows[0],n,true);
+    }
+    return rows;
+  }
+
+  //Split a mini replay's events into the main stream (every event, with pre-frame and post-frame events
+  //  cut down to their command byte) and the rows of pre-frame and post-frame payloads
+  static inline bool _splitEvents(const std::string &mini, std::string* main, std::string* pre, std::string* post) {
+    EventStream es;
+    if (!es.open(mini.data(),uint32_t(mini.size()))) {
+      return false;
+    }
+    main->assign(&mini[N_HEADER_BYTES],es.firstEvent()-N_HEADER_BYTES);
+    for (; es.valid(); es.next()) {
+      std::string* rows = (es.code() == Event::PRE_FRAME) ? pre : (es.code() == Event::POST_FRAME) ? post : nullptr;
+      if (rows) {
+        main->push_back(char(es.code()));
+        rows->append(es.data()+1,es.eventSize()-1);
+      } else {
+        main->append(es.data(),es.eventSize());
+      }
+    }
+    main->append(&mini[es.pos()],es.rawEnd()-es.pos());  //Trailing partial event, if any
+    return true;
+  }
+
+  //Encode a mini replay as a predicted chunk:
+  //  [main length, pre-frame rows, post-frame rows, tail length] (4 bytes each), main stream,
+  //  pre-frame columns, post-frame columns, tail, all LZMA-compressed
+  inline bool _encodePredicted(const std::string &mini, std::string* out) const {
+    std::string main, pre, post;
+    if (!_splitEvents(mini,&main,&pre,&post)) {
+      return false;
+    }
+    if ((_pre_fields.size == 0 && !pre.empty()) || (_post_fields.size == 0 && !post.empty())) {
+      return false;
+    }
+    uint32_t npre  = _pre_fields.size  ? uint32_t(pre.size()/_pre_fields.size)   : 0;
+    uint32_t npost = _post_fields.size ? uint32_t(post.size()/_post_fields.size) : 0;
+    if (size_t(npre)*_pre_fields.size != pre.size() || size_t(npost)*_post_fields.size != post.size()) {
+      return false;  //Payload sizes changed partway through the replay
+    }
+    std::string tail = mini.substr(N_HEADER_BYTES+_rawLength(mini));
+    std::string blob(16,'\0');
+    writeBE4U(uint32_t(main.size()),&blob[0x00]);
+    writeBE4U(npre,                 &blob[0x04]);
+    writeBE4U(npost,                &blob[0x08]);
+    writeBE4U(uint32_t(tail.size()),&blob[0x0C]);
+    blob += main;
+    blob += _packRows(_pre_fields,pre,npre);
+    blob += _packRows(_post_fields,post,npost);
+    blob += tail;
+    *out = compressWithLzma(blob.data(),blob.size());
+    return true;
+  }
+
+  //Rebuild a mini replay from a predicted chunk's (decompressed) data
+  inline bool _decodePredicted(const std::string &data, std::string* mini) const {
+    if (data.size() < 16) {
+      return false;
+    }
+    char* d           = const_cast<char*>(data.data());
+    uint32_t main_len = readBE4U(&d[0x00]);
+    uint32_t npre     = readBE4U(&d[0x04]);
+    uint32_t npost    = readBE4U(&d[0x08]);
+    uint32_t tail_len = readBE4U(&d[0x0C]);
+    uint64_t pre_len  = uint64_t(npre)*_pre_fields.size;
+    uint64_t post_len = uint64_t(npost)*_post_fields.size;
+    if (16 + uint64_t(main_len) + pre_len + post_len + tail_len != data.size() || main_len < 2) {
+      return false;
+    }
+    const char* m    = &d[16];
+    std::string pre  = _unpackRows(_pre_fields,&d[16+main_len],npre);
+    std::string post = _unpackRows(_post_fields,&d[16+main_len+pre_len],npost);
+
+    //Walk the main stream the same way EventStream walks raw events, taking frame event payloads from their rows
+    if (uint8_t(m[0]) != Event::EV_PAYLOADS) {
+      return false;
+    }
+    uint16_t sizes[256] = {0};
+    unsigned ev_bytes   = uint8_t(m[1]);
+    if (1 + ev_bytes > main_len) {
+      return false;
+    }
+    sizes[Event::EV_PAYLOADS] = ev_bytes;
+    for (unsigned i = 1; i + 2 < ev_bytes; i += 3) {
+      sizes[uint8_t(m[1+i])] = readBE2U(const_cast<char*>(&m[2+i]));
+    }
+    uint32_t q = 1 + ev_bytes;
+    std::string raw(m,q);
+    uint32_t ipre = 0, ipost = 0;
+    while (q < main_len) {
+      uint8_t  code  = uint8_t(m[q]);
+      uint32_t psize = sizes[code];
+      if (code == Event::PRE_FRAME || code == Event::POST_FRAME) {
+        bool is_pre             = (code == Event::PRE_FRAME);
+        const std::string &rows = is_pre ? pre : post;
+        uint32_t &i             = is_pre ? ipre : ipost;
+        if (psize == 0 || i >= (is_pre ? npre : npost)) {
+          break;  //Trailing partial event
+        }
+        if (psize != (is_pre ? _pre_fields.size : _post_fields.size)) {
+          return false;
+        }
+        raw.push_back(char(code));
+        raw.append(&rows[size_t(i)*psize],psize);
+        ++i;
+        ++q;
+        continue;
+      }
+      if (psize == 0 || q + 1 + psize > main_len) {
+        break;  //Trailing partial event
+      }
+      raw.append(&m[q],1+psize);
+      q += 1 + psize;
+    }
+    raw.append(&m[q],main_len-q);
+    if (ipre != npre || ipost != npost) {
+      return false;
+    }
+    *mini = _wrapRaw(raw,std::string(&d[16+main_len+pre_len+post_len],tail_len));
+    return true;
+  }
+
+  //Decode chunk i back into its mini replay
+  inline bool _decodeChunk(size_t i, Compressor* c, std::string* mini) const {
+    const ChunkInfo &ci = _chunks[i];
+    std::string data(&_buf[ci.offset],ci.size);
+    if (ci.flags & CHUNK_FLAG_LZMA) {
+      data = decompressWithLzma(data.data(),data.size());
+    }
+    if (ci.flags & CHUNK_FLAG_PREDICTED) {
+      return _decodePredicted(data,mini);
+    }
+    return _transcode(c,data,mini);
+  }
+
+  //Raw length of a mini replay
+  static inline uint32_t _rawLength(const std::string &mini) {
+    return readBE4U(const_cast<char*>(&mini[11]));
+  }
+
+  //Append the bytes of a decoded chunk's raw events that belong to the original replay (i.e., minus its prelude copy)
+  inline bool _ownEvents(size_t i, const std::string &mini, std::string* raw) const {
+    if (mini.size() < N_HEADER_BYTES) {
+      return false;
+    }
+    uint64_t start = N_HEADER_BYTES + ((i == 0) ? 0 : uint64_t(_prelude));
+    uint64_t end   = N_HEADER_BYTES + uint64_t(_rawLength(mini));
+    if (start > end || end > mini.size()) {
+      return false;
+    }
+    raw->append(mini,size_t(start),size_t(end-start));
+    return true;
+  }
+
+  //Decode chunks [first,last] into a single replay
+  inline bool _decodeRange(size_t first, size_t last, std::string* out) const {
+    std::vector<std::string> minis(last-first+1);
+    bool ok = _forEachChunk(minis.size(), [&](size_t i, Compressor* c) {
+      return _decodeChunk(first+i,c,&minis[i]);
+    });
+    if (!ok) {
+      FAIL("Failed to decode chunks " << first << " through " << last);
+      return false;
+    }
+    std::string raw;
+    if (first > 0) {  //Start with the prelude copy so the result is a self-contained replay
+      if (minis[0].size() < N_HEADER_BYTES + uint64_t(_prelude)) {
+        FAIL_CORRUPT("Chunk " << first << " is shorter than its prelude");
+        return false;
+      }
+      raw.append(minis[0],N_HEADER_BYTES,_prelude);
+    }
+    for (size_t i = 0; i < minis.size(); ++i) {
+      if (!_ownEvents(first+i,minis[i],&raw)) {
+        FAIL_CORRUPT("Chunk " << (first+i) << " has an invalid raw event length");
+        return false;
+      }
+    }
+    //Only the last chunk carries the original metadata (_ownEvents() checked it has room for its raw events)
+    std::string tail = EMPTY_SLP_METADATA;
+    if (last == _chunks.size()-1) {
+      const std::string &m = minis.back();
+      tail = m.substr(N_HEADER_BYTES+_rawLength(m));
+    }
+    *out = _wrapRaw(raw,tail);
+    return true;
+  }
+
+public:
+  ChunkedCompressor(int debug_level, unsigned chunk_frames = DEFAULT_CHUNK_FRAMES, unsigned threads = 0, bool predicted = false)
+    : _debug(debug_level), _chunk_frames(std::max(chunk_frames,1u)), _threads(threads), _predicted(predicted) {}
+
+  //Check whether a buffer holds a chunked replay
+  static inline bool isChunked(const char* buf, uint32_t size) {
+    return size >= CHUNKED_HEADER_SIZE && same4(const_cast<char*>(buf),CHUNKED_HEADER);
+  }
+
+  //Encode a raw replay buffer into the chunked format
+  inline bool encode(const char* slp, uint32_t size, std::string* out) {
+    EventStream es;
+    if (!es.open(slp,size)) {
+      FAIL("Not a raw replay file");
+      return false;
+    }
+    if (!es.valid() || es.code() != Event::GAME_START) {
+      FAIL_CORRUPT("Game start event not found");
+      return false;
+    }
+    es.next();
+    uint32_t prelude_len = es.pos() - N_HEADER_BYTES;  //Event payloads + game start
+
+    //Split the events into chunks at frame boundaries
+    bool has_frame_start  = es.payloadSize(Event::FRAME_START) > 0;
+    uint8_t opening_event = has_frame_start ? Event::FRAME_START : Event::PRE_FRAME;
+    int32_t next_boundary = LOAD_FRAME + int32_t(_chunk_frames);
+    int32_t last_opened   = LOAD_FRAME - 1;
+    std::vector<uint32_t>  starts = {N_HEADER_BYTES};
+    std::vector<ChunkInfo> chunks(1);
+    bool chunk_has_frames = false;
+    for (; es.valid(); es.next()) {
+      if (!EventStream::hasFrame(es.code())) {
+        continue;
+      }
+      int32_t f = es.frame();
+      if (es.code() == opening_event && f > last_opened) {
+        last_opened = f;
+        if (f >= next_boundary && chunk_has_frames) {
+          starts.push_back(es.pos());
+          chunks.emplace_back();
+          chunk_has_frames = false;
+        }
+        if (f >= next_boundary) {
+          next_boundary = f + int32_t(_chunk_frames);
+        }
+      }
+      ChunkInfo &ci = chunks.back();
+      if (!chunk_has_frames) {
+        ci.min_frame     = f;
+        ci.max_frame     = f;
+        chunk_has_frames = true;
+      }
+      ci.min_frame = std::min(ci.min_frame,f);
+      ci.max_frame = std::max(ci.max_frame,f);
+    }
+    uint32_t raw_end = es.rawEnd();
+    starts.push_back(raw_end);
+    std::string prelude(&slp[N_HEADER_BYTES],prelude_len);
+    std::string tail(&slp[raw_end],size-raw_end);
+    DOUT1("Splitting " << (raw_end-N_HEADER_BYTES) << " bytes of events into " << chunks.size() << " chunks");
+
+    //Lay out the frame event fields and measure every predictor on the first chunk
+    _pre_fields  = PredictedFields();
+    _post_fields = PredictedFields();
+    if (_predicted) {
+      _pre_fields.layout(CW_PRE_COLUMNS,es.payloadSize(Event::PRE_FRAME));
+      _post_fields.layout(CW_POST_COLUMNS,es.payloadSize(Event::POST_FRAME));
+      std::string main, pre, post;
+      if (!_splitEvents(_wrapRaw(std::string(&slp[starts[0]],starts[1]-starts[0]),EMPTY_SLP_METADATA),&main,&pre,&post)) {
+        FAIL("Failed to split the first chunk's events");
+        return false;
+      }
+      if (_pre_fields.size) {
+        _choosePredictors(&_pre_fields,pre.data(),uint32_t(pre.size()/_pre_fields.size));
+      }
+      if (_post_fields.size) {
+        _choosePredictors(&_post_fields,post.data(),uint32_t(post.size()/_post_fields.size));
+      }
+    }
+    std::string table;
+    for (const PredictedFields* f : {&_pre_fields,&_post_fields}) {
+      table.push_back(char(f->widths.size()));
+      for (size_t c = 0; c < f->widths.size(); ++c) {
+        char e[3];
+        writeBE2U(f->widths[c],&e[0]);
+        e[2] = char(f->preds[c]);
+        table.append(e,3);
+      }
+    }
+
+    //Encode every chunk as its own mini replay
+    std::vector<std::string> data(chunks.size());
+    bool ok = _forEachChunk(chunks.size(), [&](size_t i, Compressor* c) {
+      std::string raw = (i == 0) ? "" : prelude;
+      raw.append(&slp[starts[i]],starts[i+1]-starts[i]);
+      std::string mini = _wrapRaw(raw,(i == chunks.size()-1) ? tail : EMPTY_SLP_METADATA);
+      if (_predicted) {
+        chunks[i].flags |= CHUNK_FLAG_PREDICTED | CHUNK_FLAG_LZMA;
+        return _encodePredicted(mini,&data[i]);
+      }
+      if (!_transcode(c,mini,&data[i])) {
+        return false;
+      }
+      //Make sure we end up compressed even if the Compressor hands back a bare encoding
+      if (data[i].size() < 4 || !same4(&data[i][0],LZMA_HEADER)) {
+        data[i]          = compressWithLzma(data[i].data(),data[i].size());
+        chunks[i].flags |= CHUNK_FLAG_LZMA;
+      }
+      return true;
+    });
+    if (!ok) {
+      FAIL("Failed to encode chunks");
+      return false;
+    }
+
+    //Write the header, the chunk index, the predictor table, and the chunk data
+    size_t total = CHUNKED_HEADER_SIZE + CHUNK_ENTRY_SIZE*chunks.size() + table.size();
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      chunks[i].offset = uint32_t(total);
+      chunks[i].size   = uint32_t(data[i].size());
+      total           += data[i].size();
+    }
+    out->assign(CHUNKED_HEADER_SIZE + CHUNK_ENTRY_SIZE*chunks.size(),'\0');
+    char* h = &(*out)[0];
+    memcpy(h,&CHUNKED_HEADER,4);
+    h[4] = CHUNKED_VERSION;
+    writeBE4U(_chunk_frames,               &h[0x08]);
+    writeBE4U(uint32_t(chunks.size()),     &h[0x0C]);
+    writeBE4U(raw_end-N_HEADER_BYTES,      &h[0x10]);
+    writeBE4U(prelude_len,                 &h[0x14]);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      char* e = &h[CHUNKED_HEADER_SIZE + CHUNK_ENTRY_SIZE*i];
+      writeBE4U(chunks[i].offset,   &e[0x00]);
+      writeBE4U(chunks[i].size,     &e[0x04]);
+      writeBE4S(chunks[i].min_frame,&e[0x08]);
+      writeBE4S(chunks[i].max_frame,&e[0x0C]);
+      writeBE4U(chunks[i].flags,    &e[0x10]);
+    }
+    out->reserve(total);
+    out->append(table);
+    for (const auto& d : data) {
+      out->append(d);
+    }
+    return true;
+  }
+
+  //Load a chunked file's header and index; the buffer must outlive any decode calls
+  inline bool load(const char* buf, uint32_t size) {
+    _chunks.clear();
+    if (!isChunked(buf,size)) {
+      FAIL("Not a chunked replay file");
+      return false;
+    }
+    if (uint8_t(buf[4]) > CHUNKED_VERSION) {
+      FAIL("Chunked replay version " << int(uint8_t(buf[4])) << " is newer than supported version " << int(CHUNKED_VERSION));
+      return false;
+    }
+    char* h          = const_cast<char*>(buf);
+    _chunk_frames    = readBE4U(&h[0x08]);
+    uint32_t nchunks = readBE4U(&h[0x0C]);
+    _raw_len         = readBE4U(&h[0x10]);
+    _prelude         = readBE4U(&h[0x14]);
+    if (nchunks == 0 || CHUNKED_HEADER_SIZE + uint64_t(CHUNK_ENTRY_SIZE)*nchunks > size) {
+      FAIL_CORRUPT("Chunk index is truncated");
+      return false;
+    }
+    //Read the predictor table; version 1 files don't have one (or any predicted chunks)
+    _pre_fields  = PredictedFields();
+    _post_fields = PredictedFields();
+    uint64_t t   = CHUNKED_HEADER_SIZE + uint64_t(CHUNK_ENTRY_SIZE)*nchunks;
+    if (uint8_t(buf[4]) >= 2) {
+      for (PredictedFields* f : {&_pre_fields,&_post_fields}) {
+        if (t + 1 > size || t + 1 + 3*uint64_t(uint8_t(buf[t])) > size) {
+          FAIL_CORRUPT("Predictor table is truncated");
+          return false;
+        }
+        unsigned ncols = uint8_t(buf[t++]);
+        for (unsigned c = 0; c < ncols; ++c, t += 3) {
+          f->widths.push_back(readBE2U(&h[t]));
+          f->preds.push_back(uint8_t(buf[t+2]));
+        }
+        uint32_t off = 0;
+        for (size_t c = 0; c < ncols; off += f->widths[c], ++c) {
+          if (f->widths[c] == 0 || f->preds[c] >= Pred::COUNT || (f->preds[c] != Pred::RAW && !f->predictable(c,off))) {
+            FAIL_CORRUPT("Predictor table is invalid");
+            return false;
+          }
+        }
+        f->size = off;
+      }
+    }
+    _chunks.resize(nchunks);
+    for (uint32_t i = 0; i < nchunks; ++i) {
+      char* e = &h[CHUNKED_HEADER_SIZE + CHUNK_ENTRY_SIZE*i];
+      ChunkInfo &ci = _chunks[i];
+      ci.offset     = readBE4U(&e[0x00]);
+      ci.size       = readBE4U(&e[0x04]);
+      ci.min_frame  = readBE4S(&e[0x08]);
+      ci.max_frame  = readBE4S(&e[0x0C]);
+      ci.flags      = readBE4U(&e[0x10]);
+      if (uint64_t(ci.offset) + ci.size > size) {
+        FAIL_CORRUPT("Chunk " << i << " extends past the end of the file");
+        _chunks.clear();
+        return false;
+      }
+    }
+    _buf  = buf;
+    _size = size;
+    return true;
+  }
+
+  //Decode the whole loaded file back into the original replay
+  inline bool decode(std::string* out) const {
+    if (_chunks.empty()) {
+      return false;
+    }
+    if (!_decodeRange(0,_chunks.size()-1,out)) {
+      return false;
+    }
+    if (_rawLength(*out) != _raw_len) {
+      FAIL_CORRUPT("Decoded " << _rawLength(*out) << " bytes of events but expected " << _raw_len);
+      return false;
+    }
+    return true;
+  }
+
+  //Decode only the chunks covering frames [first,last] into a self-contained replay
+  //  (the result may include a few frames on either side of the window)
+  inline bool decodeFrames(int32_t first, int32_t last, std::string* out) const {
+    size_t cfirst = _chunks.size(), clast = 0;
+    for (size_t i = 0; i < _chunks.size(); ++i) {
+      if (_chunks[i].max_frame >= first && _chunks[i].min_frame <= last) {
+        cfirst = std::min(cfirst,i);
+        clast  = std::max(clast,i);
+      }
+    }
+    if (cfirst == _chunks.size()) {
+      FAIL("No chunk contains frames " << first << " through " << last);
+      return false;
+    }
+    return _decodeRange(cfirst,clast,out);
+  }
+
+  inline const std::vector<ChunkInfo>& chunks() const { return _chunks; }
+  inline unsigned chunkFrames() const { return _chunk_frames; }
+};
+
+}
+
+#endif /* CHUNKED_H_ */
@@ -15,6 +15,7 @@
 #include "enums.h"
 #include "schema.h"
 #include "gecko-legacy.h"
+#include "framedecode.h"
 
 // Replay File (.slp) Spec: https://github.com/project-slippi/slippi-wiki/blob/master/SPEC.md
 
@@ -35,8 +36,38 @@ const int      RB_SIZE               = 4;           //Size of circular queue for
 const int      FRAME_ENC_DELTA       = 1;           //Delta when predicting and encoding next frame
 const int      ALLOC_EVENTS          = 100000;      //Number of events to initially allocate space for shuffling
 
+// Default frame event column byte widths (truncated per replay version by truncateColumnWidthsToVersion())
+#define CW_START {1,4,4,4,0}
+#define CW_MESG  {1,512,2,1,1,0}
+#define CW_PRE   {1,4,1,1,4,2,4,4,4,4,4,4,4,4,4,2,4,4,1,4,0}
+#define CW_ITEM  {1,4,2,1,4,4,4,4,4,2,4, 1,1,1,1 ,1,1,1,1,1,0} // Shuffle bytes of item id
+#define CW_POST  {1,4,1,1,1,2,4,4,4,4,4,1,1,1,1,4,1,1,1,1,1,4,1,2,1,1,1,4,4,4,4,4,4,4,0}
+#define CW_END   {1,4,4,0}
+
 namespace slip {
 
+//Whether every field a FrameDecoder reads starts a column of the same width in a 0-terminated CW_* table
+constexpr bool columnsMatchFields(const int32_t* cw, const FrameField* fields, unsigned n_fields) {
+  for (unsigned f = 0; f < n_fields; ++f) {
+    unsigned off = 0;
+    unsigned c   = 0;
+    for (; cw[c] != 0 && off < fields[f].off; ++c) {
+      off += (cw[c] > 0) ? unsigned(cw[c]) : 1;  //Bit shuffling columns are always one byte
+    }
+    if (cw[c] == 0 || off != fields[f].off || ((cw[c] > 0) ? unsigned(cw[c]) : 1) != fields[f].width) {
+      return false;
+    }
+  }
+  return true;
+}
+
+constexpr int32_t CW_PRE_COLUMNS[]  = CW_PRE;
+constexpr int32_t CW_ITEM_COLUMNS[] = CW_ITEM;
+constexpr int32_t CW_POST_COLUMNS[] = CW_POST;
+static_assert(columnsMatchFields(CW_PRE_COLUMNS, PRE_FRAME_FIELDS, N_PRE_FRAME_FIELDS),   "CW_PRE doesn't match PRE_FRAME_FIELDS");
+static_assert(columnsMatchFields(CW_ITEM_COLUMNS,ITEM_FRAME_FIELDS,N_ITEM_FRAME_FIELDS),  "CW_ITEM doesn't match ITEM_FRAME_FIELDS");
+static_assert(columnsMatchFields(CW_POST_COLUMNS,POST_FRAME_FIELDS,N_POST_FRAME_FIELDS),  "CW_POST doesn't match POST_FRAME_FIELDS");
+
 class Compressor {
 private:
 
@@ -94,20 +125,20 @@ private:
   bool            _game_end_found            = false;   //Whether we've found the game end event
 
   // Frame event column byte widths (negative numbers denote bit shuffling)
-  int32_t         _cw_start[5] = {1,4,4,4,0};
-  int32_t         _cw_mesg[6]  = {1,512,2,1,1,0};
-  int32_t         _cw_pre[21]  = {1,4,1,1,4,2,4,4,4,4,4,4,4,4,4,2,4,4,1,4,0};
-  int32_t         _cw_item[21] = {1,4,2,1,4,4,4,4,4,2,4, 1,1,1,1 ,1,1,1,1,1,0}; // Shuffle bytes of item id
-  int32_t         _cw_post[35] = {1,4,1,1,1,2,4,4,4,4,4,1,1,1,1,4,1,1,1,1,1,4,1,2,1,1,1,4,4,4,4,4,4,4,0};
-  int32_t         _cw_end[4]   = {1,4,4,0};
+  int32_t         _cw_start[5] = CW_START;
+  int32_t         _cw_mesg[6]  = CW_MESG;
+  int32_t         _cw_pre[21]  = CW_PRE;
+  int32_t         _cw_item[21] = CW_ITEM;
+  int32_t         _cw_post[35] = CW_POST;
+  int32_t         _cw_end[4]   = CW_END;
 
   // Debug Frame event column byte widths (negative numbers denote bit shuffling)
-  int32_t         _dw_start[5] = {1,4,4,4,0};
-  int32_t         _dw_mesg[6]  = {1,512,2,1,1,0};
-  int32_t         _dw_pre[21]  = {1,4,1,1,4,2,4,4,4,4,4,4,4,4,4,2,4,4,1,4,0};
-  int32_t         _dw_item[21] = {1,4,2,1,4,4,4,4,4,2,4, 1,1,1,1 ,1,1,1,1,1,0}; // Shuffle bytes of item id
-  int32_t         _dw_post[35] = {1,4,1,1,1,2,4,4,4,4,4,1,1,1,1,4,1,1,1,1,1,4,1,2,1,1,1,4,4,4,4,4,4,4,0};
-  int32_t         _dw_end[4]   = {1,4,4,0};
+  int32_t         _dw_start[5] = CW_START;
+  int32_t         _dw_mesg[6]  = CW_MESG;
+  int32_t         _dw_pre[21]  = CW_PRE;
+  int32_t         _dw_item[21] = CW_ITEM;
+  int32_t         _dw_post[35] = CW_POST;
+  int32_t         _dw_end[4]   = CW_END;
 
   bool            _parse();             //Internal main parsing funnction
   bool            _parseHeader();
@@ -134,6 +165,71 @@ public:
   unsigned saveToBuff(char** buffer);              //Save an encoded replay buffer
   bool validate();                                 //Validate the encoding
 
+  //Return this compressor to its freshly-constructed state so it can process another replay
+  inline void reset() {
+    delete[] _rb;
+    delete[] _wb;
+    delete _outfilename;
+    delete _outgeckofilename;
+    _rb                 = nullptr;
+    _wb                 = nullptr;
+    _outfilename        = nullptr;
+    _outgeckofilename   = nullptr;
+    _infilename         = "";
+
+    memset(_payload_sizes,0,sizeof(_payload_sizes));
+    _slippi_maj         = 0;
+    _slippi_min         = 0;
+    _slippi_rev         = 0;
+    _encode_ver         = 0;
+    _max_frames         = 0;
+
+    float_to_int.clear();
+    int_to_float.clear();
+    int_to_float_c.clear();
+    num_floats          = 0;
+    _preds              = 0;
+    _fails              = 0;
+
+    //Predictor state
+    _rng                = 0;
+    _rng_start          = 0;
+    memset(_x_pre_frame,   0,sizeof(_x_pre_frame));
+    memset(_x_pre_frame_2, 0,sizeof(_x_pre_frame_2));
+    memset(_x_post_frame,  0,sizeof(_x_post_frame));
+    memset(_x_post_frame_2,0,sizeof(_x_post_frame_2));
+    memset(_x_post_frame_3,0,sizeof(_x_post_frame_3));
+    memset(_x_item,        0,sizeof(_x_item));
+    memset(_x_item_2,      0,sizeof(_x_item_2));
+    memset(_x_item_3,      0,sizeof(_x_item_3));
+    memset(_x_item_4,      0,sizeof(_x_item_4));
+    memset(_x_item_p,      0,sizeof(_x_item_p));
+
+    //Frame trackers (same values as the in-class initializers: first element -123, rest 0)
+    laststartframe      = -123;
+    lastitemstartframe  = -123;
+    lastshuffleframe    = -123;
+    lastitemshuffleframe= -123;
+    for (unsigned p = 0; p < 8; ++p) {
+      lastpreframe[p]         = (p == 0) ? -123 : 0;
+      lastshufflepreframe[p]  = (p == 0) ? -123 : 0;
+      lastpostframe[p]        = (p == 0) ? -123 : 0;
+      lastshufflepostframe[p] = (p == 0) ? -123 : 0;
+    }
+
+    _bp                 = 0;
+    _length_raw         = 0;
+    _length_raw_start   = 0;
+    _game_loop_start    = 0;
+    _game_loop_end      = 0;
+    _file_size          = 0;
+    _message_count      = 0;
+    _game_end_found     = false;
+
+    //Undo any version-specific truncation from the previous replay
+    resetColumnWidths();
+  }
+
   //https://www.reddit.com/r/SSBM/comments/71gn1d/the_basics_of_rng_in_melee/
   inline int32_t rollRNGLegacy(int32_t seed) const {
     int64_t bigseed = seed;  //Cast from 32-bit to 64-bit int
@@ -1033,6 +1129,22 @@ public:
     return _legacy_gecko_codes;
   }
 
+  //Restore the full-length column width tables (undoing truncateColumnWidthsToVersion())
+  inline void resetColumnWidths() {
+    const int32_t cw_start[5] = CW_START;
+    const int32_t cw_mesg[6]  = CW_MESG;
+    const int32_t cw_pre[21]  = CW_PRE;
+    const int32_t cw_item[21] = CW_ITEM;
+    const int32_t cw_post[35] = CW_POST;
+    const int32_t cw_end[4]   = CW_END;
+    memcpy(_cw_start,cw_start,sizeof(cw_start)); memcpy(_dw_start,cw_start,sizeof(cw_start));
+    memcpy(_cw_mesg, cw_mesg, sizeof(cw_mesg));  memcpy(_dw_mesg, cw_mesg, sizeof(cw_mesg));
+    memcpy(_cw_pre,  cw_pre,  sizeof(cw_pre));   memcpy(_dw_pre,  cw_pre,  sizeof(cw_pre));
+    memcpy(_cw_item, cw_item, sizeof(cw_item));  memcpy(_dw_item, cw_item, sizeof(cw_item));
+    memcpy(_cw_post, cw_post, sizeof(cw_post));  memcpy(_dw_post, cw_post, sizeof(cw_post));
+    memcpy(_cw_end,  cw_end,  sizeof(cw_end));   memcpy(_dw_end,  cw_end,  sizeof(cw_end));
+  }
+
   inline void truncateColumnWidthsToVersion() {
     if (MAX_VERSION(3,11,0)) {
       this->_cw_post[33] = 0; //Animation index is invalid
@@ -0,0 +1,201 @@
+#ifndef EVENTINDEX_H_
+#define EVENTINDEX_H_
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include "util.h"
+#include "enums.h"
+#include "schema.h"
+#include "eventstream.h"
+
+// Event index: maps every frame number of a raw replay to the byte offset of the event that opens it
+//   (its frame start event, or its first pre-frame event for replays older than frame start events),
+//   built in one linear pass over the payload sizes. Readers can then seek an EventStream straight to
+//   frame N instead of scanning every event before it. When a frame was replayed by a rollback, the
+//   index points at its last (final) occurrence.
+//
+// Serialized layout (all integers big-endian), stored as a sidecar file or embedded in another container:
+//   0x00  magic "SLPI"
+//   0x04  format version (1 byte) + 3 reserved bytes
+//   0x08  size of the indexed replay file (to detect a stale index)
+//   0x0C  raw event length of the indexed replay (to detect a stale index)
+//   0x10  offset of the first event after the game start event (end of the prelude)
+//   0x14  first frame number
+//   0x18  number of frames
+//   0x1C  offsets, 4 bytes per frame starting at the first frame (0 = frame never opened)
+
+const uint32_t    EVENT_INDEX_HEADER      = BYTE4(0x53,0x4c,0x50,0x49); // SLPI
+const uint8_t     EVENT_INDEX_VERSION     = 1;   //Internal version of the event index format
+const unsigned    EVENT_INDEX_HEADER_SIZE = 0x1C;
+const std::string EVENT_INDEX_EXT         = ".slpidx";
+
+namespace slip {
+
+class EventIndex {
+private:
+  int                   _debug;              //Current debug level
+  uint32_t              _file_size   = 0;    //Size of the indexed replay file
+  uint32_t              _raw_len     = 0;    //Raw event length of the indexed replay
+  uint32_t              _prelude_end = 0;    //Offset of the first event after the game start event
+  int32_t               _first_frame = 0;    //Frame number of _offsets[0]
+  std::vector<uint32_t> _offsets;            //Offset of the event opening each frame (0 = never opened)
+
+public:
+  EventIndex(int debug_level = 0) : _debug(debug_level) {}
+
+  //Sidecar file name for a replay
+  static inline std::string sidecarPath(const std::string& replay_path) {
+    return replay_path + EVENT_INDEX_EXT;
+  }
+
+  //Index a raw replay buffer in one pass
+  inline bool build(const char* slp, uint32_t size) {
+    _offsets.clear();
+    EventStream es;
+    if (!es.open(slp,size)) {
+      FAIL("Not a raw replay file");
+      return false;
+    }
+    if (!es.valid() || es.code() != Event::GAME_START) {
+      FAIL_CORRUPT("Game start event not found");
+      return false;
+    }
+    es.next();
+    _file_size   = size;
+    _raw_len     = es.rawEnd() - N_HEADER_BYTES;
+    _prelude_end = es.pos();
+    _first_frame = LOAD_FRAME;
+
+    bool has_frame_start  = es.payloadSize(Event::FRAME_START) > 0;
+    uint8_t opening_event = has_frame_start ? Event::FRAME_START : Event::PRE_FRAME;
+    int32_t last_opened   = LOAD_FRAME - 1;
+    for (; es.valid(); es.next()) {
+      if (es.code() != opening_event) {
+        continue;
+      }
+      //Without frame start events, the first pre-frame event for a frame number opens it
+      int32_t f = es.frame();
+      if (!has_frame_start && f == last_opened) {
+        continue;
+      }
+      last_opened = f;
+      if (f < _first_frame) {
+        DOUT1("Skipping event for frame " << f << " before the first playable frame");
+        continue;
+      }
+      size_t i = size_t(f - _first_frame);
+      if (i >= _offsets.size()) {
+        _offsets.resize(i+1,0);
+      }
+      _offsets[i] = es.pos();
+    }
+    DOUT1("Indexed " << _offsets.size() << " frames");
+    return true;
+  }
+
+  //Whether this index was built from the given replay buffer (by size; cheap enough to run on every load)
+  inline bool matches(const char* slp, uint32_t size) const {
+    return size == _file_size && size >= N_HEADER_BYTES && readBE4U(const_cast<char*>(&slp[11])) == _raw_len;
+  }
+
+  inline bool    empty()       const { return _offsets.empty(); }
+  inline int32_t firstFrame()  const { return _first_frame; }
+  inline int32_t lastFrame()   const { return _first_frame + int32_t(_offsets.size()) - 1; }
+  inline uint32_t preludeEnd() const { return _prelude_end; }
+
+  //Offset of the event opening a frame, or 0 if the replay never reached it
+  inline uint32_t offset(int32_t frame) const {
+    if (frame < _first_frame || frame > lastFrame()) {
+      return 0;
+    }
+    return _offsets[size_t(frame - _first_frame)];
+  }
+
+  //Position an open EventStream at the start of a frame
+  inline bool seek(EventStream& es, int32_t frame) const {
+    uint32_t pos = offset(frame);
+    if (pos == 0) {
+      return false;
+    }
+    es.seek(pos);
+    return true;
+  }
+
+  //Serialize the index (see layout above)
+  inline std::string serialize() const {
+    std::string out(EVENT_INDEX_HEADER_SIZE + 4*_offsets.size(),'\0');
+    char* h = &out[0];
+    memcpy(h,&EVENT_INDEX_HEADER,4);
+    h[4] = EVENT_INDEX_VERSION;
+    writeBE4U(_file_size,              &h[0x08]);
+    writeBE4U(_raw_len,                &h[0x0C]);
+    writeBE4U(_prelude_end,            &h[0x10]);
+    writeBE4S(_first_frame,            &h[0x14]);
+    writeBE4U(uint32_t(_offsets.size()),&h[0x18]);
+    for (size_t i = 0; i < _offsets.size(); ++i) {
+      writeBE4U(_offsets[i],&h[EVENT_INDEX_HEADER_SIZE + 4*i]);
+    }
+    return out;
+  }
+
+  //Load a serialized index
+  inline bool deserialize(const char* buf, uint32_t size) {
+    _offsets.clear();
+    if (size < EVENT_INDEX_HEADER_SIZE || !same4(const_cast<char*>(buf),EVENT_INDEX_HEADER)) {
+      FAIL("Not an event index");
+      return false;
+    }
+    if (uint8_t(buf[4]) > EVENT_INDEX_VERSION) {
+      FAIL("Event index version " << int(uint8_t(buf[4])) << " is newer than supported version " << int(EVENT_INDEX_VERSION));
+      return false;
+    }
+    char* h          = const_cast<char*>(buf);
+    _file_size       = readBE4U(&h[0x08]);
+    _raw_len         = readBE4U(&h[0x0C]);
+    _prelude_end     = readBE4U(&h[0x10]);
+    _first_frame     = readBE4S(&h[0x14]);
+    uint32_t nframes = readBE4U(&h[0x18]);
+    if (EVENT_INDEX_HEADER_SIZE + 4*uint64_t(nframes) > size) {
+      FAIL_CORRUPT("Event index is truncated");
+      return false;
+    }
+    _offsets.resize(nframes);
+    for (uint32_t i = 0; i < nframes; ++i) {
+      _offsets[i] = readBE4U(&h[EVENT_INDEX_HEADER_SIZE + 4*i]);
+      if (_offsets[i] >= _file_size) {
+        FAIL_CORRUPT("Event index offset for frame " << (_first_frame + int32_t(i)) << " is past the end of the replay");
+        _offsets.clear();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  //Write the index to a sidecar file
+  inline bool save(const std::string& path) const {
+    std::string data = serialize();
+    std::ofstream ofile(path,std::ios::binary | std::ios::trunc);
+    ofile.write(data.data(),data.size());
+    if (!ofile) {
+      FAIL("Failed to write event index " << path);
+      return false;
+    }
+    return true;
+  }
+
+  //Read the index from a sidecar file
+  inline bool load(const std::string& path) {
+    std::ifstream ifile(path,std::ios::binary);
+    if (!ifile) {
+      return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(ifile)),std::istreambuf_iterator<char>());
+    return deserialize(data.data(),uint32_t(data.size()));
+  }
+};
+
+}
+
+#endif /* EVENTINDEX_H_ */
@@ -0,0 +1,92 @@
+#ifndef EVENTSTREAM_H_
+#define EVENTSTREAM_H_
+
+#include <iostream>
+
+#include "util.h"
+#include "enums.h"
+#include "schema.h"
+
+// Replay File (.slp) Spec: https://github.com/project-slippi/slippi-wiki/blob/master/SPEC.md
+
+namespace slip {
+
+//Lightweight forward-only cursor over the raw events of an in-memory .slp buffer
+//  -> does no decoding and no allocation; just walks event boundaries using the payload sizes
+class EventStream {
+private:
+  const char*     _buf                = nullptr; //Buffer holding the replay
+  uint32_t        _size               = 0;       //Size of the buffer
+  uint32_t        _raw_end            = 0;       //First byte after the raw event block
+  uint32_t        _pos                = 0;       //Position of the current event's command byte
+  uint32_t        _first_event        = 0;       //Position of the first event after the payload sizes event
+  uint16_t        _payload_sizes[256] = {0};     //Size of payload for each event
+
+public:
+  //Read the header and event payload sizes from a buffer and position the cursor at the
+  //  first event after the payload sizes event; returns false if the buffer isn't a raw replay
+  inline bool open(const char* buf, uint32_t size) {
+    _buf  = buf;
+    _size = size;
+    memset(_payload_sizes,0,sizeof(_payload_sizes));
+    if (size < N_HEADER_BYTES + 2 || !same8(const_cast<char*>(buf),SLP_HEADER)) {
+      return false;
+    }
+    uint32_t length_raw = readBE4U(const_cast<char*>(&buf[11]));
+    //A zero raw length means the replay is still being written, so use whatever we have
+    _raw_end = (length_raw == 0) ? size : std::min(size,N_HEADER_BYTES+length_raw);
+
+    unsigned p = N_HEADER_BYTES;
+    if (uint8_t(buf[p]) != Event::EV_PAYLOADS) {
+      return false;
+    }
+    unsigned ev_bytes = uint8_t(buf[p+1]);  //Includes the size byte itself
+    if (p + 1 + ev_bytes > _raw_end) {
+      return false;
+    }
+    _payload_sizes[Event::EV_PAYLOADS] = ev_bytes;
+    for (unsigned i = 1; i + 2 < ev_bytes; i += 3) {
+      uint8_t ev_code        = buf[p+1+i];
+      _payload_sizes[ev_code] = readBE2U(const_cast<char*>(&buf[p+2+i]));
+    }
+    _first_event = p + 1 + ev_bytes;
+    _pos         = _first_event;
+    return true;
+  }
+
+  //Whether the cursor points to a complete event we know the size of
+  inline bool valid() const {
+    return (_pos < _raw_end) && (_payload_sizes[code()] > 0) && (_pos + eventSize() <= _raw_end);
+  }
+
+  //Advance to the next event
+  inline void next() {
+    _pos += eventSize();
+  }
+
+  //Move the cursor to an arbitrary event boundary (e.g., one stored in an event index)
+  inline void seek(uint32_t pos) {
+    _pos = pos;
+  }
+
+  //Whether events of this type carry a frame number at O_FRAME
+  static inline bool hasFrame(uint8_t ev_code) {
+    return ev_code == Event::FRAME_START || ev_code == Event::PRE_FRAME || ev_code == Event::POST_FRAME ||
+           ev_code == Event::ITEM_UPDATE || ev_code == Event::BOOKEND;
+  }
+
+  inline uint8_t         code()         const { return uint8_t(_buf[_pos]); }
+  inline const char*     data()         const { return &_buf[_pos]; }
+  inline uint32_t        eventSize()    const { return 1 + _payload_sizes[code()]; }
+  inline int32_t         frame()        const { return readBE4S(const_cast<char*>(&_buf[_pos+O_FRAME])); }
+  inline uint32_t        pos()          const { return _pos; }
+  inline uint32_t        firstEvent()   const { return _first_event; }
+  inline uint32_t        rawEnd()       const { return _raw_end; }
+  inline uint32_t        size()         const { return _size; }
+  inline const uint16_t* payloadSizes() const { return _payload_sizes; }
+  inline uint16_t        payloadSize(uint8_t ev_code) const { return _payload_sizes[ev_code]; }
+};
+
+}
+
+#endif /* EVENTSTREAM_H_ */
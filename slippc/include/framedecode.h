@@ -0,0 +1,463 @@
+#ifndef FRAMEDECODE_H_
+#define FRAMEDECODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "simd.h"
+#include "schema.h"
+#include "replay.h"
+
+// Replay File (.slp) Spec: https://github.com/project-slippi/slippi-wiki/blob/master/SPEC.md
+
+//Standalone bulk decoders for frame and item events, for code that walks raw events itself (LiveParser,
+//  the benchmarks); the prebuilt Parser keeps its own per-field decoding and doesn't use them
+
+namespace slip {
+
+//Slippi version packed into one comparable integer
+constexpr uint32_t slippiVersion(unsigned maj, unsigned min, unsigned rev) {
+  return (uint32_t(maj) << 16) | (uint32_t(min) << 8) | uint32_t(rev);
+}
+
+//How a decoded field is stored in its destination member
+enum FieldKind : uint8_t {
+  FIELD_RAW  = 0,  //Copy the byte-swapped value as-is (ints, floats)
+  FIELD_BOOL = 1,  //Single byte, stored as a bool (0 or 1)
+};
+
+//One big-endian field of an event and where it goes in the struct it's decoded into
+struct FrameField {
+  uint16_t  off;          //Offset within the event (command byte at 0)
+  uint8_t   width;        //Width in bytes (1, 2 or 4)
+  FieldKind kind;         //How to store it
+  uint16_t  dest;         //Byte offset of the destination member
+  uint32_t  min_version;  //First Slippi version whose events contain this field
+};
+
+#define SLIP_FIELD(type,o,w,k,member,maj,min,rev) \
+  {uint16_t(o),uint8_t(w),k,uint16_t(offsetof(type,member)),slippiVersion(maj,min,rev)}
+#define SLIP_FRAME_FIELD(o,w,k,member,maj,min,rev) SLIP_FIELD(SlippiFrame,o,w,k,member,maj,min,rev)
+#define SLIP_ITEM_FIELD(o,w,k,member,maj,min,rev)  SLIP_FIELD(SlippiItemFrame,o,w,k,member,maj,min,rev)
+
+//Tables are sorted by offset, and fields are only ever appended to an event, so versions never decrease
+
+//Pre-frame fields
+inline constexpr FrameField PRE_FRAME_FIELDS[] = {
+  SLIP_FRAME_FIELD(O_FRAME,       4,FIELD_RAW, frame,        0, 1,0),
+  SLIP_FRAME_FIELD(O_PLAYER,      1,FIELD_RAW, player,       0, 1,0),
+  SLIP_FRAME_FIELD(O_FOLLOWER,    1,FIELD_BOOL,follower,     0, 1,0),
+  SLIP_FRAME_FIELD(O_RNG_PRE,     4,FIELD_RAW, seed,         0, 1,0),
+  SLIP_FRAME_FIELD(O_ACTION_PRE,  2,FIELD_RAW, action_pre,   0, 1,0),
+  SLIP_FRAME_FIELD(O_XPOS_PRE,    4,FIELD_RAW, pos_x_pre,    0, 1,0),
+  SLIP_FRAME_FIELD(O_YPOS_PRE,    4,FIELD_RAW, pos_y_pre,    0, 1,0),
+  SLIP_FRAME_FIELD(O_FACING_PRE,  4,FIELD_RAW, face_dir_pre, 0, 1,0),
+  SLIP_FRAME_FIELD(O_JOY_X,       4,FIELD_RAW, joy_x,        0, 1,0),
+  SLIP_FRAME_FIELD(O_JOY_Y,       4,FIELD_RAW, joy_y,        0, 1,0),
+  SLIP_FRAME_FIELD(O_CX,          4,FIELD_RAW, c_x,          0, 1,0),
+  SLIP_FRAME_FIELD(O_CY,          4,FIELD_RAW, c_y,          0, 1,0),
+  SLIP_FRAME_FIELD(O_TRIGGER,     4,FIELD_RAW, trigger,      0, 1,0),
+  SLIP_FRAME_FIELD(O_BUTTONS,     2,FIELD_RAW, buttons,      0, 1,0),
+  SLIP_FRAME_FIELD(O_PHYS_L,      4,FIELD_RAW, phys_l,       0, 1,0),
+  SLIP_FRAME_FIELD(O_PHYS_R,      4,FIELD_RAW, phys_r,       0, 1,0),
+  SLIP_FRAME_FIELD(O_UCF_ANALOG,  1,FIELD_RAW, ucf_x,        1, 2,0),
+  SLIP_FRAME_FIELD(O_DAMAGE_PRE,  4,FIELD_RAW, percent_pre,  1, 4,0),
+};
+
+//Post-frame fields
+inline constexpr FrameField POST_FRAME_FIELDS[] = {
+  SLIP_FRAME_FIELD(O_INT_CHAR_ID,   1,FIELD_RAW, char_id,       0, 1,0),
+  SLIP_FRAME_FIELD(O_ACTION_POST,   2,FIELD_RAW, action_post,   0, 1,0),
+  SLIP_FRAME_FIELD(O_XPOS_POST,     4,FIELD_RAW, pos_x_post,    0, 1,0),
+  SLIP_FRAME_FIELD(O_YPOS_POST,     4,FIELD_RAW, pos_y_post,    0, 1,0),
+  SLIP_FRAME_FIELD(O_FACING_POST,   4,FIELD_RAW, face_dir_post, 0, 1,0),
+  SLIP_FRAME_FIELD(O_DAMAGE_POST,   4,FIELD_RAW, percent_post,  0, 1,0),
+  SLIP_FRAME_FIELD(O_SHIELD,        4,FIELD_RAW, shield,        0, 1,0),
+  SLIP_FRAME_FIELD(O_LAST_HIT_ID,   1,FIELD_RAW, hit_with,      0, 1,0),
+  SLIP_FRAME_FIELD(O_COMBO,         1,FIELD_RAW, combo,         0, 1,0),
+  SLIP_FRAME_FIELD(O_LAST_HIT_BY,   1,FIELD_RAW, hurt_by,       0, 1,0),
+  SLIP_FRAME_FIELD(O_STOCKS,        1,FIELD_RAW, stocks,        0, 1,0),
+  SLIP_FRAME_FIELD(O_ACTION_FRAMES, 4,FIELD_RAW, action_fc,     0, 2,0),
+  SLIP_FRAME_FIELD(O_STATE_BITS_1,  1,FIELD_RAW, flags_1,       2, 0,0),
+  SLIP_FRAME_FIELD(O_STATE_BITS_2,  1,FIELD_RAW, flags_2,       2, 0,0),
+  SLIP_FRAME_FIELD(O_STATE_BITS_3,  1,FIELD_RAW, flags_3,       2, 0,0),
+  SLIP_FRAME_FIELD(O_STATE_BITS_4,  1,FIELD_RAW, flags_4,       2, 0,0),
+  SLIP_FRAME_FIELD(O_STATE_BITS_5,  1,FIELD_RAW, flags_5,       2, 0,0),
+  SLIP_FRAME_FIELD(O_HITSTUN,       4,FIELD_RAW, hitstun,       2, 0,0),
+  SLIP_FRAME_FIELD(O_AIRBORNE,      1,FIELD_BOOL,airborne,      2, 0,0),
+  SLIP_FRAME_FIELD(O_GROUND_ID,     2,FIELD_RAW, ground_id,     2, 0,0),
+  SLIP_FRAME_FIELD(O_JUMPS,         1,FIELD_RAW, jumps,         2, 0,0),
+  SLIP_FRAME_FIELD(O_LCANCEL,       1,FIELD_RAW, l_cancel,      2, 0,0),
+  SLIP_FRAME_FIELD(O_HURTBOX,       1,FIELD_RAW, hurtbox,       2, 1,0),
+  SLIP_FRAME_FIELD(O_SELF_AIR_X,    4,FIELD_RAW, self_air_x,    3, 5,0),
+  SLIP_FRAME_FIELD(O_SELF_AIR_Y,    4,FIELD_RAW, self_air_y,    3, 5,0),
+  SLIP_FRAME_FIELD(O_ATTACK_X,      4,FIELD_RAW, attack_x,      3, 5,0),
+  SLIP_FRAME_FIELD(O_ATTACK_Y,      4,FIELD_RAW, attack_y,      3, 5,0),
+  SLIP_FRAME_FIELD(O_SELF_GROUND_X, 4,FIELD_RAW, self_grd_x,    3, 5,0),
+  SLIP_FRAME_FIELD(O_HITLAG,        4,FIELD_RAW, hitlag,        3, 8,0),
+  SLIP_FRAME_FIELD(O_ANIM_INDEX,    4,FIELD_RAW, anim_index,    3,11,0),
+};
+
+//Item update fields (item type and spawn id belong to the SlippiItem, not its frames)
+inline constexpr FrameField ITEM_FRAME_FIELDS[] = {
+  SLIP_ITEM_FIELD(O_FRAME,         4,FIELD_RAW, frame,    3, 0,0),
+  SLIP_ITEM_FIELD(O_ITEM_STATE,    1,FIELD_RAW, state,    3, 0,0),
+  SLIP_ITEM_FIELD(O_ITEM_FACING,   4,FIELD_RAW, face_dir, 3, 0,0),
+  SLIP_ITEM_FIELD(O_ITEM_XVEL,     4,FIELD_RAW, xvel,     3, 0,0),
+  SLIP_ITEM_FIELD(O_ITEM_YVEL,     4,FIELD_RAW, yvel,     3, 0,0),
+  SLIP_ITEM_FIELD(O_ITEM_XPOS,     4,FIELD_RAW, xpos,     3, 0,0),
+  SLIP_ITEM_FIELD(O_ITEM_YPOS,     4,FIELD_RAW, ypos,     3, 0,0),
+  SLIP_ITEM_FIELD(O_ITEM_DAMAGE,   2,FIELD_RAW, damage,   3, 0,0),
+  SLIP_ITEM_FIELD(O_ITEM_EXPIRE,   4,FIELD_RAW, expire,   3, 0,0),
+  SLIP_ITEM_FIELD(O_ITEM_MISC+0,   1,FIELD_RAW, flags_1,  3, 2,0),
+  SLIP_ITEM_FIELD(O_ITEM_MISC+1,   1,FIELD_RAW, flags_2,  3, 2,0),
+  SLIP_ITEM_FIELD(O_ITEM_MISC+2,   1,FIELD_RAW, flags_3,  3, 2,0),
+  SLIP_ITEM_FIELD(O_ITEM_MISC+3,   1,FIELD_RAW, flags_4,  3, 2,0),
+  SLIP_ITEM_FIELD(O_ITEM_OWNER,    1,FIELD_RAW, owner,    3, 6,0),
+};
+
+#undef SLIP_ITEM_FIELD
+#undef SLIP_FRAME_FIELD
+#undef SLIP_FIELD
+
+constexpr unsigned N_PRE_FRAME_FIELDS  = sizeof(PRE_FRAME_FIELDS)  / sizeof(FrameField);
+constexpr unsigned N_POST_FRAME_FIELDS = sizeof(POST_FRAME_FIELDS) / sizeof(FrameField);
+constexpr unsigned N_ITEM_FRAME_FIELDS = sizeof(ITEM_FRAME_FIELDS) / sizeof(FrameField);
+
+//Bulk decoding: the destination struct is split into aligned 16-byte tiles, and each tile is filled
+//  from up to two 16-byte windows of the event with a byte shuffle (which also does the big-endian
+//  swap), blended into the struct so members owned by other events (and padding) are left as they
+//  were. Tiles never overlap, so no store has to be forwarded to a later tile's load.
+const unsigned FRAME_TILE        = 16;
+const unsigned FRAME_MAX_TILES   = sizeof(SlippiFrame) / FRAME_TILE;  //SlippiFrame is the largest destination
+const unsigned FRAME_MAX_WINDOWS = 2;
+const unsigned FRAME_MAX_FIXUPS  = 64;
+const unsigned FRAME_MAX_BANDS   = 8;
+
+//One tile of the destination struct and the event windows it's shuffled from
+struct FrameTile {
+  uint16_t dst                                  = 0;  //Offset of the tile within the destination
+  uint16_t n_windows                            = 0;
+  uint16_t src[FRAME_MAX_WINDOWS]               = {}; //Offset of each source window within the event
+  uint8_t  shuf[FRAME_MAX_WINDOWS][FRAME_TILE]  = {}; //pshufb control: dest byte i takes window byte shuf[w][i] (0x80 = none)
+  uint8_t  keep[FRAME_TILE]                     = {}; //0xFF for dest bytes that keep their current value
+};
+
+//Tiles for one event layout at one event size
+struct FrameLayout {
+  const FrameField* fields                    = nullptr;
+  unsigned          n_fields                  = 0;
+  unsigned          dest_size                 = 0;  //Size of the destination struct
+  unsigned          ev_size                   = 0;  //Event size the tiles were built for
+  unsigned          n_active                  = 0;  //Number of fields present in events of this size
+  unsigned          n_tiles                   = 0;
+  unsigned          n_fixups                  = 0;
+  FrameTile         tiles[FRAME_MAX_TILES]    = {};
+  uint8_t           fixups[FRAME_MAX_FIXUPS]  = {}; //Fields done after the tiles: bools, and any that didn't fit a tile
+};
+
+//Place field fd in its tile, opening a new window if none covers it; false if it can't be placed
+constexpr bool _placeFrameField(FrameLayout& l, const FrameField& fd) {
+  unsigned dst = fd.dest - fd.dest % FRAME_TILE;
+  if (fd.dest + fd.width > dst + FRAME_TILE || dst + FRAME_TILE > l.dest_size) {
+    return false;  //Straddles a tile, or lies in the partial tile at the end of the struct
+  }
+  if (l.n_tiles == 0 || l.tiles[l.n_tiles-1].dst != dst) {
+    if (l.n_tiles == FRAME_MAX_TILES) {
+      return false;
+    }
+    FrameTile& t = l.tiles[l.n_tiles++];
+    t.dst        = uint16_t(dst);
+    for (unsigned i = 0; i < FRAME_TILE; ++i) {
+      t.shuf[0][i] = t.shuf[1][i] = 0x80;
+      t.keep[i]    = 0xFF;
+    }
+  }
+  FrameTile& t = l.tiles[l.n_tiles-1];
+  unsigned   w = 0;
+  while (w < t.n_windows && (fd.off < t.src[w] || fd.off + fd.width > t.src[w] + FRAME_TILE)) {
+    ++w;
+  }
+  if (w == t.n_windows) {
+    if (w == FRAME_MAX_WINDOWS) {
+      return false;
+    }
+    //Never read past the event; an unused second window just reloads the first
+    t.src[t.n_windows++] = uint16_t(fd.off + FRAME_TILE > l.ev_size ? l.ev_size - FRAME_TILE : fd.off);
+    if (w == 0) {
+      t.src[1] = t.src[0];
+    }
+  }
+  for (unsigned i = 0; i < fd.width; ++i) {
+    unsigned d   = fd.dest - dst + i;
+    t.shuf[w][d] = uint8_t(fd.off - t.src[w] + fd.width - 1 - i);
+    t.keep[d]    = 0;
+  }
+  return true;
+}
+
+//Lay out the tiles for the fields present in events of ev_size bytes (command byte included)
+constexpr FrameLayout buildFrameLayout(const FrameField* fields, unsigned n_fields, unsigned dest_size, unsigned ev_size) {
+  FrameLayout l;
+  l.fields    = fields;
+  l.n_fields  = n_fields;
+  l.dest_size = dest_size;
+  l.ev_size   = ev_size;
+  while (l.n_active < n_fields && fields[l.n_active].off + fields[l.n_active].width <= ev_size) {
+    ++l.n_active;
+  }
+  bool tiled = (ev_size >= FRAME_TILE && dest_size >= FRAME_TILE);  //Else too small for a window
+  for (unsigned f = 0; f < l.n_active && l.n_fixups < FRAME_MAX_FIXUPS; ++f) {
+    //Bools still go through a tile (as a raw byte) so the fixup is the only extra store
+    if (!tiled || !_placeFrameField(l,fields[f]) || fields[f].kind == FIELD_BOOL) {
+      l.fixups[l.n_fixups++] = uint8_t(f);
+    }
+  }
+  return l;
+}
+
+//Compile-time layouts for every version band of an event: band i holds the fields introduced up to
+//  version[i], so one replay only ever uses one band and its field set is fixed at compile time
+struct FrameBands {
+  const FrameField* fields                    = nullptr;
+  unsigned          n_fields                  = 0;
+  unsigned          n_bands                   = 0;
+  uint32_t          version[FRAME_MAX_BANDS]  = {}; //First version of each band
+  FrameLayout       layout[FRAME_MAX_BANDS]   = {};
+};
+
+constexpr FrameBands buildFrameBands(const FrameField* fields, unsigned n_fields, unsigned dest_size) {
+  FrameBands b;
+  b.fields   = fields;
+  b.n_fields = n_fields;
+  for (unsigned f = 0; f < n_fields && b.n_bands < FRAME_MAX_BANDS; ++f) {
+    if (f + 1 < n_fields && fields[f+1].min_version == fields[f].min_version) {
+      continue;  //Band ends at the last field of its version
+    }
+    b.version[b.n_bands]  = fields[f].min_version;
+    b.layout[b.n_bands++] = buildFrameLayout(fields,n_fields,dest_size,fields[f].off + fields[f].width);
+  }
+  return b;
+}
+
+//Check the assumptions the bands are built on
+constexpr bool validFrameFields(const FrameField* fields, unsigned n_fields, unsigned dest_size) {
+  unsigned n_versions = 1;
+  for (unsigned f = 0; f < n_fields; ++f) {
+    if (fields[f].dest + fields[f].width > dest_size) {
+      return false;
+    }
+    if (f > 0) {
+      if (fields[f].off < fields[f-1].off + fields[f-1].width || fields[f].min_version < fields[f-1].min_version) {
+        return false;
+      }
+      n_versions += (fields[f].min_version != fields[f-1].min_version);
+    }
+  }
+  return n_fields > 0 && n_versions <= FRAME_MAX_BANDS;
+}
+
+static_assert(validFrameFields(PRE_FRAME_FIELDS, N_PRE_FRAME_FIELDS, sizeof(SlippiFrame)),     "bad pre-frame field table");
+static_assert(validFrameFields(POST_FRAME_FIELDS,N_POST_FRAME_FIELDS,sizeof(SlippiFrame)),     "bad post-frame field table");
+static_assert(validFrameFields(ITEM_FRAME_FIELDS,N_ITEM_FRAME_FIELDS,sizeof(SlippiItemFrame)), "bad item field table");
+
+inline constexpr FrameBands PRE_FRAME_BANDS  = buildFrameBands(PRE_FRAME_FIELDS, N_PRE_FRAME_FIELDS, sizeof(SlippiFrame));
+inline constexpr FrameBands POST_FRAME_BANDS = buildFrameBands(POST_FRAME_FIELDS,N_POST_FRAME_FIELDS,sizeof(SlippiFrame));
+inline constexpr FrameBands ITEM_FRAME_BANDS = buildFrameBands(ITEM_FRAME_FIELDS,N_ITEM_FRAME_FIELDS,sizeof(SlippiItemFrame));
+
+//Index of the newest band whose events are no newer than the given version (0 if it predates them all)
+constexpr unsigned frameBandForVersion(const FrameBands& b, uint32_t version) {
+  unsigned band = 0;
+  while (band + 1 < b.n_bands && b.version[band+1] <= version) {
+    ++band;
+  }
+  return band;
+}
+
+inline void decodeFrameField(const FrameField& fd, const char* ev, char* dest) {
+  switch(fd.width) {
+    case 4: {
+      uint32_t v;
+      memcpy(&v,&ev[fd.off],4);
+      v = swap32(v);
+      memcpy(&dest[fd.dest],&v,4);
+      break;
+    }
+    case 2: {
+      uint16_t v;
+      memcpy(&v,&ev[fd.off],2);
+      v = swap16(v);
+      memcpy(&dest[fd.dest],&v,2);
+      break;
+    }
+    default:
+      if (fd.kind == FIELD_BOOL) {
+        bool b = ev[fd.off] != 0;
+        memcpy(&dest[fd.dest],&b,1);
+      } else {
+        dest[fd.dest] = ev[fd.off];
+      }
+  }
+}
+
+//Scalar decoding of a compile-time band: unrolled, with every offset and width a constant
+template<const FrameBands& B, unsigned BAND, std::size_t... F>
+inline void _decodeFrameBandScalar(const char* ev, char* dest, std::index_sequence<F...>) {
+  (decodeFrameField(B.fields[F],ev,dest), ...);
+}
+
+template<const FrameBands& B, unsigned BAND>
+inline void decodeFrameBandScalar(const char* ev, char* dest) {
+  _decodeFrameBandScalar<B,BAND>(ev,dest,std::make_index_sequence<B.layout[BAND].n_active>());
+}
+
+#ifdef SLIP_X86
+SLIP_TARGET_SSSE3 inline void _decodeFrameTile(const FrameTile& t, const char* ev, char* dest) {
+  __m128i* out  = reinterpret_cast<__m128i*>(&dest[t.dst]);
+  __m128i  win0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&ev[t.src[0]]));
+  __m128i  win1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&ev[t.src[1]]));
+  __m128i  v    = _mm_and_si128(_mm_loadu_si128(out),_mm_loadu_si128(reinterpret_cast<const __m128i*>(t.keep)));
+  //Both windows are always applied; an unused one has an all-0x80 control and shuffles in zeros
+  v = _mm_or_si128(v,_mm_shuffle_epi8(win0,_mm_loadu_si128(reinterpret_cast<const __m128i*>(t.shuf[0]))));
+  v = _mm_or_si128(v,_mm_shuffle_epi8(win1,_mm_loadu_si128(reinterpret_cast<const __m128i*>(t.shuf[1]))));
+  _mm_storeu_si128(out,v);
+}
+
+//Layout only known at runtime (event sizes that don't match any band)
+SLIP_TARGET_SSSE3 inline void decodeFrameSSSE3(const FrameLayout& l, const char* ev, char* dest) {
+  for (unsigned i = 0; i < l.n_tiles; ++i) {
+    _decodeFrameTile(l.tiles[i],ev,dest);
+  }
+  for (unsigned i = 0; i < l.n_fixups; ++i) {
+    decodeFrameField(l.fields[l.fixups[i]],ev,dest);
+  }
+}
+
+//Compile-time band: tiles and fixups are unrolled and their controls are constants
+template<const FrameBands& B, unsigned BAND, std::size_t... T, std::size_t... F>
+SLIP_TARGET_SSSE3 inline void _decodeFrameBandSSSE3(const char* ev, char* dest, std::index_sequence<T...>, std::index_sequence<F...>) {
+  (_decodeFrameTile(B.layout[BAND].tiles[T],ev,dest), ...);
+  (decodeFrameField(B.fields[B.layout[BAND].fixups[F]],ev,dest), ...);
+}
+
+template<const FrameBands& B, unsigned BAND>
+SLIP_TARGET_SSSE3 inline void decodeFrameBandSSSE3(const char* ev, char* dest) {
+  _decodeFrameBandSSSE3<B,BAND>(ev,dest,
+    std::make_index_sequence<B.layout[BAND].n_tiles>(),std::make_index_sequence<B.layout[BAND].n_fixups>());
+}
+#endif
+
+//Decoder for one event layout with bands B, into structs of type T. The band is picked once per
+//  replay (from its version and event size); the newest band is inlined, older ones go through a
+//  table of their compile-time instantiations.
+template<typename T, const FrameBands& B>
+class FrameDecoder {
+public:
+  typedef void (*DecodeFunc)(const char* ev, char* dest);
+
+private:
+  static const unsigned NEWEST = B.n_bands - 1;
+
+  uint32_t    _version = UINT32_MAX;  //Version of the replay being decoded (newest band until it's set)
+  unsigned    _ev_size = 0;           //Event size _band was picked for
+  int         _band    = -1;          //Band for this replay, or -1 if its event size matches no band
+  FrameLayout _layout;                //Runtime layout when _band is -1
+
+  template<std::size_t... I>
+  static const DecodeFunc* _scalarFuncs(std::index_sequence<I...>) {
+    static const DecodeFunc funcs[] = { &decodeFrameBandScalar<B,I>... };
+    return funcs;
+  }
+
+#ifdef SLIP_X86
+  template<std::size_t... I>
+  static const DecodeFunc* _ssse3Funcs(std::index_sequence<I...>) {
+    static const DecodeFunc funcs[] = { &decodeFrameBandSSSE3<B,I>... };
+    return funcs;
+  }
+#endif
+
+  inline void _pickBand(unsigned ev_size) {
+    unsigned version_band = frameBandForVersion(B,_version);
+    _ev_size = ev_size;
+    _band    = int(version_band);
+    if (B.layout[version_band].ev_size > ev_size) {
+      //Payload is shorter than the version says (e.g., hacked or truncated events); decode whatever fits
+      _band   = -1;
+      _layout = buildFrameLayout(B.fields,B.n_fields,sizeof(T),ev_size);
+    }
+  }
+
+public:
+  //Set the version of the replay about to be decoded
+  inline void setVersion(uint8_t maj, uint8_t min, uint8_t rev) {
+    _version = slippiVersion(maj,min,rev);
+    _ev_size = 0;
+  }
+
+  //Band this decoder will use for events of ev_size bytes, or -1 for the generic path
+  inline int band(unsigned ev_size) {
+    if (ev_size != _ev_size) {
+      _pickBand(ev_size);
+    }
+    return _band;
+  }
+
+  //Decode function for a compile-time band
+  static inline DecodeFunc bandFunc(unsigned band, SimdLevel level = simdLevel()) {
+#ifdef SLIP_X86
+    if (level >= SIMD_SSSE3) {
+      return _ssse3Funcs(std::make_index_sequence<B.n_bands>())[band];
+    }
+#endif
+    return _scalarFuncs(std::make_index_sequence<B.n_bands>())[band];
+  }
+
+  //Decode one event of ev_size bytes (command byte included) into out; fields the event is too
+  //  short to contain are left untouched. Callers keep their own version-specific handling
+  //  (e.g., marking the frame alive, frame-number offsets) on top of this.
+  inline void decode(const char* ev, unsigned ev_size, T& out, SimdLevel level = simdLevel()) {
+    char* dest = reinterpret_cast<char*>(&out);
+    int   b    = band(ev_size);
+#ifdef SLIP_X86
+    if (level >= SIMD_SSSE3) {
+      if (b == int(NEWEST)) {
+        decodeFrameBandSSSE3<B,NEWEST>(ev,dest);
+      } else if (b >= 0) {
+        bandFunc(b,level)(ev,dest);
+      } else {
+        decodeFrameSSSE3(_layout,ev,dest);
+      }
+      return;
+    }
+#endif
+    if (b == int(NEWEST)) {
+      decodeFrameBandScalar<B,NEWEST>(ev,dest);
+    } else if (b >= 0) {
+      bandFunc(b,level)(ev,dest);
+    } else {
+      for (unsigned i = 0; i < _layout.n_active; ++i) {
+        decodeFrameField(B.fields[i],ev,dest);
+      }
+    }
+  }
+};
+
+//Decoders for pre-frame, post-frame and item events, one set per event reader (e.g., a LiveParser)
+struct FrameDecoders {
+  FrameDecoder<SlippiFrame,PRE_FRAME_BANDS>      pre;
+  FrameDecoder<SlippiFrame,POST_FRAME_BANDS>     post;
+  FrameDecoder<SlippiItemFrame,ITEM_FRAME_BANDS> item;
+
+  inline void setVersion(uint8_t maj, uint8_t min, uint8_t rev) {
+    pre.setVersion(maj,min,rev);
+    post.setVersion(maj,min,rev);
+    item.setVersion(maj,min,rev);
+  }
+};
+
+}
+
+#endif /* FRAMEDECODE_H_ */
@@ -0,0 +1,208 @@
+#ifndef FRAMELOOP_H_
+#define FRAMELOOP_H_
+
+#include <cstdint>
+#include <utility>
+
+#include "enums.h"
+#include "eventstream.h"
+#include "framedecode.h"
+
+// Replay File (.slp) Spec: https://github.com/project-slippi/slippi-wiki/blob/master/SPEC.md
+
+namespace slip {
+
+//Frame event loop specialized per Slippi version band
+//  -> the version is checked once per replay to pick an instantiation of the loop whose pre-frame,
+//     post-frame and item field sets are fixed at compile time; replays whose payload sizes don't
+//     match their version fall back to a generic loop that checks each field's version per event
+//
+//A sink tells the loop where events go (derive from FrameSink and hide the members you need):
+//  SlippiFrame*     preFrame(const char* ev)   //Destination for a pre-frame event, or nullptr to skip it
+//  SlippiFrame*     postFrame(const char* ev)  //Destination for a post-frame event, or nullptr to skip it
+//  SlippiItemFrame* itemFrame(const char* ev)  //Destination for an item update, or nullptr to skip it
+//  void             *Done(const char* ev, T&)  //Called with each destination once it's been decoded
+//  bool             event(const EventStream&)  //Any other event; return false to stop the loop
+struct FrameSink {
+  inline SlippiFrame*     preFrame(const char*)  { return nullptr; }
+  inline SlippiFrame*     postFrame(const char*) { return nullptr; }
+  inline SlippiItemFrame* itemFrame(const char*) { return nullptr; }
+  inline void             preFrameDone(const char*, SlippiFrame&)      {}
+  inline void             postFrameDone(const char*, SlippiFrame&)     {}
+  inline void             itemFrameDone(const char*, SlippiItemFrame&) {}
+  inline bool             event(const EventStream&) { return true; }
+};
+
+//Every version at which any frame or item event gained fields, in increasing order
+struct FrameLoopVersions {
+  unsigned n                                   = 0;
+  uint32_t version[3*FRAME_MAX_BANDS]          = {};
+};
+
+constexpr FrameLoopVersions buildFrameLoopVersions() {
+  const FrameBands* bands[] = { &PRE_FRAME_BANDS, &POST_FRAME_BANDS, &ITEM_FRAME_BANDS };
+  FrameLoopVersions v;
+  uint32_t last = 0;
+  while (true) {
+    //Next smallest band version after the last one we added
+    uint32_t next = UINT32_MAX;
+    for (const FrameBands* b : bands) {
+      for (unsigned i = 0; i < b->n_bands; ++i) {
+        if ((v.n == 0 || b->version[i] > last) && b->version[i] < next) {
+          next = b->version[i];
+        }
+      }
+    }
+    if (next == UINT32_MAX) {
+      return v;
+    }
+    v.version[v.n++] = next;
+    last             = next;
+  }
+}
+
+inline constexpr FrameLoopVersions FRAME_LOOP_VERSIONS = buildFrameLoopVersions();
+
+//Index of the version band a replay of this version belongs to
+constexpr unsigned frameLoopBand(uint32_t version) {
+  unsigned band = 0;
+  while (band + 1 < FRAME_LOOP_VERSIONS.n && FRAME_LOOP_VERSIONS.version[band+1] <= version) {
+    ++band;
+  }
+  return band;
+}
+
+//Decode one event with a compile-time band
+template<const FrameBands& B, unsigned BAND, bool SSSE3>
+inline void _decodeFrameBand(const char* ev, char* dest) {
+#ifdef SLIP_X86
+  if (SSSE3) {
+    decodeFrameBandSSSE3<B,BAND>(ev,dest);
+    return;
+  }
+#endif
+  decodeFrameBandScalar<B,BAND>(ev,dest);
+}
+
+//Whether a replay's payload sizes hold every field its version band expects
+inline bool frameLoopFits(const EventStream& s, unsigned band) {
+  uint32_t version = FRAME_LOOP_VERSIONS.version[band];
+  unsigned pre     = frameBandForVersion(PRE_FRAME_BANDS,version);
+  unsigned post    = frameBandForVersion(POST_FRAME_BANDS,version);
+  unsigned item    = frameBandForVersion(ITEM_FRAME_BANDS,version);
+  return (1u + s.payloadSize(Event::PRE_FRAME)  >= PRE_FRAME_BANDS.layout[pre].ev_size)
+      && (1u + s.payloadSize(Event::POST_FRAME) >= POST_FRAME_BANDS.layout[post].ev_size)
+      && (s.payloadSize(Event::ITEM_UPDATE) == 0 || version < ITEM_FRAME_BANDS.version[0] ||
+          1u + s.payloadSize(Event::ITEM_UPDATE) >= ITEM_FRAME_BANDS.layout[item].ev_size);
+}
+
+//Loop instantiated for one version band
+template<unsigned BAND, bool SSSE3, typename Sink>
+inline bool _frameLoop(EventStream& s, Sink& sink) {
+  constexpr uint32_t VERSION = FRAME_LOOP_VERSIONS.version[BAND];
+  constexpr unsigned PRE     = frameBandForVersion(PRE_FRAME_BANDS,VERSION);
+  constexpr unsigned POST    = frameBandForVersion(POST_FRAME_BANDS,VERSION);
+  constexpr unsigned ITEM    = frameBandForVersion(ITEM_FRAME_BANDS,VERSION);
+  constexpr bool     ITEMS   = VERSION >= ITEM_FRAME_BANDS.version[0];
+  for (; s.valid(); s.next()) {
+    const char* ev = s.data();
+    switch(s.code()) {
+      case Event::PRE_FRAME:
+        if (SlippiFrame* f = sink.preFrame(ev)) {
+          _decodeFrameBand<PRE_FRAME_BANDS,PRE,SSSE3>(ev,reinterpret_cast<char*>(f));
+          sink.preFrameDone(ev,*f);
+        }
+        break;
+      case Event::POST_FRAME:
+        if (SlippiFrame* f = sink.postFrame(ev)) {
+          _decodeFrameBand<POST_FRAME_BANDS,POST,SSSE3>(ev,reinterpret_cast<char*>(f));
+          sink.postFrameDone(ev,*f);
+        }
+        break;
+      case Event::ITEM_UPDATE:
+        if (!ITEMS) {
+          if (!sink.event(s)) { return false; }
+        } else if (SlippiItemFrame* f = sink.itemFrame(ev)) {
+          _decodeFrameBand<ITEM_FRAME_BANDS,ITEM,SSSE3>(ev,reinterpret_cast<char*>(f));
+          sink.itemFrameDone(ev,*f);
+        }
+        break;
+      default:
+        if (!sink.event(s)) { return false; }
+    }
+  }
+  return true;
+}
+
+//Decode the fields of an event that exist in this version and fit in its payload
+inline void _decodeFieldsChecked(const FrameField* fields, unsigned n_fields, uint32_t version, unsigned ev_size, const char* ev, char* dest) {
+  for (unsigned i = 0; i < n_fields; ++i) {
+    if (fields[i].min_version <= version && fields[i].off + fields[i].width <= ev_size) {
+      decodeFrameField(fields[i],ev,dest);
+    }
+  }
+}
+
+//Generic loop: any version and payload sizes, checking each field per event
+template<typename Sink>
+inline bool runFrameLoopGeneric(EventStream& s, uint32_t version, Sink& sink) {
+  for (; s.valid(); s.next()) {
+    const char* ev = s.data();
+    switch(s.code()) {
+      case Event::PRE_FRAME:
+        if (SlippiFrame* f = sink.preFrame(ev)) {
+          _decodeFieldsChecked(PRE_FRAME_FIELDS,N_PRE_FRAME_FIELDS,version,s.eventSize(),ev,reinterpret_cast<char*>(f));
+          sink.preFrameDone(ev,*f);
+        }
+        break;
+      case Event::POST_FRAME:
+        if (SlippiFrame* f = sink.postFrame(ev)) {
+          _decodeFieldsChecked(POST_FRAME_FIELDS,N_POST_FRAME_FIELDS,version,s.eventSize(),ev,reinterpret_cast<char*>(f));
+          sink.postFrameDone(ev,*f);
+        }
+        break;
+      case Event::ITEM_UPDATE:
+        if (version < ITEM_FRAME_BANDS.version[0]) {
+          if (!sink.event(s)) { return false; }
+        } else if (SlippiItemFrame* f = sink.itemFrame(ev)) {
+          _decodeFieldsChecked(ITEM_FRAME_FIELDS,N_ITEM_FRAME_FIELDS,version,s.eventSize(),ev,reinterpret_cast<char*>(f));
+          sink.itemFrameDone(ev,*f);
+        }
+        break;
+      default:
+        if (!sink.event(s)) { return false; }
+    }
+  }
+  return true;
+}
+
+template<typename Sink>
+using FrameLoopFunc = bool (*)(EventStream& s, Sink& sink);
+
+template<typename Sink, std::size_t... I>
+inline FrameLoopFunc<Sink> _frameLoopFunc(unsigned band, bool ssse3, std::index_sequence<I...>) {
+  static const FrameLoopFunc<Sink> scalar[] = { &_frameLoop<I,false,Sink>... };
+#ifdef SLIP_X86
+  static const FrameLoopFunc<Sink> vector[] = { &_frameLoop<I,true,Sink>... };
+  if (ssse3) {
+    return vector[band];
+  }
+#endif
+  return scalar[band];
+}
+
+//Run the loop instantiation for this replay's version from the stream's current event to the end
+//  of the raw events; returns false if the sink stopped it early
+template<typename Sink>
+inline bool runFrameLoop(EventStream& s, uint8_t maj, uint8_t min, uint8_t rev, Sink& sink, SimdLevel level = simdLevel()) {
+  uint32_t version = slippiVersion(maj,min,rev);
+  unsigned band    = frameLoopBand(version);
+  if (version < FRAME_LOOP_VERSIONS.version[0] || !frameLoopFits(s,band)) {
+    return runFrameLoopGeneric(s,version,sink);
+  }
+  return _frameLoopFunc<Sink>(band,level >= SIMD_SSSE3,std::make_index_sequence<FRAME_LOOP_VERSIONS.n>())(s,sink);
+}
+
+}
+
+#endif /* FRAMELOOP_H_ */
@@ -0,0 +1,351 @@
+#ifndef JSONWRITER_H_
+#define JSONWRITER_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <charconv>
+#include <string>
+
+#include "util.h"
+#include "simd.h"
+
+// Streaming JSON writer: values are formatted straight into a fixed buffer that is handed to a sink
+//   (a FILE*, a std::string, a callback, or nothing at all for a caller-owned buffer) whenever it
+//   fills up, so output of any size needs no more memory than the buffer. Commas, colons and
+//   indentation are inserted automatically from the begin/end/key/value call sequence.
+
+const size_t   JSON_BUFFER_SIZE = 1 << 16;  //Default output buffer size
+const unsigned JSON_MAX_DEPTH   = 64;       //Maximum nesting of objects and arrays
+
+namespace slip {
+
+//Whether a byte must be escaped inside a JSON string
+inline bool jsonNeedsEscape(char c) {
+  return c == '"' || c == '\\' || (c >= '\x00' && c <= '\x1f');
+}
+
+//Length of the run of bytes at the start of s that don't need escaping
+inline size_t jsonCleanRunScalar(const char* s, size_t n) {
+  size_t i = 0;
+  while (i < n && !jsonNeedsEscape(s[i])) {
+    ++i;
+  }
+  return i;
+}
+
+#ifdef SLIP_X86
+SLIP_TARGET_SSE2 inline size_t jsonCleanRunSSE2(const char* s, size_t n) {
+  const __m128i quote     = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control   = _mm_set1_epi8(0x1f);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    //Unsigned v <= 0x1f is min(v,0x1f) == v; bytes >= 0x80 are UTF-8 and pass through
+    __m128i m = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v,quote),_mm_cmpeq_epi8(v,backslash)),
+      _mm_cmpeq_epi8(_mm_min_epu8(v,control),v));
+    unsigned mask = unsigned(_mm_movemask_epi8(m));
+    if (mask != 0) {
+#ifdef _MSC_VER
+      unsigned long bit;
+      _BitScanForward(&bit,mask);
+      return i + bit;
+#else
+      return i + unsigned(__builtin_ctz(mask));
+#endif
+    }
+  }
+  return i + jsonCleanRunScalar(s + i, n - i);
+}
+#endif
+
+inline size_t jsonCleanRun(const char* s, size_t n, SimdLevel level = simdLevel()) {
+#ifdef SLIP_X86
+  if (level >= SIMD_SSE2) {
+    return jsonCleanRunSSE2(s,n);
+  }
+#endif
+  return jsonCleanRunScalar(s,n);
+}
+
+class JsonWriter {
+public:
+  //Receives each full buffer; returns false if the data couldn't be written
+  typedef bool (*FlushFunc)(void* ctx, const char* data, size_t size);
+
+private:
+  char*     _buf;                          //Output buffer
+  size_t    _cap;                          //Size of the output buffer
+  size_t    _len        = 0;               //Bytes in the output buffer
+  size_t    _flushed    = 0;               //Bytes already handed to the sink
+  bool      _owns_buf;                     //Whether we allocated the output buffer
+  FlushFunc _flush;                        //Sink (nullptr for a caller-owned buffer)
+  void*     _ctx;                          //Sink context
+  bool      _ok         = true;            //False once anything failed to fit or write
+  unsigned  _indent;                       //Spaces per nesting level (0 == compact)
+  unsigned  _depth      = 0;               //Current nesting level
+  bool      _after_key  = false;           //Whether the next value completes a key
+  bool      _empty[JSON_MAX_DEPTH+1];      //Whether each open object / array has no members yet
+  SimdLevel _level;                        //Instruction set used for escaping
+
+  static inline bool _flushFile(void* ctx, const char* data, size_t size) {
+    return fwrite(data,1,size,static_cast<FILE*>(ctx)) == size;
+  }
+  static inline bool _flushString(void* ctx, const char* data, size_t size) {
+    static_cast<std::string*>(ctx)->append(data,size);
+    return true;
+  }
+
+  inline void _init() {
+    _empty[0] = true;
+  }
+
+  //Make room for n bytes (n <= _cap); false if there's no sink to flush to
+  inline bool _reserve(size_t n) {
+    if (_len + n <= _cap) {
+      return true;
+    }
+    if (!flush() || _len + n > _cap) {
+      _ok = false;
+      return false;
+    }
+    return true;
+  }
+
+  inline void _put(char c) {
+    if (_len < _cap || _reserve(1)) {
+      _buf[_len++] = c;
+    }
+  }
+
+  inline void _write(const char* s, size_t n) {
+    while (n > 0 && _ok) {
+      if (_len == _cap && !_reserve(1)) {
+        return;
+      }
+      size_t chunk = std::min(n,_cap - _len);
+      memcpy(&_buf[_len],s,chunk);
+      _len += chunk;
+      s    += chunk;
+      n    -= chunk;
+    }
+  }
+
+  inline void _newline() {
+    if (_indent == 0) {
+      return;
+    }
+    size_t n = 1 + size_t(_indent)*_depth;
+    if (!_reserve(n)) {
+      return;
+    }
+    _buf[_len] = '\n';
+    memset(&_buf[_len+1],' ',n-1);
+    _len += n;
+  }
+
+  //Separator before a value or key at the current level
+  inline void _separate() {
+    if (_after_key) {
+      _after_key = false;
+      return;
+    }
+    if (!_empty[_depth]) {
+      _put(',');
+    }
+    _empty[_depth] = false;
+    if (_depth > 0) {
+      _newline();
+    }
+  }
+
+  inline void _open(char c) {
+    _separate();
+    _put(c);
+    if (_depth == JSON_MAX_DEPTH) {
+      _ok = false;
+      return;
+    }
+    _empty[++_depth] = true;
+  }
+
+  inline void _close(char c) {
+    if (_depth == 0) {
+      _ok = false;
+      return;
+    }
+    bool was_empty = _empty[_depth--];
+    if (!was_empty) {
+      _newline();
+    }
+    _put(c);
+  }
+
+  //Escape sequence for a byte that needs one; returns its length
+  static inline size_t _escape(char c, char* out) {
+    static const char HEX[] = "0123456789abcdef";
+    out[0] = '\\';
+    switch (c) {
+      case '"' : out[1] = '"';  return 2;
+      case '\\': out[1] = '\\'; return 2;
+      case '\b': out[1] = 'b';  return 2;
+      case '\f': out[1] = 'f';  return 2;
+      case '\n': out[1] = 'n';  return 2;
+      case '\r': out[1] = 'r';  return 2;
+      case '\t': out[1] = 't';  return 2;
+      default:
+        memcpy(&out[1],"u00",3);
+        out[4] = HEX[(c >> 4) & 0xf];
+        out[5] = HEX[c & 0xf];
+        return 6;
+    }
+  }
+
+  inline void _escaped(const char* s, size_t n) {
+    //Fast path: room for the worst case (every byte escaped as \u00XX), so no bounds checks
+    if (_len + 6*n + 2 <= _cap || (flush() && _len + 6*n + 2 <= _cap)) {
+      char* out = &_buf[_len];
+      *out++ = '"';
+      while (n > 0) {
+        size_t run = jsonCleanRun(s,n,_level);
+        memcpy(out,s,run);
+        out += run;
+        if (run == n) {
+          break;
+        }
+        out += _escape(s[run],out);
+        s   += run + 1;
+        n   -= run + 1;
+      }
+      *out++ = '"';
+      _len   = size_t(out - _buf);
+      return;
+    }
+    _put('"');
+    while (n > 0) {
+      size_t run = jsonCleanRun(s,n,_level);
+      _write(s,run);
+      if (run == n) {
+        break;
+      }
+      char esc[6];
+      _write(esc,_escape(s[run],esc));
+      s += run + 1;
+      n -= run + 1;
+    }
+    _put('"');
+  }
+
+  template<typename T>
+  inline void _number(T v) {
+    _separate();
+    if (_len + 32 <= _cap || (flush() && _len + 32 <= _cap)) {
+      _len = size_t(std::to_chars(&_buf[_len],&_buf[_len+32],v).ptr - _buf);
+      return;
+    }
+    //Nearly full caller-owned buffer: format aside and copy whatever fits
+    char tmp[32];
+    _write(tmp,size_t(std::to_chars(tmp,tmp+32,v).ptr - tmp));
+  }
+
+  template<typename T>
+  inline void _real(T v) {
+    //JSON has no representation for NaN or infinity
+    if (!std::isfinite(v)) {
+      null();
+      return;
+    }
+    _number(v);
+  }
+
+public:
+  //Write through a FILE* (a file or a pipe); the file is flushed but not closed
+  JsonWriter(FILE* f, unsigned indent = 0, size_t buffer_size = JSON_BUFFER_SIZE)
+    : _buf(new char[buffer_size]), _cap(buffer_size), _owns_buf(true), _flush(_flushFile), _ctx(f),
+      _indent(indent), _level(simdLevel()) { _init(); }
+  //Append to a string
+  JsonWriter(std::string* s, unsigned indent = 0, size_t buffer_size = JSON_BUFFER_SIZE)
+    : _buf(new char[buffer_size]), _cap(buffer_size), _owns_buf(true), _flush(_flushString), _ctx(s),
+      _indent(indent), _level(simdLevel()) { _init(); }
+  //Hand each full buffer to a callback
+  JsonWriter(FlushFunc flush_func, void* ctx, unsigned indent = 0, size_t buffer_size = JSON_BUFFER_SIZE)
+    : _buf(new char[buffer_size]), _cap(buffer_size), _owns_buf(true), _flush(flush_func), _ctx(ctx),
+      _indent(indent), _level(simdLevel()) { _init(); }
+  //Write into a caller-owned buffer; ok() turns false if the output doesn't fit
+  JsonWriter(char* buf, size_t size, unsigned indent = 0)
+    : _buf(buf), _cap(size), _owns_buf(false), _flush(nullptr), _ctx(nullptr),
+      _indent(indent), _level(simdLevel()) { _init(); }
+  ~JsonWriter() {
+    flush();
+    if (_owns_buf) {
+      delete[] _buf;
+    }
+  }
+  JsonWriter(const JsonWriter&)            = delete;
+  JsonWriter& operator=(const JsonWriter&) = delete;
+
+  //Hand everything buffered so far to the sink (no-op for a caller-owned buffer)
+  inline bool flush() {
+    if (_flush == nullptr || _len == 0) {
+      return _ok;
+    }
+    if (!_flush(_ctx,_buf,_len)) {
+      _ok = false;
+    }
+    _flushed += _len;
+    _len      = 0;
+    if (_flush == _flushFile) {
+      fflush(static_cast<FILE*>(_ctx));
+    }
+    return _ok;
+  }
+
+  inline bool   ok()   const { return _ok; }                //Whether everything so far was written
+  inline size_t size() const { return _flushed + _len; }    //Total bytes written
+  inline const char* data() const { return _buf; }          //Unflushed output (all of it for a caller-owned buffer)
+  inline void setSimdLevel(SimdLevel level) { _level = level; }
+
+  inline JsonWriter& beginObject() { _open('{');  return *this; }
+  inline JsonWriter& endObject()   { _close('}'); return *this; }
+  inline JsonWriter& beginArray()  { _open('[');  return *this; }
+  inline JsonWriter& endArray()    { _close(']'); return *this; }
+
+  inline JsonWriter& key(const char* k, size_t n) {
+    _separate();
+    _escaped(k,n);
+    _put(':');
+    if (_indent > 0) {
+      _put(' ');
+    }
+    _after_key = true;
+    return *this;
+  }
+  inline JsonWriter& key(const char* k)        { return key(k,strlen(k)); }
+  inline JsonWriter& key(const std::string& k) { return key(k.data(),k.size()); }
+
+  inline JsonWriter& value(const char* s, size_t n)  { _separate(); _escaped(s,n); return *this; }
+  inline JsonWriter& value(const char* s)            { return value(s,strlen(s)); }
+  inline JsonWriter& value(const std::string& s)     { return value(s.data(),s.size()); }
+  inline JsonWriter& value(bool b)                   { _separate(); b ? _write("true",4) : _write("false",5); return *this; }
+  inline JsonWriter& value(int v)                    { _number(v); return *this; }
+  inline JsonWriter& value(unsigned v)               { _number(v); return *this; }
+  inline JsonWriter& value(int64_t v)                { _number(v); return *this; }
+  inline JsonWriter& value(uint64_t v)               { _number(v); return *this; }
+  inline JsonWriter& value(float v)                  { _real(v); return *this; }  //Shortest round-trip form
+  inline JsonWriter& value(double v)                 { _real(v); return *this; }  //Shortest round-trip form
+  inline JsonWriter& null()                          { _separate(); _write("null",4); return *this; }
+
+  //Already-serialized JSON (e.g., the replay's metadata block) written verbatim as one value
+  inline JsonWriter& rawValue(const char* s, size_t n) { _separate(); _write(s,n); return *this; }
+  inline JsonWriter& rawValue(const std::string& s)    { return rawValue(s.data(),s.size()); }
+
+  //key + value in one call
+  template<typename T>
+  inline JsonWriter& field(const char* k, const T& v) { key(k); return value(v); }
+};
+
+}
+
+#endif /* JSONWRITER_H_ */
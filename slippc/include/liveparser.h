@@ -0,0 +1,469 @@
+#ifndef LIVEPARSER_H_
+#define LIVEPARSER_H_
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+#ifdef __linux__
+  #include <poll.h>
+  #include <unistd.h>
+  #include <sys/inotify.h>
+#endif
+
+#include "util.h"
+#include "enums.h"
+#include "schema.h"
+#include "replay.h"
+#include "framedecode.h"
+
+// Replay File (.slp) Spec: https://github.com/project-slippi/slippi-wiki/blob/master/SPEC.md
+
+const unsigned LIVE_PLAYER_BLOCK  = 0x24;      //Size of each player's block in the game start event
+const int32_t  LIVE_FRAME_RESERVE = 60*60*8;   //Frames to allocate per player up front (8 minutes); grows past that
+const unsigned LIVE_POLL_MS       = 16;        //Default polling interval (about one frame)
+
+namespace slip {
+
+//Receives a live replay's progress; frames are only reported once they are final (i.e., can no
+//  longer be rolled back), in order, and each exactly once
+class LiveListener {
+public:
+  virtual ~LiveListener() {}
+  virtual void onGameStart(const SlippiReplay&) {}
+  virtual void onFrame(const SlippiReplay&, int32_t) {}
+  virtual void onGameEnd(const SlippiReplay&) {}
+};
+
+//Incremental stats for each port, updated as frames finalize
+class LiveSummary : public LiveListener {
+public:
+  struct PortSummary {
+    bool     active       = false;
+    uint8_t  stocks       = 0;     //Stocks remaining
+    float    percent      = 0.0f;  //Current percent
+    float    damage_taken = 0.0f;  //Total damage taken so far
+    unsigned deaths       = 0;     //Stocks lost so far
+  };
+  PortSummary port[4];
+  int32_t     frame = LOAD_FRAME - 1;  //Last frame accounted for
+
+  void onGameStart(const SlippiReplay& s) override {
+    for (unsigned p = 0; p < 4; ++p) {
+      port[p]        = PortSummary();
+      port[p].active = s.player[p].player_type != 3;
+      port[p].stocks = s.player[p].start_stocks;
+    }
+  }
+
+  void onFrame(const SlippiReplay& s, int32_t f) override {
+    frame = f;
+    for (unsigned p = 0; p < 4; ++p) {
+      const SlippiFrame* frames = s.player[p].frame;
+      if (!port[p].active || frames == nullptr || !frames[f-LOAD_FRAME].alive) {
+        continue;
+      }
+      const SlippiFrame& cur = frames[f-LOAD_FRAME];
+      if (cur.stocks < port[p].stocks) {
+        port[p].deaths += port[p].stocks - cur.stocks;
+      } else if (cur.percent_post > port[p].percent) {
+        port[p].damage_taken += cur.percent_post - port[p].percent;
+      }
+      port[p].stocks  = cur.stocks;
+      port[p].percent = cur.percent_post;
+    }
+  }
+};
+
+//Incremental parser for a replay that is still being written (e.g., by Dolphin during a match)
+//  -> reads only the bytes appended since the last update and decodes only the events they complete;
+//     waits for changes with inotify on Linux, and by polling every poll_ms elsewhere, so a frame is
+//     reported at most about one polling interval after its bookend event is written
+class LiveParser {
+private:
+  int                     _debug;                      //Current debug level
+  unsigned                _poll_ms;                    //Polling interval when we can't be notified of writes
+  std::string             _path;                       //File being followed
+  std::ifstream           _file;                       //Open handle on the file being followed
+  std::string             _buf;                        //Every byte read from the file so far
+  uint32_t                _pos             = 0;        //Position of the next unparsed event in _buf
+  uint32_t                _raw_end         = 0;        //End of the raw event block (0 = not yet known)
+  uint16_t                _payload_sizes[256] = {0};   //Size of payload for each event
+  bool                    _have_header     = false;    //Whether the header and payload sizes have been parsed
+  bool                    _game_start_found = false;   //Whether we've parsed the game start event
+  bool                    _game_end_found  = false;    //Whether we've parsed the game end event
+  bool                    _has_bookends    = false;    //Whether this replay finalizes frames with bookend events
+  int32_t                 _capacity        = 0;        //Number of frames allocated per player
+  int32_t                 _last_final      = LOAD_FRAME - 1;  //Last frame reported to listeners
+  uint8_t                 _slippi_maj      = 0;        //Major version number of replay being parsed
+  uint8_t                 _slippi_min      = 0;        //Minor version number of replay being parsed
+  uint8_t                 _slippi_rev      = 0;        //Revision number of replay being parsed
+  SlippiReplay            _replay;                     //Replay as parsed so far
+  FrameDecoders           _frame_decoders;             //Big-endian decoders for frame and item events
+  std::unordered_map<uint32_t,uint32_t> _item_slots;   //Spawn ID -> index in _replay.item
+  std::vector<LiveListener*> _listeners;
+#ifdef __linux__
+  int                     _inotify_fd      = -1;       //inotify instance watching _path, or -1 to poll
+#endif
+
+  //Read everything appended to the file since the last call; returns the number of new bytes
+  inline size_t _readNew() {
+    _file.clear();
+    _file.seekg(0,std::ios::end);
+    std::streamoff end = _file.tellg();
+    if (end <= std::streamoff(_buf.size())) {
+      return 0;
+    }
+    size_t old_size = _buf.size();
+    _buf.resize(size_t(end));
+    _file.seekg(std::streamoff(old_size));
+    _file.read(&_buf[old_size],end - std::streamoff(old_size));
+    _buf.resize(old_size + size_t(_file.gcount()));
+    return _buf.size() - old_size;
+  }
+
+  //Re-read the raw length in the header; Dolphin only fills it in once the game is over, long after
+  //  the bytes around it were first read into _buf
+  inline void _readRawLength() {
+    char raw_len[4];
+    _file.clear();
+    _file.seekg(11);
+    if (_file.read(raw_len,4)) {
+      memcpy(&_buf[11],raw_len,4);
+    }
+  }
+
+  //Parse the header and the event payload sizes once they're fully written
+  inline bool _parseHeader() {
+    if (_buf.size() < N_HEADER_BYTES + 2) {
+      return true;
+    }
+    if (!same8(&_buf[0],SLP_HEADER)) {
+      FAIL("Not a raw replay file");
+      return false;
+    }
+    unsigned p = N_HEADER_BYTES;
+    if (uint8_t(_buf[p]) != Event::EV_PAYLOADS) {
+      FAIL_CORRUPT("Event payload sizes not found");
+      return false;
+    }
+    unsigned ev_bytes = uint8_t(_buf[p+1]);  //Includes the size byte itself
+    if (p + 1 + ev_bytes > _buf.size()) {
+      return true;
+    }
+    _payload_sizes[Event::EV_PAYLOADS] = ev_bytes;
+    for (unsigned i = 1; i + 2 < ev_bytes; i += 3) {
+      uint8_t ev_code         = _buf[p+1+i];
+      _payload_sizes[ev_code] = readBE2U(&_buf[p+2+i]);
+    }
+    _has_bookends = _payload_sizes[Event::BOOKEND] > 0;
+    _pos          = p + 1 + ev_bytes;
+    _have_header  = true;
+    return true;
+  }
+
+  inline void _parseGameStart(char* ev, unsigned ev_size) {
+    _slippi_maj = uint8_t(ev[O_SLP_MAJ]);
+    _slippi_min = uint8_t(ev[O_SLP_MIN]);
+    _slippi_rev = uint8_t(ev[O_SLP_REV]);
+    _frame_decoders.setVersion(_slippi_maj,_slippi_min,_slippi_rev);
+    _replay.slippi_version_raw = readBE4U(&ev[O_SLP_MAJ]);
+    _replay.slippi_version     = GET_VERSION();
+    _replay.stage              = readBE2U(&ev[O_STAGE]);
+    _replay.teams              = bool(ev[O_IS_TEAMS]);
+    if (O_RNG_GAME_START + 4 <= ev_size) {
+      _replay.seed = readBE4U(&ev[O_RNG_GAME_START]);
+    }
+    for (unsigned p = 0; p < 4; ++p) {
+      char* pb = &ev[O_PLAYERDATA + LIVE_PLAYER_BLOCK*p];
+      _replay.player[p].ext_char_id  = uint8_t(pb[O_PLAYER_ID]);
+      _replay.player[p].player_type  = uint8_t(pb[O_PLAYER_TYPE]);
+      _replay.player[p].start_stocks = uint8_t(pb[O_START_STOCKS]);
+      _replay.player[p].color        = uint8_t(pb[O_COLOR]);
+      _replay.player[p].team_id      = uint8_t(pb[O_TEAM_ID]);
+    }
+    _game_start_found = true;
+    DOUT1("Following a version " << _replay.slippi_version << " replay");
+    for (LiveListener* l : _listeners) {
+      l->onGameStart(_replay);
+    }
+  }
+
+  //Make sure frame index fi of player p exists, growing every player's frame array if needed
+  inline SlippiFrame* _frameAt(unsigned p, int32_t fi) {
+    if (fi >= _capacity) {
+      int32_t capacity = std::max(std::max(_capacity*2,LIVE_FRAME_RESERVE),fi+1);
+      for (unsigned i = 0; i < 8; ++i) {
+        if (_replay.player[i].frame == nullptr) {
+          continue;
+        }
+        SlippiFrame* frames = new SlippiFrame[capacity];
+        std::copy(_replay.player[i].frame,_replay.player[i].frame+_capacity,frames);
+        delete[] _replay.player[i].frame;
+        _replay.player[i].frame = frames;
+      }
+      _capacity = capacity;
+    }
+    if (_replay.player[p].frame == nullptr) {
+      _replay.player[p].frame = new SlippiFrame[_capacity];
+    }
+    return &_replay.player[p].frame[fi];
+  }
+
+  inline SlippiFrame* _frameFor(char* ev) {
+    int32_t fi = readBE4S(&ev[O_FRAME]) - LOAD_FRAME;
+    unsigned p = uint8_t(ev[O_PLAYER]) + 4*(ev[O_FOLLOWER] != 0);
+    if (fi < 0 || p >= 8) {
+      DOUT1("Skipping frame event for frame " << (fi + LOAD_FRAME) << ", player " << p);
+      return nullptr;
+    }
+    return _frameAt(p,fi);
+  }
+
+  inline void _parseItemUpdate(char* ev, unsigned ev_size) {
+    uint32_t spawn_id = readBE4U(&ev[O_ITEM_ID]);
+    auto slot = _item_slots.find(spawn_id);
+    if (slot == _item_slots.end()) {
+      if (_replay.num_items >= MAX_ITEMS) {
+        return;
+      }
+      slot = _item_slots.emplace(spawn_id,_replay.num_items++).first;
+      SlippiItem& item = _replay.item[slot->second];
+      item.type        = readBE2U(&ev[O_ITEM_TYPE]);
+      item.spawn_id    = spawn_id;
+      item.frame       = new SlippiItemFrame[MAX_ITEM_LIFE];
+    }
+    SlippiItem& item = _replay.item[slot->second];
+    if (item.num_frames < uint32_t(MAX_ITEM_LIFE)) {
+      _frame_decoders.item.decode(ev,ev_size,item.frame[item.num_frames++]);
+    }
+  }
+
+  //Report every frame up to and including f that hasn't been reported yet
+  inline void _finalizeThrough(int32_t f) {
+    f = std::min(f,_replay.last_frame);
+    for (; _last_final < f; ) {
+      ++_last_final;
+      for (LiveListener* l : _listeners) {
+        l->onFrame(_replay,_last_final);
+      }
+    }
+  }
+
+  //Parse every complete event in the buffer; returns the number parsed, or -1 on corrupt data
+  inline int _parseEvents() {
+    int parsed = 0;
+    uint32_t end = uint32_t(_buf.size());
+    if (_raw_end > 0) {
+      end = std::min(end,_raw_end);
+    }
+    while (!_game_end_found && _pos < end) {
+      uint8_t  ev_code = uint8_t(_buf[_pos]);
+      unsigned ev_size = 1 + _payload_sizes[ev_code];
+      if (ev_size == 1) {
+        FAIL_CORRUPT("Encountered unknown event 0x" << std::hex << int(ev_code) << std::dec << " at byte " << _pos);
+        return -1;
+      }
+      if (_pos + ev_size > end) {
+        break;  //Rest of the event hasn't been written yet
+      }
+      char* ev = &_buf[_pos];
+      switch(ev_code) {
+        case Event::GAME_START:
+          _parseGameStart(ev,ev_size);
+          break;
+        case Event::PRE_FRAME:
+          if (SlippiFrame* f = _frameFor(ev)) {
+            //Without bookends, the first event of a frame means the previous one is final
+            if (!_has_bookends && !f->alive) {
+              _finalizeThrough(readBE4S(&ev[O_FRAME]) - 1);
+            }
+            _frame_decoders.pre.decode(ev,ev_size,*f);
+            f->alive           = true;
+            _replay.last_frame = std::max(_replay.last_frame,f->frame);
+            _replay.frame_count = uint32_t(_replay.last_frame - LOAD_FRAME + 1);
+          }
+          break;
+        case Event::POST_FRAME:
+          if (SlippiFrame* f = _frameFor(ev)) {
+            _frame_decoders.post.decode(ev,ev_size,*f);
+          }
+          break;
+        case Event::ITEM_UPDATE:
+          _parseItemUpdate(ev,ev_size);
+          break;
+        case Event::BOOKEND:
+          //As of 3.7.0, bookends say which frame is final; before that, the bookend's own frame is
+          _finalizeThrough((O_ROLLBACK_FRAME + 4 <= ev_size) ? readBE4S(&ev[O_ROLLBACK_FRAME]) : readBE4S(&ev[O_BOOKEND_FRAME]));
+          break;
+        case Event::GAME_END:
+          _replay.end_type = uint8_t(ev[O_END_METHOD]);
+          if (O_LRAS < ev_size) {
+            _replay.lras = int8_t(ev[O_LRAS]);
+          }
+          _game_end_found = true;
+          _finalizeThrough(_replay.last_frame);
+          for (LiveListener* l : _listeners) {
+            l->onGameEnd(_replay);
+          }
+          break;
+        default:
+          break;
+      }
+      _pos += ev_size;
+      ++parsed;
+    }
+    return parsed;
+  }
+
+  //Block until the file may have changed or timeout_ms elapses
+  inline void _wait(unsigned timeout_ms) {
+#ifdef __linux__
+    if (_inotify_fd >= 0) {
+      pollfd pfd = { _inotify_fd, POLLIN, 0 };
+      if (poll(&pfd,1,int(timeout_ms)) > 0) {
+        char events[4096];
+        while (read(_inotify_fd,events,sizeof(events)) > 0) {}  //Drain; we only care that something changed
+      }
+      return;
+    }
+#endif
+    std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms,_poll_ms)));
+  }
+
+  inline void _close() {
+#ifdef __linux__
+    if (_inotify_fd >= 0) {
+      ::close(_inotify_fd);
+      _inotify_fd = -1;
+    }
+#endif
+    if (_file.is_open()) {
+      _file.close();
+    }
+  }
+
+  inline void _release() {
+    for (unsigned i = 0; i < 8; ++i) {
+      delete[] _replay.player[i].frame;
+      _replay.player[i].frame = nullptr;
+    }
+    for (unsigned i = 0; i < _replay.num_items; ++i) {
+      delete[] _replay.item[i].frame;
+      _replay.item[i].frame = nullptr;
+    }
+  }
+
+  //Forget everything about the file followed so far (listeners stay registered)
+  inline void _reset() {
+    _release();
+    _buf.clear();
+    _pos              = 0;
+    _raw_end          = 0;
+    memset(_payload_sizes,0,sizeof(_payload_sizes));
+    _have_header      = false;
+    _game_start_found = false;
+    _game_end_found   = false;
+    _has_bookends     = false;
+    _capacity         = 0;
+    _last_final       = LOAD_FRAME - 1;
+    _slippi_maj       = 0;
+    _slippi_min       = 0;
+    _slippi_rev       = 0;
+    _replay           = SlippiReplay();
+    _replay.last_frame = LOAD_FRAME;  //Frames start at LOAD_FRAME; from the default of 0, frames before 0 would never raise it
+    _frame_decoders   = FrameDecoders();
+    _item_slots.clear();
+  }
+
+public:
+  LiveParser(int debug_level, unsigned poll_ms = LIVE_POLL_MS) : _debug(debug_level), _poll_ms(std::max(poll_ms,1u)) {}
+  ~LiveParser() {
+    _close();
+    _release();
+  }
+  LiveParser(const LiveParser&) = delete;
+  LiveParser& operator=(const LiveParser&) = delete;
+
+  //Listeners are not owned and must outlive the parser
+  inline void addListener(LiveListener* l) {
+    _listeners.push_back(l);
+  }
+
+  //Start following a replay file, which may be empty or partially written; drops whatever was parsed from a previous file
+  inline bool open(const std::string& path) {
+    _close();
+    _reset();
+    _file.open(path,std::ios::binary);
+    if (!_file) {
+      FAIL("Could not open " << path);
+      return false;
+    }
+    _path = path;
+#ifdef __linux__
+    _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotify_fd >= 0 && inotify_add_watch(_inotify_fd,path.c_str(),IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+      ::close(_inotify_fd);
+      _inotify_fd = -1;  //Fall back to polling
+    }
+#endif
+    return true;
+  }
+
+  //Parse whatever has been appended since the last update; returns the number of new events, or -1 on error
+  inline int update() {
+    _readNew();
+    if (!_have_header) {
+      if (!_parseHeader()) {
+        return -1;
+      }
+      if (!_have_header) {
+        return 0;
+      }
+    }
+    //Dolphin fills in the raw length once the game is over
+    if (_raw_end == 0) {
+      _readRawLength();
+      uint32_t raw_len = readBE4U(&_buf[11]);
+      if (raw_len > 0) {
+        _raw_end = N_HEADER_BYTES + raw_len;
+      }
+    }
+    return _parseEvents();
+  }
+
+  //Keep updating until the game ends, or until the file goes idle_ms without growing; returns whether the game ended
+  inline bool follow(unsigned idle_ms = 10000) {
+    auto last_change = std::chrono::steady_clock::now();
+    while (!_game_end_found) {
+      size_t before = _buf.size();
+      if (update() < 0) {
+        return false;
+      }
+      auto now = std::chrono::steady_clock::now();
+      if (_buf.size() != before) {
+        last_change = now;
+      } else if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_change).count() >= idle_ms) {
+        DOUT1("No new data in " << idle_ms << " ms; giving up on " << _path);
+        return false;
+      }
+      if (!_game_end_found) {
+        _wait(_poll_ms);
+      }
+    }
+    return true;
+  }
+
+  inline bool                gameStarted()   const { return _game_start_found; }
+  inline bool                gameEnded()     const { return _game_end_found; }
+  inline int32_t             lastFinalFrame() const { return _last_final; }
+  inline const SlippiReplay* replay()        const { return &_replay; }
+};
+
+}
+
+#endif /* LIVEPARSER_H_ */
@@ -5,12 +5,14 @@
 #include <fstream>
 #include <sstream>
 #include <regex>
+#include <memory>
 
 #include "util.h"
 #include "replay.h"
 #include "analyzer.h"
 #include "schema.h"
 #include "compressor.h"
+#include "visitor.h"
 
 // Replay File (.slp) Spec: https://github.com/project-slippi/slippi-wiki/blob/master/SPEC.md
 
@@ -51,6 +53,65 @@ public:
   Parser(int debug_level);               //Instantiate the parser (possibly in debug mode)
   ~Parser();                             //Destroy the parser
   bool load(const char* replayfilename); //Load a replay file
+
+  //Load a replay from an in-memory buffer allocated with new[]; the parser takes ownership of it
+  //  -> encoded (.zlp) buffers are decoded through the compressor first
+  //  -> fails (and frees the buffer) if the parser already holds a replay; use a new Parser per replay
+  inline bool loadFromBuff(char* buffer, unsigned size) {
+    if (_rb != nullptr) {  //_parse() builds on the current replay, so a parser only ever holds one
+      FAIL("Parser already holds a replay");
+      delete[] buffer;
+      return false;
+    }
+    if (size >= 4 && same4(buffer,LZMA_HEADER)) {
+      Compressor c(_debug);
+      if (!c.loadFromBuff(&buffer,size)) {
+        FAIL("Failed to decode compressed replay buffer");
+        return false;
+      }
+      buffer = nullptr;
+      size   = c.saveToBuff(&buffer);
+      if (size == 0 || buffer == nullptr) {
+        FAIL("Failed to decode compressed replay buffer");
+        return false;
+      }
+    }
+    _rb        = buffer;
+    _file_size = size;
+    return _parse();
+  }
+
+  //Stream a replay file's events through a visitor without building a SlippiReplay (see visitor.h)
+  //  -> encoded (.zlp) files are decoded through the compressor first
+  template<typename V>
+  inline bool visit(const char* replayfilename, V& visitor) {
+    std::ifstream myfile(replayfilename,std::ios::binary | std::ios::ate);
+    if (!myfile) {
+      FAIL("Could not open " << replayfilename);
+      return false;
+    }
+    unsigned size = unsigned(myfile.tellg());
+    std::unique_ptr<char[]> buffer(new char[size]);
+    myfile.seekg(0,std::ios::beg);
+    if (!myfile.read(buffer.get(),size)) {
+      FAIL("Could not read " << replayfilename);
+      return false;
+    }
+    if (size >= 4 && same4(buffer.get(),LZMA_HEADER)) {
+      //The compressor owns (and frees) the encoded buffer from here on, whether or not it loads
+      Compressor c(_debug);
+      char* encoded = buffer.release();
+      if (!c.loadFromBuff(&encoded,size)) {
+        FAIL("Failed to decode compressed replay " << replayfilename);
+        return false;
+      }
+      char* decoded = nullptr;
+      size = c.saveToBuff(&decoded);
+      buffer.reset(decoded);
+    }
+    return (buffer != nullptr) && visitReplay(buffer.get(),size,visitor);
+  }
+
   Analysis* analyze();                   //Analyze the loaded replay file
   std::string asJson(bool delta);        //Convert the parsed replay structure to a JSON
   void save(const char* outfilename,bool delta); //Save a replay file
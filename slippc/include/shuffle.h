@@ -0,0 +1,356 @@
+#ifndef SHUFFLE_H_
+#define SHUFFLE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "simd.h"
+
+#if defined(_MSC_VER)
+  #define SLIP_BSWAP64 _byteswap_uint64
+#else
+  #define SLIP_BSWAP64 __builtin_bswap64
+#endif
+
+//Column transpose kernels used by the Compressor to shuffle arrays of fixed-size events into
+//  columns (and back). Column widths follow the CW_* tables in compressor.h: a positive width is
+//  a byte column of that many bytes, a negative width is a single byte split into 8 bit planes,
+//  and a 0 terminates the table.
+//
+//Byte columns are stored entry after entry; bit columns store bit 7 of every entry, then bit 6,
+//  and so on, packed MSB first. Every kernel produces output identical to the scalar reference.
+
+namespace slip {
+
+const unsigned MAX_SHUFFLE_COLUMNS = 1024;  //Max number of columns in a width table
+
+//Lookup table spreading the 8 bits of a byte (MSB first) into the low bits of 8 bytes
+struct BitSpreadTable {
+  uint64_t spread[256];
+  BitSpreadTable() {
+    for (unsigned x = 0; x < 256; ++x) {
+      uint64_t v = 0;
+      for (unsigned j = 0; j < 8; ++j) {
+        v |= uint64_t((x >> (7-j)) & 1) << (8*j);
+      }
+      spread[x] = v;
+    }
+  }
+};
+
+inline const BitSpreadTable& bitSpreadTable() {
+  static const BitSpreadTable table;
+  return table;
+}
+
+//Byte column: copy a W-byte field out of (or into) every fixed-size entry; the constant width
+//  lets the compiler turn each memcpy into a single load and store
+template<unsigned W>
+inline void _gatherColumnFixed(char* dst, const char* src, unsigned n, unsigned stride) {
+  for (unsigned e = 0; e < n; ++e) {
+    memcpy(&dst[e*W],&src[size_t(e)*stride],W);
+  }
+}
+
+template<unsigned W>
+inline void _scatterColumnFixed(char* dst, const char* src, unsigned n, unsigned stride) {
+  for (unsigned e = 0; e < n; ++e) {
+    memcpy(&dst[size_t(e)*stride],&src[e*W],W);
+  }
+}
+
+inline void _gatherColumn(char* dst, const char* src, unsigned n, unsigned stride, unsigned width) {
+  switch(width) {
+    case 1:  _gatherColumnFixed<1>(dst,src,n,stride); break;
+    case 2:  _gatherColumnFixed<2>(dst,src,n,stride); break;
+    case 4:  _gatherColumnFixed<4>(dst,src,n,stride); break;
+    default:
+      for (unsigned e = 0; e < n; ++e) {
+        memcpy(&dst[e*width],&src[size_t(e)*stride],width);
+      }
+  }
+}
+
+inline void _scatterColumn(char* dst, const char* src, unsigned n, unsigned stride, unsigned width) {
+  switch(width) {
+    case 1:  _scatterColumnFixed<1>(dst,src,n,stride); break;
+    case 2:  _scatterColumnFixed<2>(dst,src,n,stride); break;
+    case 4:  _scatterColumnFixed<4>(dst,src,n,stride); break;
+    default:
+      for (unsigned e = 0; e < n; ++e) {
+        memcpy(&dst[size_t(e)*stride],&src[e*width],width);
+      }
+  }
+}
+
+#ifdef SLIP_X86
+//4-byte column gather with AVX2 hardware gathers, 8 entries at a time
+SLIP_TARGET_AVX2 inline void _gatherColumn4AVX2(char* dst, const char* src, unsigned n, unsigned stride) {
+  const __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0,1,2,3,4,5,6,7),_mm256_set1_epi32(int(stride)));
+  unsigned e = 0;
+  for (; e + 8 <= n; e += 8) {
+    __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(&src[size_t(e)*stride]),idx,1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[e*4]),v);
+  }
+  _gatherColumnFixed<4>(&dst[e*4],&src[size_t(e)*stride],n-e,stride);
+}
+#endif
+
+//OR 16 bits (MSB first) into a zeroed bit stream at an arbitrary bit position
+inline void _orBits16(char* dst, size_t bitpos, uint16_t bits) {
+  uint8_t* out = reinterpret_cast<uint8_t*>(&dst[bitpos >> 3]);
+  unsigned r   = bitpos & 7;
+  if (r == 0) {
+    out[0] |= uint8_t(bits >> 8);
+    out[1] |= uint8_t(bits);
+  } else {
+    uint32_t x = uint32_t(bits) << (8 - r);
+    out[0] |= uint8_t(x >> 16);
+    out[1] |= uint8_t(x >> 8);
+    out[2] |= uint8_t(x);
+  }
+}
+
+//OR 64 bits (MSB first) into a zeroed bit stream at an arbitrary bit position
+inline void _orBits64(char* dst, size_t bitpos, uint64_t bits) {
+  char*    out = &dst[bitpos >> 3];
+  unsigned r   = bitpos & 7;
+  uint64_t cur;
+  memcpy(&cur,out,8);
+  cur |= SLIP_BSWAP64(bits >> r);
+  memcpy(out,&cur,8);
+  if (r != 0) {
+    out[8] |= char(uint8_t(bits << (8 - r)));
+  }
+}
+
+//Read 64 bits (MSB first) from a bit stream at an arbitrary bit position
+inline uint64_t _readBits64(const char* src, size_t bitpos) {
+  const char* in = &src[bitpos >> 3];
+  unsigned    r  = bitpos & 7;
+  uint64_t    w;
+  memcpy(&w,in,8);
+  w = SLIP_BSWAP64(w);
+  if (r != 0) {
+    w = (w << r) | (uint8_t(in[8]) >> (8 - r));
+  }
+  return w;
+}
+
+//Read 8 bits (MSB first) from a bit stream at an arbitrary bit position
+inline uint8_t _readBits8(const char* src, size_t bitpos) {
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(&src[bitpos >> 3]);
+  unsigned r        = bitpos & 7;
+  if (r == 0) {
+    return in[0];
+  }
+  return uint8_t(((unsigned(in[0]) << 8) | in[1]) >> (8 - r));
+}
+
+//Bit column, scalar reference: one bit at a time, exactly as the Compressor always did it
+inline void _shuffleBitsScalar(char* dst, const char* src, unsigned n, unsigned stride) {
+  size_t b = 0;
+  for (int bit = 7, ib = 7; ib >= 0; --ib) {
+    for (unsigned e = 0; e < n; ++e) {
+      char r_bit = (src[size_t(e)*stride] >> ib) & 0x01;
+      dst[b] ^= r_bit << bit;
+      if ((--bit) < 0) {
+        bit  = 7;
+        b   += 1;
+      }
+    }
+  }
+}
+
+inline void _unshuffleBitsScalar(char* dst, const char* src, unsigned n, unsigned stride) {
+  size_t b = 0;
+  for (int bit = 7, ib = 7; ib >= 0; --ib) {
+    for (unsigned e = 0; e < n; ++e) {
+      char r_bit = (src[b] >> bit) & 0x01;
+      dst[size_t(e)*stride] ^= r_bit << ib;
+      if ((--bit) < 0) {
+        bit  = 7;
+        b   += 1;
+      }
+    }
+  }
+}
+
+#ifdef SLIP_X86
+//Load one byte from each of 16 entries into a vector, bit-reversed within each group of 8 so that
+//  the first entry of the group lands in the MSB of its movemask byte; the lanes are assembled in
+//  registers since going through a byte array would stall on store forwarding
+SLIP_TARGET_SSE2 inline __m128i _loadBitLanes(const char* src, unsigned e, unsigned stride) {
+  uint64_t lo = 0, hi = 0;
+  for (unsigned j = 0; j < 8; ++j) {
+    lo |= uint64_t(uint8_t(src[size_t(e+j)*stride]))   << (8*(7-j));
+    hi |= uint64_t(uint8_t(src[size_t(e+j+8)*stride])) << (8*(7-j));
+  }
+  return _mm_set_epi64x(int64_t(hi),int64_t(lo));
+}
+
+//Next bit plane of 16 loaded entries (MSB first), shifting the lanes up for the following plane
+SLIP_TARGET_SSE2 inline uint16_t _nextBitPlane(__m128i* v) {
+  unsigned mask = unsigned(_mm_movemask_epi8(*v));
+  *v            = _mm_add_epi8(*v,*v);  //Shift every byte left by one
+  return uint16_t(((mask & 0xFF) << 8) | (mask >> 8));
+}
+
+//Bit column with SSE2: pull each bit plane out of 64 entries at a time with movemasks.
+//  Handles entries [e_begin,e_end) of n; plane p of the column starts at bit p*n of dst.
+SLIP_TARGET_SSE2 inline void _shuffleBitsSSE2(char* dst, const char* src, unsigned n, unsigned stride, unsigned e_begin, unsigned e_end) {
+  unsigned e = e_begin;
+  for (; e + 64 <= e_end; e += 64) {
+    __m128i v[4];
+    for (unsigned q = 0; q < 4; ++q) {
+      v[q] = _loadBitLanes(src,e+16*q,stride);
+    }
+    for (unsigned plane = 0; plane < 8; ++plane) {  //plane 0 holds bit 7
+      uint64_t word = 0;
+      for (unsigned q = 0; q < 4; ++q) {
+        word |= uint64_t(_nextBitPlane(&v[q])) << (48-16*q);
+      }
+      _orBits64(dst,size_t(plane)*n+e,word);
+    }
+  }
+  for (; e + 16 <= e_end; e += 16) {
+    __m128i v = _loadBitLanes(src,e,stride);
+    for (unsigned plane = 0; plane < 8; ++plane) {
+      _orBits16(dst,size_t(plane)*n+e,_nextBitPlane(&v));
+    }
+  }
+  //Leftover entries, one bit at a time
+  for (; e < e_end; ++e) {
+    uint8_t c = uint8_t(src[size_t(e)*stride]);
+    for (unsigned plane = 0; plane < 8; ++plane) {
+      size_t pos    = size_t(plane)*n+e;
+      dst[pos >> 3] |= char(((c >> (7-plane)) & 1) << (7 - (pos & 7)));
+    }
+  }
+}
+#endif
+
+//Bit column inverse: read 8 entries' worth of each plane and spread the bits back into bytes;
+//  same entry range convention as _shuffleBitsSSE2()
+inline void _unshuffleBitsSWAR(char* dst, const char* src, unsigned n, unsigned stride, unsigned e_begin, unsigned e_end) {
+  const uint64_t* spread = bitSpreadTable().spread;
+  unsigned e = e_begin;
+  for (; e + 64 <= e_end; e += 64) {
+    uint64_t acc[8] = {0};
+    for (unsigned plane = 0; plane < 8; ++plane) {
+      uint64_t word = _readBits64(src,size_t(plane)*n+e);
+      for (unsigned j = 0; j < 8; ++j) {
+        acc[j] |= spread[uint8_t(word >> (56-8*j))] << (7-plane);
+      }
+    }
+    for (unsigned j = 0; j < 64; ++j) {
+      dst[size_t(e+j)*stride] |= char(acc[j >> 3] >> (8*(j & 7)));
+    }
+  }
+  for (; e + 8 <= e_end; e += 8) {
+    uint64_t acc = 0;
+    for (unsigned plane = 0; plane < 8; ++plane) {
+      acc |= spread[_readBits8(src,size_t(plane)*n+e)] << (7-plane);
+    }
+    for (unsigned j = 0; j < 8; ++j) {
+      dst[size_t(e+j)*stride] |= char(acc >> (8*j));
+    }
+  }
+  for (; e < e_end; ++e) {
+    uint8_t c = 0;
+    for (unsigned plane = 0; plane < 8; ++plane) {
+      size_t pos = size_t(plane)*n+e;
+      c |= ((uint8_t(src[pos >> 3]) >> (7 - (pos & 7))) & 1) << (7-plane);
+    }
+    dst[size_t(e)*stride] |= char(c);
+  }
+}
+
+//Scalar reference transpose, column by column over the whole array
+inline void _transposeColumnsScalar(char* dst, const char* src, unsigned num_entries, const int col_widths[],
+  const unsigned col_offsets[], unsigned struct_size, bool unshuffle) {
+  size_t b = 0;  //Position in the column-major buffer
+  for(unsigned i = 0; col_widths[i] != 0; ++i) {
+    if (col_widths[i] > 0) {
+      unsigned width = col_widths[i];
+      for (unsigned e = 0; e < num_entries; ++e) {
+        size_t mempos = size_t(e)*struct_size+col_offsets[i];
+        memcpy(&dst[unshuffle ? mempos : b],&src[unshuffle ? b : mempos],width);
+        b += width;
+      }
+    } else {
+      if (unshuffle) {
+        _unshuffleBitsScalar(&dst[col_offsets[i]],&src[b],num_entries,struct_size);
+      } else {
+        _shuffleBitsScalar(&dst[b],&src[col_offsets[i]],num_entries,struct_size);
+      }
+      b += num_entries;  //8 bit planes of num_entries bits each
+    }
+  }
+}
+
+//Transpose num_entries fixed-size entries laid out back to back (src) into columns (dst), or the
+//  reverse if unshuffle is set. dst must not alias src, and must be zeroed if the table has bit columns.
+inline void transposeColumns(char* dst, const char* src, unsigned num_entries, const int col_widths[], bool unshuffle,
+  SimdLevel level = simdLevel()) {
+  const unsigned TILE_ENTRIES = 256;  //Entries per tile; a tile of the widest event stays in L1
+
+  unsigned struct_size = 0;
+  unsigned col_offsets[MAX_SHUFFLE_COLUMNS] = {0};
+  for(unsigned i = 0; col_widths[i] != 0; ++i) {
+    col_offsets[i] = struct_size;
+    struct_size   += (col_widths[i] > 0) ? col_widths[i] : 1;  //Bit shuffling columns are always one byte
+  }
+  if (level == SIMD_SCALAR) {
+    _transposeColumnsScalar(dst,src,num_entries,col_widths,col_offsets,struct_size,unshuffle);
+    return;
+  }
+
+  //Walk the entries a tile at a time, visiting every column per tile, so the entry-major side is
+  //  read (or written) once while it's still in cache instead of once per column
+  for (unsigned t = 0; t < num_entries; t += TILE_ENTRIES) {
+    unsigned t_end = std::min(num_entries,t+TILE_ENTRIES);
+    unsigned t_len = t_end - t;
+    size_t   b     = 0;  //Start of the current column in the column-major buffer
+    for(unsigned i = 0; col_widths[i] != 0; ++i) {
+      const char* rows_in  = &src[col_offsets[i]];  //Entry-major side, read when shuffling
+      char*       rows_out = &dst[col_offsets[i]];  //Entry-major side, written when unshuffling
+      if (col_widths[i] > 0) {
+        unsigned width    = col_widths[i];
+        size_t   col_pos  = b + size_t(t)*width;
+        size_t   row_pos  = size_t(t)*struct_size;
+        if (unshuffle) {
+          _scatterColumn(&rows_out[row_pos],&src[col_pos],t_len,struct_size,width);
+        }
+#ifdef SLIP_X86
+        else if (width == 4 && level >= SIMD_AVX2) {
+          _gatherColumn4AVX2(&dst[col_pos],&rows_in[row_pos],t_len,struct_size);
+        }
+#endif
+        else {
+          _gatherColumn(&dst[col_pos],&rows_in[row_pos],t_len,struct_size,width);
+        }
+        b += size_t(num_entries)*width;
+      } else {
+        if (unshuffle) {
+          _unshuffleBitsSWAR(rows_out,&src[b],num_entries,struct_size,t,t_end);
+        }
+#ifdef SLIP_X86
+        else {
+          _shuffleBitsSSE2(&dst[b],rows_in,num_entries,struct_size,t,t_end);
+        }
+#else
+        else if (t == 0) {  //Not tiled; the whole column goes at once
+          _shuffleBitsScalar(&dst[b],rows_in,num_entries,struct_size);
+        }
+#endif
+        b += num_entries;  //8 bit planes of num_entries bits each
+      }
+    }
+  }
+}
+
+}
+
+#endif /* SHUFFLE_H_ */
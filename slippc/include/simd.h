@@ -0,0 +1,93 @@
+#ifndef SIMD_H_
+#define SIMD_H_
+
+#include <cstdint>
+
+//Runtime CPU feature detection and per-function target attributes for the SIMD kernels
+//  -> kernels are always compiled in; which one runs is decided once, at runtime
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  #define SLIP_X86 1
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+#endif
+
+//MSVC lets any function use any intrinsic; GCC and Clang need each function tagged with its target
+#if defined(SLIP_X86) && (defined(__GNUC__) || defined(__clang__))
+  #define SLIP_TARGET_SSE2  __attribute__((target("sse2")))
+  #define SLIP_TARGET_SSSE3 __attribute__((target("ssse3")))
+  #define SLIP_TARGET_AVX2  __attribute__((target("avx2")))
+#else
+  #define SLIP_TARGET_SSE2
+  #define SLIP_TARGET_SSSE3
+  #define SLIP_TARGET_AVX2
+#endif
+
+namespace slip {
+
+//Instruction set levels a kernel can be specialized for, in increasing order
+enum SimdLevel : uint8_t {
+  SIMD_SCALAR = 0,
+  SIMD_SSE2   = 1,
+  SIMD_SSSE3  = 2,
+  SIMD_AVX2   = 3,
+};
+
+inline const char* simdLevelName(SimdLevel level) {
+  switch(level) {
+    case SIMD_SSE2:  return "SSE2";
+    case SIMD_SSSE3: return "SSSE3";
+    case SIMD_AVX2:  return "AVX2";
+    default:         return "scalar";
+  }
+}
+
+//Highest instruction set level supported by both the CPU and the OS
+inline SimdLevel detectSimdLevel() {
+#if defined(SLIP_X86)
+  #ifdef _MSC_VER
+    int info[4];
+    __cpuid(info,0);
+    int max_leaf = info[0];
+    __cpuid(info,1);
+    bool sse2    = (info[3] & (1 << 26)) != 0;
+    bool ssse3   = (info[2] & (1 << 9))  != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx2    = false;
+    if (max_leaf >= 7 && osxsave && (_xgetbv(0) & 0x6) == 0x6) {  //OS saves the YMM registers
+      __cpuidex(info,7,0);
+      avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    if (avx2)  { return SIMD_AVX2; }
+    if (ssse3) { return SIMD_SSSE3; }
+    if (sse2)  { return SIMD_SSE2; }
+  #else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))  { return SIMD_AVX2; }
+    if (__builtin_cpu_supports("ssse3")) { return SIMD_SSSE3; }
+    if (__builtin_cpu_supports("sse2"))  { return SIMD_SSE2; }
+  #endif
+#endif
+  return SIMD_SCALAR;
+}
+
+//Detected once and cached; can be lowered (e.g., by benchmarks) but never raised past what was detected
+inline SimdLevel& _simdLevelRef() {
+  static SimdLevel level = detectSimdLevel();
+  return level;
+}
+
+inline SimdLevel simdLevel() {
+  return _simdLevelRef();
+}
+
+inline void setSimdLevel(SimdLevel level) {
+  static const SimdLevel detected = detectSimdLevel();
+  _simdLevelRef() = (level < detected) ? level : detected;
+}
+
+}
+
+#endif /* SIMD_H_ */
@@ -19,6 +19,9 @@
 #include <algorithm> //std::find
 #include <sys/stat.h> //std::find
 #include <filesystem>
+#include <vector>
+#include <thread>
+#include <atomic>
 
 #include "lzma.h"
 #ifndef _MSC_VER
@@ -300,27 +303,37 @@ inline std::string base64_decode(std::string const& encoded_string) {
 }
 
 // https://stackoverflow.com/questions/7724448/simple-json-string-escape-for-c/33799784#33799784
+//  -> copies runs of characters that need no escaping in one go (see jsonwriter.h for the streaming version)
+//  -> only code compiled against this header gets it; the prebuilt library's Parser::asJson and
+//     Analysis::asJson keep the copy they were compiled with
 inline std::string escape_json(const std::string &s) {
-    std::ostringstream o;
-    for (auto c = s.cbegin(); c != s.cend(); c++) {
-        switch (*c) {
-        case '"' : o << "\\\""; break;
-        case '\\': o << "\\\\"; break;
-        case '\b': o << "\\b"; break;
-        case '\f': o << "\\f"; break;
-        case '\n': o << "\\n"; break;
-        case '\r': o << "\\r"; break;
-        case '\t': o << "\\t"; break;
+    static const char hex[] = "0123456789abcdef";
+    std::string o;
+    o.reserve(s.size() + 8);
+    size_t run = 0;
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        if (c != '"' && c != '\\' && !('\x00' <= c && c <= '\x1f')) {
+            continue;
+        }
+        o.append(s, run, i - run);
+        run = i + 1;
+        switch (c) {
+        case '"' : o += "\\\""; break;
+        case '\\': o += "\\\\"; break;
+        case '\b': o += "\\b"; break;
+        case '\f': o += "\\f"; break;
+        case '\n': o += "\\n"; break;
+        case '\r': o += "\\r"; break;
+        case '\t': o += "\\t"; break;
         default:
-            if ('\x00' <= *c && *c <= '\x1f') {
-                o << "\\u"
-                  << std::hex << std::setw(4) << std::setfill('0') << (int)*c;
-            } else {
-                o << *c;
-            }
+            o += "\\u00";
+            o += hex[(c >> 4) & 0xf];
+            o += hex[c & 0xf];
         }
     }
-    return o.str();
+    o.append(s, run, std::string::npos);
+    return o;
 }
 
 inline std::string to_utf8(const std::u16string &s) {
@@ -458,25 +471,176 @@ inline std::string floatToBinary(float f) {
 }
 
 // http://ptspts.blogspot.com/2011/11/how-to-simply-compress-c-string-with.html
-inline std::string compressWithLzma(const char* in, const size_t inlen, int level = 6) {
+//  threads    == 1 -> single-threaded, single-block encode (same output as before threading existed)
+//  threads    == 0 -> one encoder thread per core
+//  block_size == 0 -> let liblzma pick the block size (3x the preset's dictionary size)
+inline std::string compressWithLzma(const char* in, const size_t inlen, int level = 6, uint32_t threads = 1, uint64_t block_size = 0) {
   std::string result;
   result.resize(inlen + (inlen >> 2) + 128);
   size_t out_pos = 0;
-  if (LZMA_OK != lzma_easy_buffer_encode(
-      level, LZMA_CHECK_CRC32, NULL,
-      reinterpret_cast<const uint8_t*>(in), inlen,
-      reinterpret_cast<uint8_t*>(&result[0]), &out_pos, result.size()))
+  if (threads == 1) {
+    if (LZMA_OK != lzma_easy_buffer_encode(
+        level, LZMA_CHECK_CRC32, NULL,
+        reinterpret_cast<const uint8_t*>(in), inlen,
+        reinterpret_cast<uint8_t*>(&result[0]), &out_pos, result.size()))
+      abort();
+    result.resize(out_pos);
+    return result;
+  }
+
+  // Multithreaded encoder; each block is compressed independently, which also lets
+  //   decompressWithLzma() decode blocks in parallel
+  result.resize(std::max(result.size(),lzma_stream_buffer_bound(inlen)));
+  lzma_mt mt;
+  memset(&mt,0,sizeof(mt));
+  mt.threads    = (threads == 0) ? std::max(lzma_cputhreads(),uint32_t(1)) : threads;
+  mt.block_size = block_size;
+  mt.timeout    = 0;
+  mt.preset     = level;
+  mt.filters    = NULL;
+  mt.check      = LZMA_CHECK_CRC32;
+  lzma_stream strm = LZMA_STREAM_INIT;
+  if (LZMA_OK != lzma_stream_encoder_mt(&strm, &mt))
     abort();
+  strm.next_in   = reinterpret_cast<const uint8_t*>(in);
+  strm.avail_in  = inlen;
+  strm.next_out  = reinterpret_cast<uint8_t*>(&result[0]);
+  strm.avail_out = result.size();
+  lzma_ret ret;
+  while ((ret = lzma_code(&strm, LZMA_FINISH)) == LZMA_OK) {
+    if (strm.avail_out == 0)  // Can't happen with a buffer of lzma_stream_buffer_bound() bytes
+      abort();
+  }
+  if (ret != LZMA_STREAM_END)
+    abort();
+  out_pos = strm.total_out;
+  lzma_end(&strm);
   result.resize(out_pos);
   return result;
 }
 
-inline std::string decompressWithLzma(const uint8_t* in, const size_t inlen) {
+//Uncompressed size and block layout of a single-stream .xz buffer, read from its index
+struct LzmaBlockInfo {
+  uint64_t in_off;   //Offset of the block header in the compressed buffer
+  uint64_t in_size;  //Total size of the block (header, data, padding and check)
+  uint64_t out_off;  //Offset of the block's data in the uncompressed buffer
+  uint64_t out_size; //Uncompressed size of the block
+};
+
+//Read the xz index at the end of a buffer; returns false (and leaves the outputs empty) if the
+//  buffer isn't a single well-formed stream, e.g. concatenated or padded streams
+inline bool readLzmaIndex(const uint8_t* in, const size_t inlen, uint64_t* out_size, lzma_check* check, std::vector<LzmaBlockInfo>* blocks = nullptr) {
+  if (inlen < 2*LZMA_STREAM_HEADER_SIZE) {
+    return false;
+  }
+  lzma_stream_flags header, footer;
+  if (LZMA_OK != lzma_stream_header_decode(&header, in)) {
+    return false;
+  }
+  if (LZMA_OK != lzma_stream_footer_decode(&footer, &in[inlen-LZMA_STREAM_HEADER_SIZE])) {
+    return false;
+  }
+  if (LZMA_OK != lzma_stream_flags_compare(&header, &footer)) {
+    return false;
+  }
+  if (footer.backward_size > inlen-2*LZMA_STREAM_HEADER_SIZE) {
+    return false;
+  }
+  size_t index_pos    = inlen-LZMA_STREAM_HEADER_SIZE-footer.backward_size;
+  size_t index_end    = inlen-LZMA_STREAM_HEADER_SIZE;
+  uint64_t memlimit   = UINT64_MAX;
+  lzma_index* index   = nullptr;
+  if (LZMA_OK != lzma_index_buffer_decode(&index, &memlimit, NULL, in, &index_pos, index_end)) {
+    return false;
+  }
+  //A single stream's blocks must exactly fill the space between the stream header and the index
+  bool valid = (LZMA_STREAM_HEADER_SIZE + lzma_index_total_size(index) + footer.backward_size + LZMA_STREAM_HEADER_SIZE == inlen);
+  if (valid) {
+    *out_size = lzma_index_uncompressed_size(index);
+    *check    = footer.check;
+    if (blocks) {
+      blocks->clear();
+      lzma_index_iter iter;
+      lzma_index_iter_init(&iter, index);
+      while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+        blocks->push_back({
+          iter.block.compressed_file_offset,
+          iter.block.total_size,
+          iter.block.uncompressed_file_offset,
+          iter.block.uncompressed_size
+        });
+      }
+    }
+  }
+  lzma_index_end(index, NULL);
+  return valid;
+}
+
+//Decode a single xz block in place into a presized output buffer
+inline bool decompressLzmaBlock(const uint8_t* in, const LzmaBlockInfo &b, lzma_check check, uint8_t* out) {
+  lzma_filter filters[LZMA_FILTERS_MAX + 1];
+  lzma_block block;
+  memset(&block,0,sizeof(block));
+  block.version     = 0;
+  block.check       = check;
+  block.filters     = filters;
+  block.header_size = lzma_block_header_size_decode(in[b.in_off]);
+  if (LZMA_OK != lzma_block_header_decode(&block, NULL, &in[b.in_off])) {
+    return false;
+  }
+  size_t in_pos  = b.in_off + block.header_size;
+  size_t out_pos = b.out_off;
+  lzma_ret ret   = lzma_block_buffer_decode(&block, NULL, in, &in_pos, b.in_off + b.in_size, out, &out_pos, b.out_off + b.out_size);
+  for (unsigned i = 0; filters[i].id != LZMA_VLI_UNKNOWN; ++i) {
+    free(filters[i].options);
+  }
+  return (ret == LZMA_OK) && (out_pos == b.out_off + b.out_size);
+}
+
+//  threads == 1 -> single-threaded stream decode
+//  threads == 0 -> one decoder thread per core (only helps for multi-block input, e.g. from compressWithLzma(...,threads != 1))
+inline std::string decompressWithLzma(const uint8_t* in, const size_t inlen, uint32_t threads = 1) {
   static const size_t kMemLimit = 1 << 30;  // 1 GB.
-  lzma_stream strm = LZMA_STREAM_INIT;
   std::string result;
-  result.resize(8192);
+
+  //Size the output up front from the xz index if we can
+  uint64_t out_size = 0;
+  lzma_check check  = LZMA_CHECK_NONE;
+  std::vector<LzmaBlockInfo> blocks;
+  bool indexed      = readLzmaIndex(in, inlen, &out_size, &check, (threads != 1) ? &blocks : nullptr);
+  if (threads == 0) {
+    threads = std::max(lzma_cputhreads(),uint32_t(1));
+  }
+
+  //Decode independent blocks in parallel, each straight into its slice of the output
+  if (indexed && blocks.size() > 1 && threads > 1) {
+    result.resize(out_size);
+    uint8_t* out = reinterpret_cast<uint8_t*>(&result[0]);
+    std::atomic<size_t> next_block(0);
+    std::atomic<bool>   failed(false);
+    auto worker = [&]() {
+      for (size_t i = next_block++; i < blocks.size() && !failed; i = next_block++) {
+        if (!decompressLzmaBlock(in, blocks[i], check, out)) {
+          failed = true;
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    for (uint32_t t = 1; t < std::min<size_t>(threads, blocks.size()); ++t) {
+      workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& w : workers) {
+      w.join();
+    }
+    if (failed)
+      abort();
+    return result;
+  }
+
+  result.resize(indexed ? std::max<uint64_t>(out_size,1) : 8192);
   size_t result_used = 0;
+  lzma_stream strm = LZMA_STREAM_INIT;
   lzma_ret ret;
   ret = lzma_stream_decoder(&strm, kMemLimit, LZMA_CONCATENATED);
   if (ret != LZMA_OK)
@@ -499,16 +663,18 @@ inline std::string decompressWithLzma(const uint8_t* in, const size_t inlen) {
     if (ret != LZMA_OK)
       abort();
     if (strm.avail_out == 0) {
-      result_used += avail0 - strm.avail_out;
-      result.resize(result.size() << 1);
+      //Without an index the size is unknown, so double the buffer; with one it already holds the whole output,
+      //  and a full buffer only means the decoder still has the block check, index and footer to verify
+      result_used += avail0;
+      result.resize(indexed ? result.size() : result.size() << 1);
       strm.next_out = reinterpret_cast<uint8_t*>(&result[0] + result_used);
       strm.avail_out = avail0 = result.size() - result_used;
     }
   }
 }
 
-inline std::string decompressWithLzma(const char* in, const size_t inlen) {
-  return decompressWithLzma(reinterpret_cast<const uint8_t*>(&in[0]),inlen);
+inline std::string decompressWithLzma(const char* in, const size_t inlen, uint32_t threads = 1) {
+  return decompressWithLzma(reinterpret_cast<const uint8_t*>(&in[0]),inlen,threads);
 }
 
 inline bool fileExists(std::string fname) {
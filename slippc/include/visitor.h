@@ -0,0 +1,148 @@
+#ifndef VISITOR_H_
+#define VISITOR_H_
+
+#include <cstdint>
+
+#include "util.h"
+#include "enums.h"
+#include "schema.h"
+#include "replay.h"
+#include "eventstream.h"
+#include "frameloop.h"
+
+// Replay File (.slp) Spec: https://github.com/project-slippi/slippi-wiki/blob/master/SPEC.md
+
+const unsigned VISIT_PLAYER_BLOCK = 0x24;  //Size of each player's block in the game start event
+
+namespace slip {
+
+//Decoded view of the game start event (the raw event is there for anything not decoded)
+struct GameStartView {
+  uint8_t     slippi_maj = 0;
+  uint8_t     slippi_min = 0;
+  uint8_t     slippi_rev = 0;
+  uint16_t    stage      = 0;
+  uint32_t    seed       = 0;      //Starting RNG seed (0 before it was recorded)
+  bool        teams      = false;
+  struct {
+    uint8_t   ext_char_id  = 0;
+    uint8_t   player_type  = 3;    //0 = human, 1 = CPU, 2 = demo, 3 = empty
+    uint8_t   start_stocks = 0;
+    uint8_t   color        = 0;
+    uint8_t   team_id      = 0;
+  }           player[4];
+  const char* raw        = nullptr;
+  unsigned    raw_size   = 0;
+};
+
+//Decoded view of an item update
+struct ItemUpdateView {
+  const SlippiItemFrame& frame;
+  uint16_t               type;
+  uint32_t               spawn_id;
+};
+
+//Decoded view of the game end event
+struct GameEndView {
+  uint8_t end_type = 0;   //1 = TIME!, 2 = GAME!, 7 = No Contest
+  int8_t  lras     = -1;  //Port ID of player who initiated LRAStart
+};
+
+//SAX-style replay visitor: derive from this and hide whichever hooks you need; visitReplay() is
+//  templated on the derived type, so every hook is a direct (inlinable) call and unused ones vanish.
+//  Frame views are scratch structs reused for every event: only the members the event carries are
+//  meaningful (pre-frame members in onPreFrame, post-frame members plus frame/player/follower in
+//  onPostFrame), and they must be copied out if they're needed after the hook returns.
+struct ReplayVisitor {
+  inline bool onGameStart(const GameStartView&)   { return true; }  //Return false to skip the rest of the replay
+  inline void onPreFrame(const SlippiFrame&)      {}
+  inline void onPostFrame(const SlippiFrame&)     {}
+  inline void onItemUpdate(const ItemUpdateView&) {}
+  inline void onGameEnd(const GameEndView&)       {}
+  inline bool onEvent(const EventStream&)         { return true; }  //Any other event; return false to stop
+};
+
+inline void decodeGameStart(const char* ev, unsigned ev_size, GameStartView* g) {
+  char* e       = const_cast<char*>(ev);
+  g->slippi_maj = uint8_t(e[O_SLP_MAJ]);
+  g->slippi_min = uint8_t(e[O_SLP_MIN]);
+  g->slippi_rev = uint8_t(e[O_SLP_REV]);
+  g->stage      = readBE2U(&e[O_STAGE]);
+  g->teams      = bool(e[O_IS_TEAMS]);
+  g->seed       = (O_RNG_GAME_START + 4 <= ev_size) ? readBE4U(&e[O_RNG_GAME_START]) : 0;
+  for (unsigned p = 0; p < 4; ++p) {
+    char* pb = &e[O_PLAYERDATA + VISIT_PLAYER_BLOCK*p];
+    g->player[p].ext_char_id  = uint8_t(pb[O_PLAYER_ID]);
+    g->player[p].player_type  = uint8_t(pb[O_PLAYER_TYPE]);
+    g->player[p].start_stocks = uint8_t(pb[O_START_STOCKS]);
+    g->player[p].color        = uint8_t(pb[O_COLOR]);
+    g->player[p].team_id      = uint8_t(pb[O_TEAM_ID]);
+  }
+  g->raw      = ev;
+  g->raw_size = ev_size;
+}
+
+//Adapts a visitor to the frame loop: decodes every event into a scratch view and hands it over
+template<typename V>
+struct _VisitorSink : FrameSink {
+  V&              v;
+  SlippiFrame     pre;
+  SlippiFrame     post;
+  SlippiItemFrame item;
+
+  _VisitorSink(V& visitor) : v(visitor) {}
+
+  inline SlippiFrame*     preFrame(const char*)  { return &pre; }
+  inline SlippiFrame*     postFrame(const char*) { return &post; }
+  inline SlippiItemFrame* itemFrame(const char*) { return &item; }
+  inline void preFrameDone(const char*, SlippiFrame& f) {
+    v.onPreFrame(f);
+  }
+  inline void postFrameDone(const char* ev, SlippiFrame& f) {
+    //Post-frame events carry these too, but the decoder treats them as pre-frame members
+    char* e    = const_cast<char*>(ev);
+    f.frame    = readBE4S(&e[O_FRAME]);
+    f.player   = uint8_t(e[O_PLAYER]);
+    f.follower = e[O_FOLLOWER] != 0;
+    v.onPostFrame(f);
+  }
+  inline void itemFrameDone(const char* ev, SlippiItemFrame& f) {
+    char* e = const_cast<char*>(ev);
+    v.onItemUpdate(ItemUpdateView{f,readBE2U(&e[O_ITEM_TYPE]),readBE4U(&e[O_ITEM_ID])});
+  }
+  inline bool event(const EventStream& s) {
+    if (s.code() != Event::GAME_END) {
+      return v.onEvent(s);
+    }
+    GameEndView g;
+    g.end_type = uint8_t(s.data()[O_END_METHOD]);
+    if (O_LRAS < s.eventSize()) {
+      g.lras = int8_t(s.data()[O_LRAS]);
+    }
+    v.onGameEnd(g);
+    return true;
+  }
+};
+
+//Stream every event of a raw replay buffer through a visitor, without building a SlippiReplay or
+//  allocating any frame arrays; returns false if the buffer isn't a raw replay or onEvent() stopped the
+//  loop early (a replay that onGameStart() chose to skip was still visited successfully)
+template<typename V>
+inline bool visitReplay(const char* buf, uint32_t size, V& visitor, SimdLevel level = simdLevel()) {
+  EventStream s;
+  if (!s.open(buf,size) || !s.valid() || s.code() != Event::GAME_START) {
+    return false;
+  }
+  GameStartView g;
+  decodeGameStart(s.data(),s.eventSize(),&g);
+  if (!visitor.onGameStart(g)) {
+    return true;
+  }
+  s.next();
+  _VisitorSink<V> sink(visitor);
+  return runFrameLoop(s,g.slippi_maj,g.slippi_min,g.slippi_rev,sink,level);
+}
+
+}
+
+#endif /* VISITOR_H_ */